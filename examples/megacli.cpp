@@ -3251,12 +3251,9 @@ void exec_cycleUploadDownload(autocomplete::ACState& s)
             {
                 ++gap_resumed_uploads;
 
-                // simulate this transfer
-                string serialized;
-                t->serialize(&serialized);
-
-                // put the transfer in cachedtransfers so we can resume it
-                Transfer::unserialize(client, &serialized, client->multi_cachedtransfers);
+                // put the transfer in cachedtransfers so we can resume it from its cache record
+                auto ct = new CachedTransfer(*t);
+                client->multi_cachedtransfers[ct->type].emplace(ct, ct);
 
                 // prep to try to resume this upload after we get back to our main loop
                 auto fpstr = t->files.front()->getLocalname().toPath(false);
@@ -24,27 +24,146 @@
 
 #include "mega/utils.h"
 
+#include <algorithm>
+#include <stdexcept>
+
 namespace mega {
 
 // maps attribute names to attribute values
-struct attr_map : map<nameid, string>
+// Nodes usually have just a few short attributes, so they are kept in a vector sorted by
+// nameid (one allocation, contiguous) instead of a std::map (one allocation per attribute).
+// Short values fit in the std::string's inline buffer. The interface mimics std::map.
+class attr_map
 {
+public:
+    using key_type = nameid;
+    using mapped_type = string;
+    using value_type = std::pair<nameid, string>;
+    using container_type = vector<value_type>;
+    using iterator = container_type::iterator;
+    using const_iterator = container_type::const_iterator;
+    using size_type = container_type::size_type;
+
     attr_map() {}
 
     attr_map(nameid key, string value)
     {
-        (*this)[key] = value;
+        mValues.emplace_back(key, std::move(value));
+    }
+
+    attr_map(const std::map<nameid, string>& m)
+        : mValues(m.begin(), m.end())
+    {
+    }
+
+    attr_map(std::initializer_list<value_type> values)
+    {
+        for (auto& v : values)
+        {
+            (*this)[v.first] = v.second;
+        }
+    }
+
+    iterator begin() { return mValues.begin(); }
+    iterator end() { return mValues.end(); }
+    const_iterator begin() const { return mValues.begin(); }
+    const_iterator end() const { return mValues.end(); }
+    const_iterator cbegin() const { return mValues.cbegin(); }
+    const_iterator cend() const { return mValues.cend(); }
+
+    bool empty() const { return mValues.empty(); }
+    size_type size() const { return mValues.size(); }
+    void clear() { mValues.clear(); }
+    void swap(attr_map& other) { mValues.swap(other.mValues); }
+
+    iterator lower_bound(nameid k)
+    {
+        return std::lower_bound(mValues.begin(), mValues.end(), k, keyLess);
+    }
+
+    const_iterator lower_bound(nameid k) const
+    {
+        return std::lower_bound(mValues.begin(), mValues.end(), k, keyLess);
     }
 
-    attr_map(map<nameid, string>&& m)
+    iterator find(nameid k)
     {
-        m.swap(*this);
+        auto it = lower_bound(k);
+        return (it != mValues.end() && it->first == k) ? it : mValues.end();
     }
 
+    const_iterator find(nameid k) const
+    {
+        auto it = lower_bound(k);
+        return (it != mValues.end() && it->first == k) ? it : mValues.end();
+    }
+
+    size_type count(nameid k) const { return find(k) != end() ? 1 : 0; }
+
     bool contains(nameid k) const
     {
-        return this->find(k) != this->end();
+        return find(k) != end();
     }
+
+    string& operator[](nameid k)
+    {
+        auto it = lower_bound(k);
+        if (it == mValues.end() || it->first != k)
+        {
+            it = mValues.emplace(it, k, string());
+        }
+        return it->second;
+    }
+
+    const string& at(nameid k) const
+    {
+        auto it = find(k);
+        if (it == end())
+        {
+            throw std::out_of_range("attr_map::at");
+        }
+        return it->second;
+    }
+
+    std::pair<iterator, bool> emplace(nameid k, string v)
+    {
+        auto it = lower_bound(k);
+        if (it != mValues.end() && it->first == k)
+        {
+            return std::make_pair(it, false);
+        }
+        return std::make_pair(mValues.emplace(it, k, std::move(v)), true);
+    }
+
+    std::pair<iterator, bool> insert(value_type v)
+    {
+        return emplace(v.first, std::move(v.second));
+    }
+
+    iterator erase(const_iterator it) { return mValues.erase(it); }
+
+    size_type erase(nameid k)
+    {
+        auto it = find(k);
+        if (it == end())
+        {
+            return 0;
+        }
+        mValues.erase(it);
+        return 1;
+    }
+
+    bool operator==(const attr_map& other) const { return mValues == other.mValues; }
+    bool operator!=(const attr_map& other) const { return mValues != other.mValues; }
+
+    // bytes held by the container besides sizeof(attr_map) (vector and non-inline string storage)
+    size_t heapSize() const;
+
+private:
+    static bool keyLess(const value_type& v, nameid k) { return v.first < k; }
+
+    // sorted by nameid, unique keys
+    container_type mValues;
 };
 
 struct MEGA_API AttrMap
@@ -680,9 +680,12 @@ private:
     Completion mResultFunction;
 
     void removePendingDBRecordsAndTempFiles();
+    void removePendingDBRecordsAndTempFiles(int pendingTag);
     void performAppCallback(Error e, vector<NewNode>&, bool targetOverride = false);
 
 public:
+    // tags of other uploads whose new nodes were coalesced into this command (see MegaClient::putnodesOfUpload)
+    vector<int> mCoalescedTags;
 
     bool procresult(Result, JSON&) override;
 
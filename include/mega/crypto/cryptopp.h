@@ -453,6 +453,37 @@ public:
     SymmCipher(const byte*);
 };
 
+/**
+ * @brief Raw AES-128 key, without the expanded state of a SymmCipher.
+ *
+ * Meant for keys that are kept for a long time but used rarely (like the
+ * share keys of the nodes). The expanded key schedule is kept in a small
+ * per-thread cache, so the ciphers of the keys used most recently by a
+ * thread are reused.
+ */
+class MEGA_API SymmKey
+{
+public:
+    // number of expanded keys cached by each thread
+    static const unsigned CIPHER_CACHE_SIZE = 8;
+
+    byte key[SymmCipher::KEYLENGTH];
+
+    explicit SymmKey(const byte* newkey);
+
+    /**
+     * @brief Returns a cipher initialized with this key.
+     *
+     * The cipher belongs to the calling thread's cache: it is not a dedicated
+     * SymmCipher for this key, so it must be used right away. It stays valid
+     * until CIPHER_CACHE_SIZE other keys are requested by the same thread.
+     */
+    SymmCipher* cipher() const;
+
+    void ecb_encrypt(byte* data, byte* dst = nullptr, size_t len = SymmCipher::BLOCKSIZE) const;
+    void ecb_decrypt(byte* data, size_t len = SymmCipher::BLOCKSIZE) const;
+};
+
 /**
  * @brief Asymmetric cryptography using RSA.
  */
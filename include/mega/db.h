@@ -67,6 +67,9 @@ public:
     // for a full sequential get: rewind to first record
     virtual void rewind() = 0;
 
+    // for a sequential get of the records of one type.  Others may be returned too where that's not supported
+    virtual void rewindByType(uint32_t) { rewind(); }
+
     // get next record in sequence
     virtual bool next(uint32_t*, string*) = 0;
     bool next(uint32_t*, string*, SymmCipher*);
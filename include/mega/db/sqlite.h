@@ -37,6 +37,7 @@ protected:
     FileSystemAccess *fsaccess;
 
     sqlite3_stmt* pStmt = nullptr;
+    bool pStmtByType = false;
     sqlite3_stmt* mDelStmt = nullptr;
     sqlite3_stmt* mPutStmt = nullptr;
 
@@ -45,6 +46,7 @@ protected:
 
 public:
     void rewind() override;
+    void rewindByType(uint32_t type) override;
     bool next(uint32_t*, string*) override;
     bool get(uint32_t, string*) override;
     bool put(uint32_t, char*, unsigned) override;
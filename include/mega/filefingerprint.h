@@ -31,6 +31,10 @@ struct MEGA_API InputStreamAccess
 {
     virtual m_off_t size() = 0;
     virtual bool read(byte *, unsigned) = 0;
+
+    // hint that the given ranges are about to be read, in any order
+    virtual void prefetch(const vector<m_off_t>&, unsigned) { }
+
     virtual ~InputStreamAccess() { }
 };
 
@@ -52,6 +56,9 @@ struct MEGA_API FileFingerprint : public Cacheable
     // Generates a fingerprint by iterating through `is`
     bool genfingerprint(InputStreamAccess* is, m_time_t cmtime, bool ignoremtime = false);
 
+    // Offsets of the blocks sampled by the sparse CRCs of large files
+    static vector<m_off_t> sparseoffsets(m_off_t size, unsigned blocksize, unsigned count);
+
     // Includes CRC and mtime
     // Be wary that these must be used in pair; do not mix with serialize pair
     void serializefingerprint(string* d) const;
@@ -570,6 +570,83 @@ private:
 #endif
 };
 
+class MEGA_API LocalFileIndex
+{
+    // Local files known to have the contents of a cloud file (previous download
+    // targets, including the ones placed in syncs), so further downloads of the
+    // same contents can be produced with a local copy instead of network I/O.
+    // Entries are keyed by fingerprint plus the MetaMAC of the node the file was
+    // verified against. They are just hints: the files may have changed since,
+    // so anything copied from them must be verified again.
+
+public:
+    // the oldest entries are forgotten beyond this
+    static const size_t MAX_ENTRIES = 10000;
+
+    // remember that `path` has the contents of the file with this fingerprint and MetaMAC
+    void add(const FileFingerprint& fingerprint, int64_t metaMac, const LocalPath& path);
+
+    // forget `path`, if indexed
+    void remove(const LocalPath& path);
+
+    // paths that should have the contents, most recently added first
+    vector<LocalPath> candidates(const FileFingerprint& fingerprint, int64_t metaMac) const;
+
+    void clear();
+
+    size_t size() const;
+
+private:
+    struct Entry
+    {
+        FileFingerprint fingerprint;
+        int64_t metaMac;
+        LocalPath path;
+    };
+
+    // oldest first
+    list<Entry> mEntries;
+
+    multimap<const FileFingerprint*, list<Entry>::iterator, FileFingerprintCmp> mByFingerprint;
+    map<LocalPath, list<Entry>::iterator> mByPath;
+};
+
+class MEGA_API LocalFileCopy
+{
+    // Produces a download's temporary file by copying a local file that should
+    // have the same contents, on a worker thread. The copy is only kept if both
+    // its fingerprint and its MetaMAC match the ones of the node.
+
+public:
+    enum Status { PENDING, SUCCEEDED, FAILED };
+
+    LocalFileCopy(vector<LocalPath>&& candidates, const LocalPath& target,
+                  const FileFingerprint& fingerprint, const string& nodeKey);
+
+    // try the candidates in order until one of them produces a verified copy
+    void run();
+
+    Status status() const { return mStatus; }
+
+    // the candidates that didn't have the expected contents. Valid once finished
+    const vector<LocalPath>& staleCandidates() const { return mStale; }
+
+    // the copy is no longer wanted: it won't be kept if it's still running.
+    // Returns true if a verified copy had already been produced, which is then the caller's.
+    bool cancel();
+
+private:
+    std::mutex mMutex;
+    bool mCancelled = false;
+    std::atomic<Status> mStatus{PENDING};
+
+    vector<LocalPath> mCandidates;
+    vector<LocalPath> mStale;
+    LocalPath mTarget;
+    FileFingerprint mFingerprint;
+    string mNodeKey;
+};
+
 
 struct MEGA_API AsyncIOContext
 {
@@ -696,6 +773,9 @@ struct MEGA_API FileAccess
     // absolute position read to byte buffer
     bool frawread(byte *, unsigned, m_off_t, bool caller_opened, FSLogging);
 
+    // hint that the given ranges of the opened file are about to be read, in any order
+    virtual void prefetch(const vector<m_off_t>&, unsigned) { }
+
     // After a successful nonblocking fopen(), call openf() to really open the file (by localname)
     // (this is a lazy-type approach in case we don't actually need to open the file after finding out type/size/mtime).
     // If the size or mtime changed, it will fail.
@@ -751,6 +831,7 @@ public:
 
     m_off_t size() override;
     bool read(byte *buffer, unsigned size) override;
+    void prefetch(const vector<m_off_t>& offsets, unsigned length) override;
 };
 
 // generic host directory enumeration
@@ -822,6 +903,15 @@ private:
     // reason of the permanent failure of filesystem notifications
     string mFailReason;
 
+    // files last closed after being written to: when, and their size and mtime then
+    struct ClosedAfterWrite
+    {
+        m_time_t when;
+        m_off_t size;
+        m_time_t mtime;
+    };
+    std::map<LocalPath, ClosedAfterWrite> mClosedAfterWrite;
+
 public:
     // set if a temporary error occurred.  May be set from a thread.
     std::atomic<int> mErrorCount;
@@ -835,6 +925,16 @@ public:
 
     void notify(NotificationDeque&, LocalNode *, Notification::ScanRequirement, LocalPath&&, bool = false);
 
+    // a writer closed the file (eg. inotify's IN_CLOSE_WRITE), which then had that size and mtime.  Thread safe
+    void notifyClosedAfterWrite(const LocalPath& fullPath, m_time_t when, m_off_t size, m_time_t mtime);
+
+    // true if the file was closed by its writer and still has the size and mtime it had then,
+    // so it's done changing.  false if unknown, eg. when the platform doesn't report closes
+    bool fileSettled(const LocalPath& fullPath, m_off_t size, m_time_t mtime);
+
+    // closes remembered at most
+    static const size_t MAX_CLOSED_AFTER_WRITE = 4096;
+
     DirNotify(const LocalPath& rootPath);
     virtual ~DirNotify() {}
 
@@ -890,8 +990,22 @@ struct MEGA_API FileSystemAccess : public EventTrigger
     virtual bool renamelocal(const LocalPath&, const LocalPath&, bool = true) = 0;
 
     // copy file, overwrite target, set mtime
+    // the way the data was copied is left in last_copy_method
     virtual bool copylocal(const LocalPath&, const LocalPath&, m_time_t) = 0;
 
+    // how copylocal() copied the file's data, fastest first
+    enum CopyMethod
+    {
+        COPY_METHOD_NONE,           // nothing was copied
+        COPY_METHOD_CLONE,          // reflink: the target shares the source's extents
+        COPY_METHOD_FILE_RANGE,     // in-kernel copy via copy_file_range()
+        COPY_METHOD_SENDFILE,       // in-kernel copy via sendfile()
+        COPY_METHOD_SYSTEM,         // platform copy function
+        COPY_METHOD_READ_WRITE,     // copy through a user-space buffer
+    };
+
+    static const char* copyMethodName(CopyMethod method);
+
     // delete file
     virtual bool unlinklocal(const LocalPath&) = 0;
 
@@ -942,6 +1056,9 @@ struct MEGA_API FileSystemAccess : public EventTrigger
     // Set when an operation fails because the target file name is too long.
     bool target_name_too_long = false;
 
+    // set by copylocal() to the method used for the last copy
+    CopyMethod last_copy_method = COPY_METHOD_NONE;
+
     // append local operating system version information to string.
     // Set includeArchExtraInfo to know if the app is 32 bit running on 64 bit (on windows, that is via the WOW subsystem)
     virtual void osversion(string*, bool includeArchExtraInfo) const { }
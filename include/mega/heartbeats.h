@@ -55,7 +55,7 @@ public:
     virtual void setLastAction(const m_time_t &lastAction);
     virtual void setLastSyncedItem(const handle &lastItemUpdated);
 
-    bool mModified = false;
+    bool mModified = false;     // something reported changed since the last beat
     bool mSending = false;
 
 protected:
@@ -74,13 +74,48 @@ class HeartBeatSyncInfo : public HeartBeatBackupInfo
 public:
     void updateSPHBStatus(UnifiedSync& us);
 
+    // Takes the sync's transfer counts and status, marking this modified if they changed
+    void update(UnifiedSync& us);
+
     using SPHBStatus = CommandBackupPutHeartBeat::SPHBStatus;
     SPHBStatus sphbStatus() { return mSPHBStatus; }
 
+    // The fields of one heartbeat, as sent to the API
+    struct Report
+    {
+        handle backupId = UNDEF;
+        SPHBStatus status = CommandBackupPutHeartBeat::STATE_NOT_INITIALIZED;
+        uint8_t progress = 0;
+        uint32_t pendingUps = 0;
+        uint32_t pendingDowns = 0;
+        m_time_t lastAction = -1;
+        handle lastItemUpdated = UNDEF;
+
+        bool operator==(const Report& o) const;
+        bool operator!=(const Report& o) const { return !(*this == o); }
+    };
+
+    // Whether this report should be sent now: it differs from the last one sent
+    // and the minimum interval has passed, or nothing was sent for too long.
+    bool reportDue(const Report& report, m_time_t now) const;
+
+    // Remember what was sent, so unchanged reports cost nothing next time.
+    void reported(const Report& report, m_time_t now);
+    const Report& lastReport() const { return mLastReport; }
+
+    // Whether a change could be reported now, ahead of the next periodic pass:
+    // nothing is in flight and the minimum delay since the last beat has passed.
+    bool mayBeatEarly(m_time_t now) const;
+
     SyncTransferCounts mSnapshotTransferCounts;
     SyncTransferCounts mResolvedTransferCounts;
+
+    static constexpr int MIN_HEARTBEAT_SECS_DELAY = 30; // min time between heartbeats for a changing backup
+    static constexpr int MAX_HEARBEAT_SECS_DELAY = 60*30; // max time to wait before a heartbeat for unchanged backup
+
 private:
     SPHBStatus mSPHBStatus = CommandBackupPutHeartBeat::STATE_NOT_INITIALIZED;
+    Report mLastReport;
 };
 
 class BackupInfoSync : public CommandBackupPut::BackupInfo
@@ -104,6 +139,30 @@ private:
 };
 
 
+/**
+ * @brief The HeartBeatBatch class
+ * Collects backup updates and heartbeats so they are added to the request
+ * queue together, rather than trickling in as one command per backup.
+ * Only the latest entry per backup is kept.
+ */
+class HeartBeatBatch
+{
+public:
+    using BeatCompletion = std::function<void(Error)>;
+
+    void put(const BackupInfoSync& info);
+    void beat(const HeartBeatSyncInfo::Report& report, BeatCompletion completion);
+
+    bool empty() const;
+    size_t size() const;
+
+    // Adds every collected command to the client's request queue.
+    void send(MegaClient& mc);
+
+    vector<BackupInfoSync> mPuts;
+    vector<pair<HeartBeatSyncInfo::Report, BeatCompletion>> mBeats;
+};
+
 class BackupMonitor
 {
 public:
@@ -114,11 +173,17 @@ public:
     void updateOrRegisterSync(UnifiedSync&);
 
 private:
-    static constexpr int MAX_HEARBEAT_SECS_DELAY = 60*30; // max time to wait before a heartbeat for unchanged backup
-
     Syncs& syncs;
 
-    void beatBackupInfo(UnifiedSync& us);
+    // All backups are checked on the same timer, so their heartbeats go out in one batch.
+    HeartBeatBatch mBatch;
+    m_time_t mNextBeat = 0;
+    bool mInBeat = false;
+
+    void beatBackupInfo(UnifiedSync& us, m_time_t now);
+
+    // sends the batch from the client thread
+    void flush();
 };
 
 #endif
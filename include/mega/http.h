@@ -303,6 +303,9 @@ struct MEGA_API HttpIO : public EventTrigger
     // disable public key pinning (for testing purposes) (determines if we check the public key from APIURL)
     bool disablepkp = false;
 
+    // let the server compress JSON responses (any encoding the HTTP layer can decode)
+    bool acceptencoding = true;
+
     // set useragent (must be called exactly once)
     virtual void setuseragent(string*) = 0;
 
@@ -375,9 +378,19 @@ struct MEGA_API HttpReq
     // we assume that API responses are smaller than 4 GB
     m_off_t contentlength;
 
+    // the body arrives compressed and is decoded on the fly, so a plain
+    // Content-Length counts encoded bytes and can't be checked against what we receive
+    bool mContentEncoded = false;
+
+    // contentlength came from Original-Content-Length, the decoded size
+    bool mOriginalContentLength = false;
+
     // time left related to a bandwidth overquota
     m_time_t timeleft;
 
+    // round trip time measured for the last request in milliseconds, -1 if unknown
+    int roundtripms;
+
     // Content-Type of the response
     string contenttype;
 
@@ -25,6 +25,7 @@
 #include "types.h"
 #include "json.h"
 #include "filesystem.h"
+#include "filefingerprint.h"
 #include <string>
 
 namespace mega {
@@ -145,7 +146,44 @@ struct MEGA_API MediaFileInfo
     // Check if we should retry video property extraction, due to previous failure with older library
     bool timeToRetryMediaPropertyExtraction(const std::string& fileattributes, uint32_t fakey[4]);
 
+    // start extracting the properties of a file about to be uploaded on a worker thread, so it overlaps with sending its data
+    void startPropertiesExtraction(MegaClient* client, Transfer* transfer);
+
+    // properties extracted already, by contents, so re-uploads and retries don't parse the same file again
+    bool getCachedProperties(const FileFingerprint& fp, MediaProperties& vp) const;
+    void cacheProperties(const FileFingerprint& fp, const MediaProperties& vp);
+
     MediaFileInfo();
+
+private:
+    static const size_t MAX_CACHED_PROPERTIES = 1024;
+    std::map<FileFingerprint, MediaProperties, FileFingerprintCmp> mPropertiesCache;
+};
+
+// media properties of one local file, extracted ahead of time on a worker thread.
+// The client thread takes the result if it's ready by the time it's needed, or extracts it itself
+class MEGA_API MediaPropertiesExtraction
+{
+public:
+    explicit MediaPropertiesExtraction(const LocalPath& localFilename);
+    MEGA_DISABLE_COPY_MOVE(MediaPropertiesExtraction);
+
+    // worker thread entry point.  Does nothing if the extraction started elsewhere already
+    void run();
+
+    // copies the properties to vp if the worker finished.  Otherwise returns false without
+    // waiting, and the extraction is abandoned: the caller has to extract them itself
+    bool result(MediaProperties& vp);
+
+private:
+    void extract();
+
+    enum State { PENDING, RUNNING, DONE, ABANDONED };
+
+    LocalPath mLocalFilename;
+    MediaProperties mProperties;
+    State mState = PENDING;
+    std::mutex mMutex;
 };
 
 struct MediaFileInfo::queuedvp
@@ -820,6 +820,17 @@ public:
 
     MegaClientAsyncQueue mAsyncQueue;
 
+    // whole-file copies and MetaMAC checks for downloads produced locally.
+    // Kept apart from mAsyncQueue so they don't hold up the chunk crypto
+    MegaClientAsyncQueue mLocalFileCopyQueue;
+
+    // media properties extraction (MediaInfo parses) for files being uploaded.
+    // Its own thread, as a parse can take long enough to stall chunk crypto or local copies
+    MegaClientAsyncQueue mMediaExtractionQueue;
+
+    // local files with the contents of cloud files, to produce downloads without network I/O
+    LocalFileIndex mLocalFileIndex;
+
     // number of parallel connections per transfer (PUT/GET)
     unsigned char connections[2];
 
@@ -842,6 +853,17 @@ public:
     // send files/folders to user
     void putnodes(const char*, vector<NewNode>&&, int tag, CommandPutNodes::Completion&& completion = nullptr);
 
+    // queue the new node of a completed upload. Uploads to the same target folder that complete
+    // within UPLOAD_PUTNODES_BATCH_DS are sent in a single putnodes, and the result of each new node
+    // is reported separately to its own completion (or app->putnodes_result) with its own tag
+    void putnodesOfUpload(NodeHandle target, VersioningOption vo, NewNode&& newnode, int tag, putsource_t source, bool canChangeVault, CommandPutNodes::Completion&& completion);
+
+    // send the queued putnodes of completed uploads (only those whose window expired, unless force is set)
+    void flushUploadPutnodes(bool force);
+
+    // completes every upload still waiting for its putnodes with the error e
+    void failUploadPutnodes(error e);
+
     void putFileAttributes(handle h, fatype t, const std::string& encryptedAttributes, int tag);
 
     // attach file attribute to upload or node handle
@@ -1682,7 +1704,7 @@ public:
 
     // record type indicator for sctable
     // allways add new ones at the end of the enum, otherwise it will mess up the db!
-    enum { CACHEDSCSN, CACHEDNODE, CACHEDUSER, CACHEDLOCALNODE, CACHEDPCR, CACHEDTRANSFER, CACHEDFILE, CACHEDCHAT, CACHEDSET, CACHEDSETELEMENT, CACHEDDBSTATE, CACHEDALERT } sctablerectype;
+    enum { CACHEDSCSN, CACHEDNODE, CACHEDUSER, CACHEDLOCALNODE, CACHEDPCR, CACHEDTRANSFER, CACHEDFILE, CACHEDCHAT, CACHEDSET, CACHEDSETELEMENT, CACHEDDBSTATE, CACHEDALERT, CACHEDTRANSFERINDEX } sctablerectype;
 
     void persistAlert(UserAlert::Base* a);
 
@@ -1797,8 +1819,8 @@ public:
     // transfer list to manage the priority of transfers
     TransferList transferlist;
 
-    // cached transfers (PUT/GET)
-    transfer_multimap multi_cachedtransfers[2];
+    // cached transfers (PUT/GET), only unserialized in full when a File resumes them
+    cachedtransfer_multimap multi_cachedtransfers[2];
 
     // cached files and their dbids
     vector<string> cachedfiles;
@@ -1869,6 +1891,9 @@ public:
     // remove a transfer from the persistent cache
     void transfercachedel(Transfer*, TransferDbCommitter* committer);
 
+    // remove a transfer record, and its index record, from the persistent cache
+    void transfercachedel(uint32_t dbid);
+
     // add a file to the persistent cache
     void filecacheadd(File*, TransferDbCommitter& committer);
 
@@ -1987,6 +2012,14 @@ public:
     // transfer queue dispatch/retry handling
     void dispatchTransfers();
 
+    // try to produce a download from a local file with the same contents.
+    // Returns false while that is in progress. Otherwise, t->localFileCopy is set
+    // if the temporary file was produced, or the download proceeds normally
+    bool startLocalFileCopy(Transfer* t);
+
+    // activate a download whose temporary file is complete already, so it's completed as if downloaded
+    void activateCompletedTransfer(Transfer* t);
+
     void freeq(direction_t);
 
     // client-server request double-buffering
@@ -2003,6 +2036,23 @@ public:
     dstime disconnecttimestamp;
     dstime nextDispatchTransfersDs = 0;
 
+    // new nodes of completed uploads waiting to be sent in a single putnodes per target folder
+    struct UploadPutnodesBatch
+    {
+        vector<NewNode> newnodes;
+
+        // tag and completion for each of the new nodes (same order)
+        vector<std::pair<int, CommandPutNodes::Completion>> completions;
+
+        dstime flushDs = 0;
+    };
+    map<std::tuple<NodeHandle, VersioningOption, putsource_t, bool>, UploadPutnodesBatch> mUploadPutnodesBatches;
+    dstime nextUploadPutnodesFlushDs = 0;
+
+    // time window to coalesce completed uploads into the same putnodes, and max new nodes per putnodes
+    static constexpr dstime UPLOAD_PUTNODES_BATCH_DS = 2;
+    static constexpr size_t UPLOAD_PUTNODES_BATCH_MAX = 1000;
+
 #ifdef ENABLE_CHAT
     // SFU id to specify the SFU server where all chat calls will be started
     int mSfuid = sfu_invalid_id;
@@ -319,7 +319,7 @@ struct MEGA_API Node : public NodeCore, FileFingerprint
     unique_ptr<share_map> pendingshares;
 
     // incoming/outgoing share key
-    unique_ptr<SymmCipher> sharekey;
+    unique_ptr<SymmKey> sharekey;
 
     // app-private pointer
     void* appdata = nullptr;
@@ -23,8 +23,10 @@
 #ifndef NODEMANAGER_H
 #define NODEMANAGER_H 1
 
+#include <array>
 #include <map>
 #include <limits>
+#include <mutex>
 #include <set>
 #include <vector>
 #include "node.h"
@@ -110,6 +112,110 @@ private:
     size_t mSize;
 };
 
+/**
+ * @brief Immutable, versioned views of the node tree for lock-free readers
+ *
+ * The client thread publishes the new version of every node that changed at the
+ * end of each batch of changes (see NodeManager::notifyPurge). Readers pin a Snapshot
+ * and look nodes up there without taking nodeTreeMutex or the NodeManager mutex,
+ * so they never block actionpacket processing and always see the tree as it was at
+ * the end of a batch (never a half-applied one).
+ *
+ * Only the nodes that readers asked for are tracked: a reader that misses in the
+ * snapshot reads the node and its ancestors under the usual locks and offers them
+ * with seed(). A seed is discarded if any node changed since the reader started,
+ * so a snapshot never contains a version older than one already published.
+ */
+class MEGA_API NodeVersions
+{
+public:
+    struct Version
+    {
+        CloudNode cloudNode;
+
+        // set for the top node of an inshare: "<owner email>:", as in Node::displaypath()
+        string inshareOwner;
+        bool isInshare = false;
+
+        Version() = default;
+        explicit Version(const Node& n);
+    };
+
+    using VersionPtr = std::shared_ptr<const Version>;
+
+    class MEGA_API Snapshot
+    {
+    public:
+        // batch number when this snapshot was published
+        uint64_t epoch() const { return mEpoch; }
+
+        // nullptr if the node is not tracked (or it was removed)
+        VersionPtr lookup(NodeHandle h) const;
+
+        // path as per Node::displaypath(), walking the ancestors of 'h'.
+        // Returns false if any ancestor is not tracked by this snapshot.
+        bool displayPath(NodeHandle h, string& path, unsigned* depth = nullptr, nodetype_t* firstAncestorType = nullptr) const;
+
+    private:
+        friend class NodeVersions;
+
+        static constexpr size_t SHARDS = 1024;
+        using Shard = map<NodeHandle, VersionPtr>;
+
+        static size_t shardOf(NodeHandle h) { return static_cast<size_t>(h.as8byte() % SHARDS); }
+
+        // unchanged shards are shared between consecutive snapshots
+        std::array<std::shared_ptr<const Shard>, SHARDS> mShards;
+        uint64_t mEpoch = 0;
+    };
+
+    using SnapshotPtr = std::shared_ptr<const Snapshot>;
+
+    NodeVersions();
+
+    // readers: get the latest published snapshot (lock-free for readers)
+    SnapshotPtr pin() const;
+
+    // readers: call before reading nodes that are going to be seeded
+    uint64_t writeEpoch() const { return mWriteEpoch.load(); }
+
+    // readers: track these versions (usually a node and its ancestors) from now on.
+    // Returns false (and discards them) if any node changed since 'readEpoch'.
+    bool seed(vector<Version>&& versions, uint64_t readEpoch);
+
+    // writer: a node is changing (invalidates ongoing seeds)
+    void invalidate() { ++mWriteEpoch; }
+
+    // writer: record the final state of a changed node, to be published in the next batch
+    void stage(const Node& n);
+    void stageRemoval(NodeHandle h);
+
+    // writer: publish the staged versions as a new snapshot. 'batchEpoch' is the writeEpoch()
+    // when the batch was closed (changes after it are not part of this batch)
+    void publish(uint64_t batchEpoch);
+
+    // drop every tracked node (ie. upon reload of the node tree)
+    void clear();
+
+    // number of tracked nodes in the latest snapshot
+    size_t size() const;
+
+private:
+    mutable std::mutex mWriterMutex;
+    std::atomic<uint64_t> mWriteEpoch{0};
+
+    // value of mWriteEpoch when the last snapshot was published
+    uint64_t mPublishedWriteEpoch = 0;
+
+    // nullptr values are removals
+    map<NodeHandle, VersionPtr> mStaged;
+
+    SnapshotPtr mCurrent;
+
+    bool isTracked(NodeHandle h) const;
+    void publish_locked(uint64_t batchEpoch);
+};
+
 /**
  * @brief The NodeManager class
  *
@@ -307,6 +413,13 @@ public:
     // true when the filesystem has been initialized
     bool ready();
 
+    // latest consistent view of the (tracked) nodes, see NodeVersions
+    NodeVersions::SnapshotPtr pinSnapshot() const;
+
+    // track the node and its ancestors in the next snapshots (reader side, see NodeVersions::seed())
+    bool seedSnapshot(const Node& n, uint64_t readEpoch);
+    uint64_t snapshotWriteEpoch() const;
+
 private:
     MegaClient& mClient;
 
@@ -362,6 +475,9 @@ private:
     // nodes that have changed and are pending to notify to app and dump to DB
     sharedNode_vector mNodeNotify;
 
+    // versioned views published at the end of each batch of changes
+    NodeVersions mVersions;
+
     shared_ptr<Node> getNodeInRAM(NodeHandle handle);
     void saveNodeInRAM(std::shared_ptr<Node> node, bool isRootnode, MissingParentNodes& missingParentNodes);    // takes ownership
 
@@ -164,6 +164,8 @@ public:
 
     bool ftruncate() override;
 
+    void prefetch(const vector<m_off_t>& offsets, unsigned length) override;
+
     bool sysread(byte *, unsigned, m_off_t) override;
     bool sysstat(m_time_t*, m_off_t*, FSLogging) override;
     bool sysopen(bool async, FSLogging) override;
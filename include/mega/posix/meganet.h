@@ -245,6 +245,7 @@ public:
 private:
     static int instanceCount;
     friend class MegaClient;
+    friend class DebugTestHook;
     CodeCounter::ScopeStats countCurlHttpIOAddevents = { "curl-httpio-addevents" };
     CodeCounter::ScopeStats countAddCurlEventsCode = { "curl-add-events" };
     CodeCounter::ScopeStats countProcessCurlEventsCode = { "curl-process-events" };
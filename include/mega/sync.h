@@ -953,6 +953,90 @@ struct SyncProblems
     bool mStallsDetected = false;
 }; // SyncProblems
 
+// Changes to the reported stalls since some version, see Syncs::getSyncStallChanges()
+struct SyncStallChanges
+{
+    struct Change
+    {
+        // the stall is no longer reported (entry is not meaningful then)
+        bool removed = false;
+
+        // key of the stall: cloudKey if cloud, else localKey
+        bool cloud = false;
+        string cloudKey;
+        LocalPath localKey;
+
+        SyncStallEntry entry{SyncWaitReason::NoReason, false, false, {}, {}, {}, {}};
+    };
+
+    // oldest first
+    vector<Change> mChanges;
+
+    // pass this to get the next changes
+    uint64_t mVersion = 0;
+
+    // true if there are more changes than were asked for
+    bool mMore = false;
+
+    // true if the changes asked for are no longer known.  mChanges is then the full set
+    // of stalls, and anything the caller had should be dropped first
+    bool mReset = false;
+};
+
+// The reported stalls, each stamped with the version at which it last changed,
+// so that callers polling for them only get what changed since they last asked.
+class MEGA_API SyncStallLog
+{
+public:
+    // replace the reported stalls, bumping the version for every stall added, changed or removed
+    void update(const SyncStallInfo& stalls);
+
+    // at most maxChanges changes after sinceVersion
+    void changesSince(uint64_t sinceVersion, size_t maxChanges, SyncStallChanges& changes) const;
+
+    uint64_t version() const { return mVersion; }
+    size_t size() const { return mCloud.size() + mLocal.size() - mRemoved; }
+
+    // removals remembered at most.  Callers further behind start again from scratch
+    static const size_t MAX_REMOVED = 10000;
+
+    static bool sameEntry(const SyncStallEntry& a, const SyncStallEntry& b);
+    static bool sameStalls(const SyncStallInfo& a, const SyncStallInfo& b);
+
+private:
+    struct Record
+    {
+        SyncStallEntry entry{SyncWaitReason::NoReason, false, false, {}, {}, {}, {}};
+        uint64_t version = 0;
+        bool removed = false;
+
+        // our key in mCloud or mLocal
+        const string* cloudKey = nullptr;
+        const LocalPath* localKey = nullptr;
+
+        void setKey(const string& key) { cloudKey = &key; }
+        void setKey(const LocalPath& key) { localKey = &key; }
+    };
+
+    map<string, Record> mCloud;
+    map<LocalPath, Record> mLocal;
+
+    // every record by the version it last changed at
+    map<uint64_t, Record*> mByVersion;
+
+    uint64_t mVersion = 0;
+
+    // removals before this version were forgotten
+    uint64_t mForgottenBefore = 0;
+    size_t mRemoved = 0;
+
+    template<typename Key>
+    void updateSide(map<Key, Record>& records, const map<Key, SyncStallEntry>& stalls);
+
+    void stamp(Record& record);
+    void forgetRemoved();
+};
+
 struct SyncFlags
 {
     // we can only perform moves after scanning is complete
@@ -1075,6 +1159,12 @@ struct Syncs
     void getSyncProblems(std::function<void(unique_ptr<SyncProblems>)> completion,
                          bool completionInClient);
 
+    // Like getSyncProblems() for stalls, but only what changed since sinceVersion, at most maxChanges
+    void getSyncStallChanges(uint64_t sinceVersion,
+                             size_t maxChanges,
+                             std::function<void(unique_ptr<SyncStallChanges>)> completion,
+                             bool completionInClient);
+
     // Retrieve status information about sync(s).
     using SyncStatusInfoCompletion =
       std::function<void(vector<SyncStatusInfo>)>;
@@ -1180,6 +1270,11 @@ public:
     typedef std::function<void(MegaClient&, TransferDbCommitter&)> QueuedClientFunc;
     ThreadSafeDeque<QueuedClientFunc> clientThreadActions;
 
+    // Client thread only: takes the next queued action, draining clientThreadActions in bulk
+    bool nextClientAction(QueuedClientFunc& f);
+    bool clientActionsPending();
+    size_t clientActionsCount();
+
     typedef std::pair<std::function<void()>, string> QueuedSyncFunc;
     ThreadSafeDeque<QueuedSyncFunc> syncThreadActions;
 
@@ -1291,6 +1386,9 @@ private:
     error backupOpenDrive_inThread(const LocalPath& drivePath);
     error backupCloseDrive_inThread(LocalPath drivePath);
     void getSyncProblems_inThread(SyncProblems& problems);
+
+    // present a move/rename as one stall rather than one per side
+    static void combineMoveStalls(SyncStallInfo& stalls);
     bool checkSdsCommandsForDelete(UnifiedSync& us, vector<pair<handle, int>>& sdsBackups, std::function<void(MegaClient&, TransferDbCommitter&)>& clientRemoveSdsEntryFunction);
     bool processRemovingSyncBySds(UnifiedSync& us, bool foundRootNode, vector<pair<handle, int>>& sdsBackups);
     void deregisterThenRemoveSyncBySds(UnifiedSync& us, std::function<void(MegaClient&, TransferDbCommitter&)> clientRemoveSdsEntryFunction);
@@ -1479,6 +1577,16 @@ private:
     SyncStallInfo stallReport;
     mutable mutex stallReportMutex;
 
+    // actions taken from clientThreadActions in one go but not yet run (client thread only)
+    std::deque<QueuedClientFunc> clientThreadBatch;
+
+    // the stalls getSyncProblems() would report, versioned.  Sync thread only
+    SyncStallLog mStallLog;
+    void updateStallLog();
+
+    // stallReport (or what of it is reported) differs from what mStallLog was last updated with
+    bool mStallReportChanged = false;
+
     // When the node tree changes, this structure lets the sync code know which LocalNodes need to be flagged
     map<NodeHandle, bool> triggerHandles;
     map<LocalPath, bool> triggerLocalpaths;
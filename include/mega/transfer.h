@@ -179,6 +179,15 @@ struct MEGA_API Transfer : public FileFingerprint
     // context of the async fopen operation
     unique_ptr<AsyncIOContext> asyncopencontext;
 
+    // downloads: copy of a local file with the same contents being made in place of the download
+    shared_ptr<LocalFileCopy> localFileCopy;
+
+    // downloads: whether local files with the same contents were looked for already
+    bool localFileCopyTried = false;
+
+    // uploads: media properties of the file, extracted while its data is sent
+    shared_ptr<MediaPropertiesExtraction> mediaExtraction;
+
     // timestamp of the start of the transfer
     m_time_t lastaccesstime;
 
@@ -196,7 +205,7 @@ struct MEGA_API Transfer : public FileFingerprint
     // serialize the Transfer object
     bool serialize(string*) const override;
 
-    // unserialize a Transfer and add it to the transfer map
+    // unserialize a Transfer and add it to the transfer map (if any)
     static Transfer* unserialize(MegaClient *, string*, transfer_multimap *);
 
     // examine a file on disk for video/audio attributes to attach to the file, on upload/download
@@ -215,6 +224,40 @@ private:
     FileDistributor::TargetNameExistsResolution toTargetNameExistsResolution(CollisionResolution resolution);
 };
 
+// index of a transfer in the transfer cache: the fields needed to match it against new Files.
+// Each transfer record is stored with its index record, and only the index is read at startup.
+// The full Transfer (chunk MACs, keys, temp URLs) is read from the cache once a File claims it.
+struct MEGA_API CachedTransfer : public FileFingerprint
+{
+    CachedTransfer() = default;
+
+    // the index of a transfer, with the transfer's dbid
+    explicit CachedTransfer(const Transfer&);
+
+    // PUT or GET
+    direction_t type = GET;
+
+    // local file being uploaded, or download target
+    LocalPath localfilename;
+
+    // downloads: node being downloaded
+    NodeHandle downloadFileHandle;
+
+    m_time_t lastaccesstime = 0;
+    uint64_t priority = 0;
+
+    // the index record
+    bool serialize(string*) const override;
+    static CachedTransfer* unserialize(const string& d);
+
+    // cache id of the index record of the transfer record with this id, and the other way around
+    static uint32_t indexId(uint32_t transferDbid);
+    static uint32_t transferId(uint32_t indexDbid);
+
+    // read and unserialize the full Transfer.  Returns nullptr if the record is missing or corrupt
+    Transfer* materialize(MegaClient*) const;
+};
+
 
 struct LazyEraseTransferPtr
 {
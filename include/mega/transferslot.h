@@ -47,6 +47,87 @@ public:
 
 class TransferDbCommitter;
 
+// Process-wide limit on the memory transfer buffers may use, shared by the slots of all clients.
+// Slots size their requests from their share of it, and readahead data comes from a pool of
+// power of two sized buffers that are kept for reuse while slots exist, up to a few MB.
+class MEGA_API TransferMemoryBudget
+{
+public:
+    explicit TransferMemoryBudget(m_off_t budget);
+    ~TransferMemoryBudget();
+    MEGA_DISABLE_COPY_MOVE(TransferMemoryBudget);
+
+    // sized from the memory available to the process
+    static TransferMemoryBudget& global();
+
+    // memory limit of the process: cgroup memory.max on Linux if set, otherwise physical memory.  0 if unknown
+    static m_off_t detectMemoryLimit();
+
+    m_off_t budget() const { return mBudget; }
+
+    // slots register while they exist, so they can share the budget.  The pool is freed with the last one
+    void addSlot();
+    void removeSlot();
+
+    // max size of one request for a slot with that many connections, up to maxRequestSize
+    m_off_t requestSize(m_off_t maxRequestSize, unsigned connections) const;
+
+    // release with the same length it was acquired with
+    byte* acquireBuffer(size_t len);
+    void releaseBuffer(byte* buffer, size_t len);
+
+    // size actually allocated for a buffer of len bytes
+    static size_t bufferCapacity(size_t len);
+
+    m_off_t buffersInUse() const;
+    m_off_t buffersPooled() const;
+
+private:
+    static const size_t MIN_BUFFER_SIZE = 4096;
+    static const size_t MAX_POOLED_BUFFER_SIZE = 16 * 1024 * 1024;
+    static const m_off_t MAX_POOLED_BYTES;
+
+    void freePool();
+
+    const m_off_t mBudget;
+    std::atomic<unsigned> mSlots{0};
+
+    mutable std::mutex mMutex;
+    std::map<size_t, std::vector<byte*>> mPool;
+    std::atomic<m_off_t> mPooledBytes{0};
+    std::atomic<m_off_t> mInUseBytes{0};
+};
+
+// Sizes the requests of one connection from its measured bandwidth and round trip time.
+// A connection idles for a round trip between requests, so requests should last several
+// round trips to keep a long, fast link busy, but not much more than that on a slow link,
+// where a failed request wastes everything it had transferred.
+class MEGA_API ConnectionRequestSizer
+{
+public:
+    // each request started is measured once, when it finishes
+    void requestStarted() { mMeasuring = true; }
+
+    // a request of that many bytes completed after elapsedDs; roundtripMs is -1 if unknown
+    void requestFinished(m_off_t bytes, dstime elapsedDs, int roundtripMs);
+
+    // size for the next request, up to maxSize (which is also used until there is a measurement)
+    m_off_t requestSize(m_off_t maxSize) const;
+
+    // smoothed measurements, 0 / -1 if unknown
+    m_off_t bandwidth() const { return mBandwidth; }
+    int roundtripMs() const { return mRoundtripMs; }
+
+    static const m_off_t MIN_REQUEST_SIZE;
+    static const int ROUNDTRIPS_PER_REQUEST = 4;
+    static const int MIN_REQUEST_MS = 1000;
+
+private:
+    m_off_t mBandwidth = 0;     // bytes per second
+    int mRoundtripMs = -1;
+    bool mMeasuring = false;
+};
+
 // active transfer
 struct MEGA_API TransferSlot
 {
@@ -102,6 +183,7 @@ struct MEGA_API TransferSlot
 
     // Keep track of transfer network speed per channel, and overall
     vector<SpeedController> mReqSpeeds;
+    vector<ConnectionRequestSizer> mReqSizers;
     SpeedController mTransferSpeed;
     m_off_t speed, meanSpeed;
 
@@ -52,16 +52,17 @@ public:
     void proc(MegaClient*, std::shared_ptr<Node>);
 };
 
+// copies a node tree in one pass: proctree() with it, then finish()
 class MEGA_API TreeProcCopy : public TreeProc
 {
 public:
+    // the new nodes, parent first once finished (nn[0] is the root of the copy)
     vector<NewNode> nn;
-    unsigned nc = 0;
-    bool allocated = false;
-
-    void allocnodes(void);
 
     void proc(MegaClient*, std::shared_ptr<Node>);
+
+    // puts the nodes in parent first order
+    void finish(MegaClient*);
 };
 
 class MEGA_API TreeProcShareKeys : public TreeProc
@@ -123,6 +123,8 @@ struct NodeCore;
 class PubKeyAction;
 class Request;
 struct Transfer;
+struct CachedTransfer;
+class MediaPropertiesExtraction;
 class TreeProc;
 class LocalTreeProc;
 struct User;
@@ -570,6 +572,9 @@ typedef list<struct TransferSlot*> transferslot_list;
 // map a FileFingerprint to the transfer for that FileFingerprint
 typedef multimap<FileFingerprint*, Transfer*, FileFingerprintCmp> transfer_multimap;
 
+// map a FileFingerprint to the not yet unserialized cached transfers for that FileFingerprint
+typedef multimap<FileFingerprint*, CachedTransfer*, FileFingerprintCmp> cachedtransfer_multimap;
+
 template <class T, class E>
 class deque_with_lazy_bulk_erase
 {
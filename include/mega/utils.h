@@ -435,11 +435,20 @@ public:
 
     static int32_t toLower(const int32_t c)
     {
+        // ASCII needs no table lookup
+        if (c < 0x80)
+        {
+            return (c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c;
+        }
         return utf8proc_tolower(c);
     }
 
     static int32_t toUpper(const int32_t c)
     {
+        if (c < 0x80)
+        {
+            return (c >= 'a' && c <= 'z') ? c - ('a' - 'A') : c;
+        }
         return utf8proc_toupper(c);
     }
 
@@ -689,33 +698,77 @@ bool CompareLocalFileMetaMacWithNode(FileAccess* fa, Node* node);
 // Maintains a small thread pool for executing independent operations such as encrypt/decrypt a block of data
 // The number of threads can be 0 (eg. for helper MegaApi that deals with public folder links) in which case something queued is
 // immediately executed synchronously on the caller's thread
+// Each worker has its own queue, and takes from the others' when it runs out, so workers rarely contend for the same lock.
+// push() and clearDiscardable() are for the client thread only.
 struct MegaClientAsyncQueue
 {
-    void push(std::function<void(SymmCipher&)> f, bool discardable);
+    typedef std::function<void(SymmCipher&)> Job;
+
+    void push(Job f, bool discardable);
+    void push(std::vector<Job>&& jobs, bool discardable);
     void clearDiscardable();
 
+    // collects the jobs pushed during one pass (eg. over a TransferSlot's connections) and submits them together when destroyed
+    class Batch
+    {
+    public:
+        explicit Batch(MegaClientAsyncQueue& queue) : mQueue(queue) {}
+        ~Batch() { flush(); }
+        MEGA_DISABLE_COPY_MOVE(Batch)
+
+        void push(Job f, bool discardable) { (discardable ? mDiscardable : mKept).push_back(std::move(f)); }
+        void flush();
+
+    private:
+        MegaClientAsyncQueue& mQueue;
+        std::vector<Job> mDiscardable;
+        std::vector<Job> mKept;
+    };
+
     MegaClientAsyncQueue(Waiter& w, unsigned threadCount);
     ~MegaClientAsyncQueue();
 
 private:
     Waiter& mWaiter;
-    std::mutex mMutex;
-    std::condition_variable mConditionVariable;
 
     struct Entry
     {
-        bool discardable = false;
-        std::function<void(SymmCipher&)> f;
-        Entry(bool disc, std::function<void(SymmCipher&)>&& func)
-             : discardable(disc), f(func)
+        // set when the job was discarded before it ran.  Null if not discardable
+        shared_ptr<std::atomic<bool>> discarded;
+        Job f;
+        Entry(shared_ptr<std::atomic<bool>> disc, Job&& func)
+             : discarded(std::move(disc)), f(std::move(func))
         {}
     };
 
-    std::deque<Entry> mQueue;
+    struct WorkerQueue
+    {
+        std::mutex mMutex;
+        std::deque<Entry> mEntries;
+    };
+
+    std::vector<unique_ptr<WorkerQueue>> mQueues;
     std::vector<std::thread> mThreads;
     SymmCipher mZeroThreadsCipher;
 
-    void asyncThreadLoop();
+    // flag shared by the discardable jobs queued since the last clearDiscardable()
+    shared_ptr<std::atomic<bool>> mDiscarded;
+
+    // queue the next push goes to
+    unsigned mNextQueue = 0;
+
+    // jobs queued and not yet taken by a worker
+    std::atomic<size_t> mPending{0};
+
+    // idle workers wait here
+    std::mutex mSleepMutex;
+    std::condition_variable mSleepCondition;
+    std::atomic<unsigned> mSleepers{0};
+    bool mExiting = false;
+
+    void wakeWorkers(size_t count);
+    bool take(unsigned own, Entry& entry);
+    void asyncThreadLoop(unsigned own);
 };
 
 template<class T>
@@ -754,6 +807,23 @@ public:
         return false;
     }
 
+    // Moves up to max entries onto the back of out, taking the lock only once.
+    // Lets a consumer drain a burst without contending with producers per entry.
+    size_t popFrontBatch(std::deque<T>& out, size_t max = std::numeric_limits<size_t>::max())
+    {
+        std::lock_guard<std::mutex> g(m);
+        if (out.empty() && max >= mNotifications.size())
+        {
+            std::swap(out, mNotifications);
+            return out.size();
+        }
+
+        size_t n = std::min(max, mNotifications.size());
+        std::move(mNotifications.begin(), mNotifications.begin() + static_cast<ptrdiff_t>(n), std::back_inserter(out));
+        mNotifications.erase(mNotifications.begin(), mNotifications.begin() + static_cast<ptrdiff_t>(n));
+        return n;
+    }
+
     void unpopFront(const T& t)
     {
         std::lock_guard<std::mutex> g(m);
@@ -763,7 +833,7 @@ public:
     void pushBack(T&& t)
     {
         std::lock_guard<std::mutex> g(m);
-        mNotifications.push_back(t);
+        mNotifications.push_back(std::move(t));
     }
 
     bool empty()
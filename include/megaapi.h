@@ -94,6 +94,7 @@ class MegaIntegerMap;
 class MegaIntegerList;
 class MegaSyncStall;
 class MegaSyncStallList;
+class MegaSyncStallChanges;
 class MegaVpnCredentials;
 class MegaNodeTree;
 class MegaCompleteUploadData;
@@ -4512,7 +4513,8 @@ class MegaRequest
             TYPE_UPDATE_PASSWORD_NODE                                       = 184,
             TYPE_GET_NOTIFICATIONS                                          = 185,
             TYPE_TAG_NODE                                                   = 186,
-            TOTAL_OF_REQUEST_TYPES                                          = 187,
+            TYPE_GET_SYNC_STALL_CHANGES                                     = 187,
+            TOTAL_OF_REQUEST_TYPES                                          = 188,
         };
 
         virtual ~MegaRequest();
@@ -5382,6 +5384,18 @@ class MegaRequest
          */
         virtual MegaSyncStallList* getMegaSyncStallList() const;
 
+        /**
+         * @brief
+         * Returns a reference to this request's MegaSyncStallChanges instance.
+         *
+         * This value is valid only for the following requests:
+         * - MegaApi::getMegaSyncStallChanges
+         *
+         * @return
+         * A reference to this request's MegaSyncStallChanges instance.
+         */
+        virtual MegaSyncStallChanges* getMegaSyncStallChanges() const;
+
 #endif // ENABLE_SYNC
 
         /**
@@ -7258,6 +7272,62 @@ class MegaSyncStallList
         virtual size_t size() const;
 };
 
+/**
+ * @brief Changes to the synchronization stalls since some version @see MegaApi::getMegaSyncStallChanges
+ *
+ * Each change is a stall that started or stopped being reported, or is now reported differently.
+ * Stalls are identified by their key: the same key in a later change replaces the earlier one.
+ */
+class MegaSyncStallChanges
+{
+    public:
+        virtual ~MegaSyncStallChanges() = default;
+        virtual MegaSyncStallChanges* copy() const;
+
+        /**
+         * @return number of changes, oldest first
+         */
+        virtual size_t size() const;
+
+        /**
+         * @param index of the change in the list.
+         * @return the stall as reported now, or NULL if it is no longer reported
+         */
+        virtual const MegaSyncStall* get(size_t index) const;
+
+        /**
+         * @param index of the change in the list.
+         * @return the key of the stall: a cloud path if isCloudKey(), otherwise a local path
+         */
+        virtual const char* key(size_t index) const;
+
+        /**
+         * @param index of the change in the list.
+         * @return true if the key of the stall is a cloud path
+         */
+        virtual bool isCloudKey(size_t index) const;
+
+        /**
+         * @return the version to pass to MegaApi::getMegaSyncStallChanges for the next changes
+         */
+        virtual long long getVersion() const;
+
+        /**
+         * @return true if there were more changes than were asked for
+         */
+        virtual bool hasMore() const;
+
+        /**
+         * @brief The changes asked for are no longer known
+         *
+         * The list then holds every stall currently reported, and any stall
+         * known from earlier calls should be dropped first.
+         *
+         * @return true if the caller must start again from this list
+         */
+        virtual bool isReset() const;
+};
+
 #endif // ENABLE_SYNC
 
 
@@ -16623,6 +16693,34 @@ class MegaApi
          */
         void getMegaSyncStallList(MegaRequestListener* listener);
 
+        /**
+         * @brief
+         * Get the changes to the sync stalls since an earlier call
+         *
+         * Unlike getMegaSyncStallList, only the stalls that started, stopped or
+         * changed since sinceVersion are returned, so polling is cheap while
+         * the stalls stay the same.  Name conflicts are not included, and
+         * stalls cleared with clearStalledPath are still reported.
+         *
+         * The type of this request is MegaRequest::TYPE_GET_SYNC_STALL_CHANGES.
+         * Valid data in the MegaRequest object received on callbacks:
+         * - MegaRequest::getNumber - Returns sinceVersion
+         *
+         * Valid data in the MegaRequest object received in onRequestFinish when the error code
+         * is MegaError::API_OK:
+         * - MegaRequest::getMegaSyncStallChanges - The changes, and the version to ask from next
+         *
+         * @param sinceVersion
+         * MegaSyncStallChanges::getVersion from the previous call, or 0 to get every stall
+         *
+         * @param maxChanges
+         * Maximum number of changes to return.  MegaSyncStallChanges::hasMore tells if there are more
+         *
+         * @param listener
+         * A MegaRequestListener with which to track the request.
+         */
+        void getMegaSyncStallChanges(long long sinceVersion, unsigned maxChanges, MegaRequestListener* listener = nullptr);
+
 
         /**
          * @brief
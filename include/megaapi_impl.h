@@ -1613,6 +1613,8 @@ class MegaRequestPrivate : public MegaRequest
 #ifdef ENABLE_SYNC
         MegaSyncStallList* getMegaSyncStallList() const override;
         void setMegaSyncStallList(unique_ptr<MegaSyncStallList>&& stalls);
+        MegaSyncStallChanges* getMegaSyncStallChanges() const override;
+        void setMegaSyncStallChanges(unique_ptr<MegaSyncStallChanges>&& changes);
 #endif // ENABLE_SYNC
 
 #ifdef ENABLE_CHAT
@@ -1729,6 +1731,7 @@ protected:
 
 #ifdef ENABLE_SYNC
         unique_ptr<MegaSyncStallList> mSyncStallList;
+        unique_ptr<MegaSyncStallChanges> mSyncStallChanges;
 #endif // ENABLE_SYNC
 
         unique_ptr<MegaNotificationList> mMegaNotifications;
@@ -2790,6 +2793,52 @@ class MegaSyncStallListPrivate : public MegaSyncStallList
         std::vector<std::shared_ptr<MegaSyncStall>> mStalls;
 };
 
+class MegaSyncStallChangesPrivate : public MegaSyncStallChanges
+{
+    public:
+        MegaSyncStallChangesPrivate(SyncStallChanges&&);
+
+        MegaSyncStallChangesPrivate* copy() const override;
+
+        size_t size() const override
+        {
+            return mChanges.size();
+        }
+
+        const MegaSyncStall* get(size_t i) const override;
+        const char* key(size_t i) const override;
+        bool isCloudKey(size_t i) const override;
+
+        long long getVersion() const override
+        {
+            return static_cast<long long>(mVersion);
+        }
+
+        bool hasMore() const override
+        {
+            return mMore;
+        }
+
+        bool isReset() const override
+        {
+            return mReset;
+        }
+
+    protected:
+        struct Change
+        {
+            // null if the stall was removed
+            std::shared_ptr<MegaSyncStall> stall;
+            string key;
+            bool cloud = false;
+        };
+
+        std::vector<Change> mChanges;
+        uint64_t mVersion = 0;
+        bool mMore = false;
+        bool mReset = false;
+};
+
 #endif // ENABLE_SYNC
 
 class MegaSearchFilterPrivate : public MegaSearchFilter
@@ -3137,6 +3186,8 @@ class MegaApiImpl : public MegaApp
         void startDownload (bool startFirst, MegaNode *node, const char* localPath, const char *customName, int folderTransferTag, const char *appData, CancelToken cancelToken, int collisionCheck, int collisionResolution, bool undelete, MegaTransferListener *listener);
         MegaTransferPrivate* createDownloadTransfer(bool startFirst, MegaNode *node, const char* localPath, const char *customName, int folderTransferTag, const char *appData, CancelToken cancelToken, int collisionCheck, int collisionResolution, bool undelete, MegaTransferListener *listener, FileSystemType fsType);
         void startStreaming(MegaNode* node, m_off_t startPos, m_off_t size, MegaTransferListener *listener);
+        // Local files downloaded earlier that may have the same contents as node (to be verified by the caller)
+        vector<LocalPath> getLocalCopies(MegaNode* node);
         void setStreamingMinimumRate(int bytesPerSecond);
         void retryTransfer(MegaTransfer *transfer, MegaTransferListener *listener = NULL);
         void cancelTransfer(MegaTransfer *transfer, MegaRequestListener *listener=NULL);
@@ -3250,6 +3301,7 @@ class MegaApiImpl : public MegaApp
         MegaSync *getSyncByNode(MegaNode *node);
         MegaSync *getSyncByPath(const char * localPath);
         void getMegaSyncStallList(MegaRequestListener* listener);
+        void getMegaSyncStallChanges(long long sinceVersion, unsigned maxChanges, MegaRequestListener* listener);
         void clearStalledPath(MegaSyncStall*);
 
         void moveToDebris(const char* path, MegaHandle syncBackupId, MegaRequestListener* listener = nullptr);
@@ -4280,6 +4332,8 @@ public:
     size_t availableCapacity() const;
     // Get the uv_buf_t for the consumer with as much buffered data as possible
     uv_buf_t nextBuffer();
+    // Same as nextBuffer(), but data wrapping around the end of the circular buffer is returned in a second uv_buf_t
+    unsigned nextBuffers(uv_buf_t (&buffers)[2]);
     // Increase the free data counter
     void freeData(size_t len);
     // Set upper bound limit for capacity
@@ -4332,6 +4386,221 @@ protected:
     int duration;
 };
 
+class MegaTCPContext;
+class MegaTCPSpillStore;
+
+// Sends a local file with the same contents as the node being served
+// straight from its descriptor to a plain (non TLS) connection, so that
+// the data isn't copied through the process.
+// Runs on the server's loop: the socket is non-blocking and polled for room.
+class MegaTCPFileSender
+{
+public:
+    MegaTCPFileSender() = default;
+    ~MegaTCPFileSender();
+
+    MEGA_DISABLE_COPY_MOVE(MegaTCPFileSender)
+
+    // Whether this platform can send files without copying them.
+    static bool isSupported();
+
+    // Detaches the sender from its connection, abandoning the chunk in flight.
+    // It's freed once libuv is done with its handles.
+    void detach();
+
+    int fileDescriptor = -1;
+
+    // Duplicate of the connection's socket, as libuv allows one handle per descriptor.
+    int socketDescriptor = -1;
+
+    // File offset of the next byte to send.
+    m_off_t offset = 0;
+
+    // Size of the chunk in flight and how much of it has been sent.
+    m_off_t length = 0;
+    m_off_t sent = 0;
+
+    // Cleared when the connection is closed.
+    MegaTCPContext* tcpctx = nullptr;
+
+    uv_poll_t poll;
+
+    // Set while the poll handle is initialized and not closing.
+    bool polling = false;
+
+    // Keeps this sender alive until its handles are closed.
+    std::shared_ptr<MegaTCPFileSender> self;
+
+    // Keeps spilled data from being trimmed while it's sent.
+    std::shared_ptr<void> pin;
+
+    // Set when sending spilled data, which may still be coming: chunks are
+    // sized to what's there, and otherwise retried after SPILL_WAIT_MS.
+    std::shared_ptr<MegaTCPSpillStore> spillStore;
+    handle node = UNDEF;
+    m_off_t end = 0;
+    static constexpr uint64_t SPILL_WAIT_MS = 20;
+
+    uv_timer_t timer;
+
+    // Set while the timer is initialized and not closing.
+    bool timing = false;
+
+    // Handles being closed.
+    int closing = 0;
+
+private:
+    static void onClosed(uv_handle_t* handle);
+};
+
+// Local copies of nodes whose fingerprint and MetaMAC were checked in the background,
+// with the identity the file had then. A copy is only served while it keeps that
+// identity, which the server thread tells with a stat() instead of reading the file.
+// Shared by an FTP server with its data servers.
+class MegaTCPVerifiedCopies
+{
+public:
+    static constexpr size_t MAX_ENTRIES = 256;
+
+    struct Identity
+    {
+        uint64_t device = 0;
+        uint64_t inode = 0;
+        m_off_t size = -1;
+
+        // nanoseconds
+        int64_t mtime = 0;
+        int64_t ctime = 0;
+
+        bool operator==(const Identity& other) const;
+    };
+
+    // Returns false if the file can't be stat()ed, or that isn't supported here.
+    static bool identify(int fileDescriptor, Identity& identity);
+    static bool identify(const LocalPath& path, Identity& identity);
+
+    // Whether the copy matched its node when it had this identity.
+    bool isVerified(const LocalPath& path, const Identity& identity);
+
+    // Returns false if the copy is being checked already, or didn't match with this identity.
+    bool startChecking(const LocalPath& path, const Identity& identity);
+
+    void checked(const LocalPath& path, const Identity& identity, bool matches);
+
+private:
+    struct Entry
+    {
+        bool checking = false;
+        bool matches = false;
+        Identity identity;
+    };
+
+    std::mutex mMutex;
+    std::map<LocalPath, Entry> mEntries;
+};
+
+// Data of streamed nodes that more than one request asked for, spilled to
+// unlinked temporary files at the same offsets as in the node. Requests for
+// ranges that were already fetched, or that another request is fetching, are
+// then sent from there, like a local copy, instead of fetched again.
+// Fed from the SDK thread and written by a thread of its own. Read by the server threads.
+class MegaTCPSpillStore
+{
+public:
+    // The files are created in directory, which ends in a separator.
+    explicit MegaTCPSpillStore(const std::string& directory);
+    ~MegaTCPSpillStore();
+
+    MEGA_DISABLE_COPY_MOVE(MegaTCPSpillStore)
+
+    static constexpr m_off_t MAX_BYTES = 256 * 1024 * 1024;
+    static constexpr size_t MAX_NODES = 8;
+
+    // Data queued but not written yet at most. More is dropped.
+    static constexpr size_t MAX_PENDING_BYTES = 16 * 1024 * 1024;
+
+    // Data trimmed from a node at once when making room.
+    static constexpr m_off_t TRIM_BYTES = 4 * 1024 * 1024;
+
+    // Queues data of a node received for a streaming request, if the node is being kept.
+    void write(handle node, m_off_t offset, const char* data, size_t len);
+
+    // A streaming request (fetcher) will receive [next, end) of the node, unless it ends first.
+    void fetching(const void* fetcher, handle node, m_off_t next, m_off_t end);
+    void fetchEnded(const void* fetcher);
+
+    // A request for [offset, offset + len) of the node. Returns a new descriptor
+    // to read it from, or -1 if any of that range is missing and not being fetched.
+    // The caller closes it, and holds pin while reading so that the data isn't trimmed.
+    // The node is kept from its second request on.
+    int open(handle node, m_off_t offset, m_off_t len, std::shared_ptr<void>& pin);
+
+    // How much of the node from offset, up to end, can be read now from an opened descriptor.
+    // 0 if that data is still coming, -1 if it won't.
+    m_off_t readable(handle node, m_off_t offset, m_off_t end);
+
+    // Waits until the data queued so far has been written.
+    void sync();
+
+    m_off_t bytes();
+
+private:
+    struct Entry
+    {
+        ~Entry();
+
+        handle node = UNDEF;
+        int fileDescriptor = -1;
+        std::map<m_off_t, m_off_t> ranges; // start -> end of the data held
+        m_off_t bytes = 0;
+
+        // pins held by requests being sent from the file
+        std::atomic<unsigned> readers{0};
+    };
+
+    struct Pending
+    {
+        std::shared_ptr<Entry> entry;
+        m_off_t offset;
+        std::string data;
+    };
+
+    struct Fetch
+    {
+        handle node;
+        m_off_t next;
+        m_off_t end;
+    };
+
+    std::string mDirectory;
+
+    std::mutex mMutex;
+    std::condition_variable mCondition;
+    std::list<std::shared_ptr<Entry>> mEntries; // most recently used first
+    std::list<handle> mRequested;               // nodes requested once, most recent first
+    m_off_t mBytes = 0;
+
+    std::deque<Pending> mPending;
+    size_t mPendingBytes = 0;
+    bool mWriting = false;
+
+    // the data being written while mWriting
+    std::shared_ptr<Entry> mWritingEntry;
+    m_off_t mWritingStart = 0;
+    m_off_t mWritingEnd = 0;
+
+    std::map<const void*, Fetch> mFetches;
+    bool mExiting = false;
+    std::thread mThread;
+
+    std::shared_ptr<Entry> find(handle node);
+    std::shared_ptr<Entry> create(handle node);
+    bool trim(m_off_t needed);
+    bool coming(const Entry& entry, m_off_t position, m_off_t end) const;
+    void writerLoop();
+    static m_off_t addRange(std::map<m_off_t, m_off_t>& ranges, m_off_t start, m_off_t end);
+};
+
 class MegaTCPServer;
 class MegaTCPContext : public MegaTransferListener, public MegaRequestListener
 {
@@ -4374,6 +4643,61 @@ public:
     m_off_t nodesize;
     int resultCode;
 
+    // Set when the data is sent from a local copy of the node.
+    std::shared_ptr<MegaTCPFileSender> fileSender;
+
+protected:
+    // Offers the data received for a streaming request to the server's spill store.
+    void spillTransferData(MegaTransfer* transfer, const char* buffer, size_t size);
+};
+
+// A write on a connection, recycled by its server once finished.
+class MegaTCPWriteRequest
+{
+public:
+    uv_write_t request;
+    MegaTCPContext* tcpctx = nullptr;
+    MegaTCPServer* server = nullptr;
+
+    // Copy of data that must outlive the call that queued the write.
+    std::string data;
+};
+
+// Rendered folder listings of a local server, so browsing a large folder
+// again doesn't fetch and format all of its children once more.
+// Filled by the server threads, invalidated from the SDK thread on node changes.
+class MegaListingCache
+{
+public:
+    static constexpr size_t MAX_ENTRIES = 16;
+    static constexpr size_t MAX_BYTES = 32 * 1024 * 1024;
+
+    // Read before fetching the children to render. A listing rendered from
+    // children fetched before an invalidation is not kept.
+    uint64_t generation();
+
+    // variant tells apart the different renderings of the same folder
+    bool get(handle folder, const std::string& variant, std::string& listing);
+    void put(handle folder, const std::string& variant, const std::string& listing, uint64_t generation);
+
+    void invalidate(handle folder);
+    void invalidate(const sharedNode_vector* nodes);
+    void clear();
+
+    size_t size();
+
+private:
+    struct Entry
+    {
+        handle folder;
+        std::string variant;
+        std::string listing;
+    };
+
+    std::mutex mMutex;
+    std::list<Entry> mEntries; // most recently used first
+    size_t mBytes = 0;
+    uint64_t mGeneration = 0;
 };
 
 class MegaTCPServer
@@ -4387,6 +4711,7 @@ protected:
     set<handle> allowedHandles;
     handle lastHandle;
     list<MegaTCPContext*> connections;
+    vector<unique_ptr<MegaTCPWriteRequest>> writeRequests;
     uv_async_t exit_handle;
     MegaApiImpl *megaApi;
     bool semaphoresdestroyed;
@@ -4447,6 +4772,21 @@ protected:
 
     void answer(MegaTCPContext* tcpctx, const char *rsp, size_t rlen);
 
+    // Write requests are pooled, as connections issue many small writes.
+    static const size_t MAX_POOLED_WRITE_REQUESTS = 32;
+    static MegaTCPWriteRequest* newWriteRequest(MegaTCPContext* tcpctx);
+    static void releaseWriteRequest(MegaTCPWriteRequest* request);
+
+    // Zero copy sending of a node's data from an identical local file.
+    static bool openLocalCopy(MegaTCPContext* tcpctx, MegaNode* node, m_off_t offset);
+    static void sendFileChunk(MegaTCPContext* tcpctx);
+    static void onFileChunkWritable(uv_poll_t* handle, int status, int events);
+    static void onSpillWait(uv_timer_t* handle);
+    static void checkLocalCopy(MegaTCPServer* server, const LocalPath& path, const MegaTCPVerifiedCopies::Identity& identity,
+                               const FileFingerprint& fingerprint, const std::string& nodeKey);
+    static void onLocalCopyCheck(uv_work_t* req);
+    static void onLocalCopyChecked(uv_work_t* req, int status);
+
 
     //virtual methods:
     virtual void processReceivedData(MegaTCPContext *tcpctx, ssize_t nread, const uv_buf_t * buf);
@@ -4461,6 +4801,11 @@ public:
     const bool useIPv6;
     const bool useTLS;
     MegaFileSystemAccess *fsAccess;
+    MegaListingCache listingCache;
+
+    // Shared by an FTP server with its data servers. No spill store without a basePath.
+    std::shared_ptr<MegaTCPSpillStore> spillStore;
+    std::shared_ptr<MegaTCPVerifiedCopies> verifiedCopies;
 
     std::string basePath;
 
@@ -4587,6 +4932,7 @@ protected:
     static std::string getHTTPMethodName(int httpmethod);
     static std::string getHTTPErrorString(int errorcode);
     static std::string getResponseForNode(MegaNode *node, MegaHTTPContext* httpctx);
+    static std::string getHtmlListingForNode(MegaNode *node, MegaHTTPContext* httpctx);
 
     // WEBDAV related
     static std::string getWebDavPropFindResponseForNode(std::string baseURL, std::string subnodepath, MegaNode *node, MegaHTTPContext* httpctx);
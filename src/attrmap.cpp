@@ -24,6 +24,21 @@
 #include <mega/json.h>
 
 namespace mega {
+
+size_t attr_map::heapSize() const
+{
+    size_t total = mValues.capacity() * sizeof(value_type);
+    for (auto& v : mValues)
+    {
+        // std::string keeps short values in its inline buffer
+        if (v.second.capacity() > string().capacity())
+        {
+            total += v.second.capacity() + 1;
+        }
+    }
+    return total;
+}
+
 // approximate raw storage size of serialized AttrMap, not taking JSON escaping
 // or name length into account
 unsigned AttrMap::storagesize(int perrecord) const
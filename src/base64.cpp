@@ -19,68 +19,52 @@
  * program.
  */
 
+#include <array>
+
 #include "mega/base64.h"
 #include "mega/utils.h"
 
 namespace mega {
-// modified base64 conversion (no trailing '=' and '-_' instead of '+/')
-unsigned char Base64::to64(byte c)
-{
-    c &= 63;
 
-    if (c < 26)
-    {
-        return static_cast<unsigned char>(c + 'A');
-    }
+namespace {
 
-    if (c < 52)
-    {
-        return static_cast<unsigned char>(c - 26 + 'a');
-    }
+// modified base64 alphabet (no trailing '=' and '-_' instead of '+/')
+constexpr char ENCODE_TABLE[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_";
 
-    if (c < 62)
-    {
-        return static_cast<unsigned char>(c - 52 + '0');
-    }
+// 255 for characters out of the alphabet. Both '-_' and '+/' are accepted
+constexpr std::array<byte, 256> makeDecodeTable()
+{
+    std::array<byte, 256> table{};
 
-    if (c == 62)
+    for (auto& value : table)
     {
-        return '-';
+        value = 255;
     }
 
-    return '_';
-}
-
-unsigned char Base64::from64(byte c)
-{
-    if ((c >= 'A') && (c <= 'Z'))
+    for (byte i = 0; i < 64; ++i)
     {
-        return static_cast<unsigned char>(c - 'A');
+        table[static_cast<byte>(ENCODE_TABLE[i])] = i;
     }
 
-    if ((c >= 'a') && (c <= 'z'))
-    {
-        return static_cast<unsigned char>(c - 'a' + 26);
-    }
+    table['+'] = 62;
+    table['/'] = 63;
 
-    if ((c >= '0') && (c <= '9'))
-    {
-        return static_cast<unsigned char>(c - '0' + 52);
-    }
+    return table;
+}
 
-    if (c == '-' || c == '+')
-    {
-        return static_cast<unsigned char>(62);
-    }
+constexpr std::array<byte, 256> DECODE_TABLE = makeDecodeTable();
 
-    if (c == '_' || c == '/')
-    {
-        return static_cast<unsigned char>(63);
-    }
+} // namespace
 
-    return static_cast<unsigned char>(255);
+unsigned char Base64::to64(byte c)
+{
+    return static_cast<unsigned char>(ENCODE_TABLE[c & 63]);
 }
 
+unsigned char Base64::from64(byte c)
+{
+    return DECODE_TABLE[c];
+}
 
 int Base64::atob(const string &in, string &out)
 {
@@ -105,6 +89,29 @@ int Base64::atob(const char* a, byte* b, int blen)
     int i;
     int p = 0;
 
+    // complete groups of four characters, without per-byte bounds checks.
+    // Characters are validated one by one so that nothing is read past the
+    // first invalid one (usually the terminating NUL)
+    while (p + 3 <= blen
+           && (c[0] = DECODE_TABLE[static_cast<byte>(a[0])]) != 255
+           && (c[1] = DECODE_TABLE[static_cast<byte>(a[1])]) != 255
+           && (c[2] = DECODE_TABLE[static_cast<byte>(a[2])]) != 255
+           && (c[3] = DECODE_TABLE[static_cast<byte>(a[3])]) != 255)
+    {
+        uint32_t group = static_cast<uint32_t>(c[0]) << 18
+                       | static_cast<uint32_t>(c[1]) << 12
+                       | static_cast<uint32_t>(c[2]) << 6
+                       | c[3];
+
+        b[p] = static_cast<byte>(group >> 16);
+        b[p + 1] = static_cast<byte>(group >> 8);
+        b[p + 2] = static_cast<byte>(group);
+
+        p += 3;
+        a += 4;
+    }
+
+    // the last, incomplete group
     for (;;)
     {
         for (i = 0; i < 4; i++)
@@ -223,6 +230,22 @@ int Base64::btoa(const byte* b, int blen, char* a)
 {
     int p = 0;
 
+    // complete groups of three bytes
+    for (; blen >= 3; blen -= 3, b += 3)
+    {
+        uint32_t group = static_cast<uint32_t>(b[0]) << 16
+                       | static_cast<uint32_t>(b[1]) << 8
+                       | b[2];
+
+        a[p] = ENCODE_TABLE[group >> 18];
+        a[p + 1] = ENCODE_TABLE[(group >> 12) & 63];
+        a[p + 2] = ENCODE_TABLE[(group >> 6) & 63];
+        a[p + 3] = ENCODE_TABLE[group & 63];
+
+        p += 4;
+    }
+
+    // the last, incomplete group
     for (;;)
     {
         if (blen <= 0)
@@ -1212,7 +1212,17 @@ CommandPutNodes::CommandPutNodes(MegaClient* client, NodeHandle th,
 // add new nodes and handle->node handle mapping
 void CommandPutNodes::removePendingDBRecordsAndTempFiles()
 {
-    pendingdbid_map::iterator it = client->pendingtcids.find(tag);
+    removePendingDBRecordsAndTempFiles(tag);
+
+    for (int coalescedTag : mCoalescedTags)
+    {
+        removePendingDBRecordsAndTempFiles(coalescedTag);
+    }
+}
+
+void CommandPutNodes::removePendingDBRecordsAndTempFiles(int pendingTag)
+{
+    pendingdbid_map::iterator it = client->pendingtcids.find(pendingTag);
     if (it != client->pendingtcids.end())
     {
         if (client->tctable)
@@ -1229,7 +1239,7 @@ void CommandPutNodes::removePendingDBRecordsAndTempFiles()
         }
         client->pendingtcids.erase(it);
     }
-    pendingfiles_map::iterator pit = client->pendingfiles.find(tag);
+    pendingfiles_map::iterator pit = client->pendingfiles.find(pendingTag);
     if (pit != client->pendingfiles.end())
     {
         vector<LocalPath> &pfs = pit->second;
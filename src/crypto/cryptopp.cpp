@@ -738,6 +738,61 @@ void SymmCipher::ctr_crypt(byte* data, unsigned len, m_off_t pos, ctr_iv ctriv,
     }
 }
 
+SymmKey::SymmKey(const byte* newkey)
+{
+    memcpy(key, newkey, sizeof key);
+}
+
+SymmCipher* SymmKey::cipher() const
+{
+    // least recently used expanded keys of this thread
+    struct CachedCipher
+    {
+        std::unique_ptr<SymmCipher> cipher;
+        uint64_t lastUse = 0;
+    };
+
+    thread_local CachedCipher cache[CIPHER_CACHE_SIZE];
+    thread_local uint64_t useCounter = 0;
+
+    CachedCipher* victim = &cache[0];
+    for (auto& entry : cache)
+    {
+        if (entry.cipher && !memcmp(entry.cipher->key, key, sizeof key))
+        {
+            entry.lastUse = ++useCounter;
+            return entry.cipher.get();
+        }
+
+        if (entry.lastUse < victim->lastUse)
+        {
+            victim = &entry;
+        }
+    }
+
+    if (victim->cipher)
+    {
+        victim->cipher->setkey(key);
+    }
+    else
+    {
+        victim->cipher.reset(new SymmCipher(key));
+    }
+
+    victim->lastUse = ++useCounter;
+    return victim->cipher.get();
+}
+
+void SymmKey::ecb_encrypt(byte* data, byte* dst, size_t len) const
+{
+    cipher()->ecb_encrypt(data, dst, len);
+}
+
+void SymmKey::ecb_decrypt(byte* data, size_t len) const
+{
+    cipher()->ecb_decrypt(data, len);
+}
+
 static void rsaencrypt(const Integer* key, Integer* m)
 {
     *m = a_exp_b_mod_c(*m, key[AsymmCipher::PUB_E], key[AsymmCipher::PUB_PQ]);
@@ -655,6 +655,13 @@ void SqliteDbTable::rewind()
 
     int result = SQLITE_OK;
 
+    if (pStmt && pStmtByType)
+    {
+        sqlite3_finalize(pStmt);
+        pStmt = NULL;
+    }
+    pStmtByType = false;
+
     if (pStmt)
     {
         result = sqlite3_reset(pStmt);
@@ -667,6 +674,30 @@ void SqliteDbTable::rewind()
     errorHandler(result, "Rewind", false);
 }
 
+void SqliteDbTable::rewindByType(uint32_t type)
+{
+    if (!db)
+    {
+        return;
+    }
+
+    sqlite3_finalize(pStmt);
+    pStmt = nullptr;
+    pStmtByType = true;
+
+    int result = sqlite3_prepare_v2(db, "SELECT id, content FROM statecache WHERE (id & ?) = ?", -1, &pStmt, NULL);
+    if (result == SQLITE_OK)
+    {
+        result = sqlite3_bind_int(pStmt, 1, IDSPACING - 1);
+    }
+    if (result == SQLITE_OK)
+    {
+        result = sqlite3_bind_int(pStmt, 2, static_cast<int>(type));
+    }
+
+    errorHandler(result, "Rewind by type", false);
+}
+
 // retrieve next record through cursor
 bool SqliteDbTable::next(uint32_t* index, string* data)
 {
@@ -401,12 +401,8 @@ void File::sendPutnodesOfUpload(MegaClient* client, UploadHandle fileAttrMatchHa
             }
         }
 
-        client->reqs.add(new CommandPutNodes(client,
-                                             th, NULL,
-                                             mVersioningOption,
-                                             std::move(newnodes),
-                                             tag,
-                                             source, nullptr, std::move(completion), canChangeVault));
+        // coalesced with other uploads completing into the same folder
+        client->putnodesOfUpload(th, mVersioningOption, std::move(*newnode), tag, source, canChangeVault, std::move(completion));
     }
 }
 
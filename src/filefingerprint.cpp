@@ -122,6 +122,20 @@ FileFingerprint& FileFingerprint::operator=(const FileFingerprint& other)
     return *this;
 }
 
+// offsets of the blocks sampled by the sparse CRCs of a large file
+vector<m_off_t> FileFingerprint::sparseoffsets(m_off_t size, unsigned blocksize, unsigned count)
+{
+    vector<m_off_t> offsets;
+    offsets.reserve(count);
+
+    for (unsigned i = 0; i < count; i++)
+    {
+        offsets.push_back(m_off_t(uint64_t(size - blocksize) * i / (count - 1)));
+    }
+
+    return offsets;
+}
+
 bool FileFingerprint::genfingerprint(FileAccess* fa, bool ignoremtime)
 {
     bool changed = false;
@@ -192,14 +206,15 @@ bool FileFingerprint::genfingerprint(FileAccess* fa, bool ignoremtime)
         byte block[4 * sizeof crc];
         const unsigned blocks = MAXFULL / unsigned(sizeof block * crc.size());
 
+        // let the system fetch all the blocks concurrently
+        auto offsets = sparseoffsets(size, sizeof block, unsigned(crc.size()) * blocks);
+        fa->prefetch(offsets, sizeof block);
+
         for (unsigned i = 0; i < crc.size(); i++)
         {
             for (unsigned j = 0; j < blocks; j++)
             {
-                if (!fa->frawread(block, sizeof block,
-                                  (size - sizeof block)
-                                  * (i * blocks + j)
-                                  / (crc.size() * blocks - 1), true, FSLogging::logOnError))
+                if (!fa->frawread(block, sizeof block, offsets[i * blocks + j], true, FSLogging::logOnError))
                 {
                     size = -1;
                     fa->closef();
@@ -299,13 +314,15 @@ bool FileFingerprint::genfingerprint(InputStreamAccess *is, m_time_t cmtime, boo
         const unsigned blocks = MAXFULL / unsigned(sizeof block * crc.size());
         m_off_t current = 0;
 
+        // let the system fetch all the blocks concurrently
+        auto offsets = sparseoffsets(size, sizeof block, unsigned(crc.size()) * blocks);
+        is->prefetch(offsets, sizeof block);
+
         for (unsigned i = 0; i < crc.size(); i++)
         {
             for (unsigned j = 0; j < blocks; j++)
             {
-                m_off_t offset = (size - sizeof block)
-                        * (i * blocks + j)
-                        / (crc.size() * blocks - 1);
+                m_off_t offset = offsets[i * blocks + j];
 
                 //Seek
                 for (m_off_t fullstep = offset - current; fullstep > 0; )  // 500G or more and the step doesn't fit in 32 bits
@@ -33,6 +33,7 @@
 
 #include <cassert>
 #include <tuple>
+#include <unordered_map>
 
 #ifdef TARGET_OS_MAC
 #include "mega/osx/osxutils.h"
@@ -938,10 +939,64 @@ void FileSystemAccess::unescapefsincompatible(string *name) const
     }
 }
 
+// whether NFC normalization would leave this UTF-8 text unchanged, without decoding it:
+// true for ASCII, and for text with only two-byte sequences below U+0300 (no code point
+// there can be composed or decomposed).  False doesn't mean it's not NFC, just that we can't tell cheaply.
+static bool isTriviallyNFC(const char* s, size_t size)
+{
+    size_t i = 0;
+
+    // plain ASCII is by far the most common case, check a word at a time
+    for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t))
+    {
+        uint64_t word;
+        memcpy(&word, s + i, sizeof(word));
+        if (word & 0x8080808080808080ull) break;
+    }
+
+    while (i < size)
+    {
+        auto c = static_cast<unsigned char>(s[i]);
+        if (c < 0x80)
+        {
+            ++i;
+        }
+        else if (c >= 0xC2 && c <= 0xCB &&  // U+0080 to U+02FF
+                 i + 1 < size &&
+                 (static_cast<unsigned char>(s[i + 1]) & 0xC0) == 0x80)
+        {
+            i += 2;
+        }
+        else
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
 void LocalPath::utf8_normalize(string* filename)
 {
     if (!filename) return;
 
+    if (isTriviallyNFC(filename->data(), filename->size()))
+    {
+        return;
+    }
+
+    // names that need the full normalization tend to come up repeatedly (sync scans, searches)
+    // so keep a small per-thread memo of the recent ones
+    static const size_t MAX_MEMO_ENTRIES = 1024;
+    static thread_local std::unordered_map<string, string> memo;
+
+    auto it = memo.find(*filename);
+    if (it != memo.end())
+    {
+        *filename = it->second;
+        return;
+    }
+
     const char* cfilename = filename->c_str();
     size_t fnsize = filename->size();
     string result;
@@ -971,6 +1026,12 @@ void LocalPath::utf8_normalize(string* filename)
         i += strlen(substring);
     }
 
+    if (memo.size() >= MAX_MEMO_ENTRIES)
+    {
+        memo.clear();
+    }
+    memo.emplace(std::move(*filename), result);
+
     *filename = std::move(result);
 }
 
@@ -1009,6 +1070,27 @@ bool FileSystemAccess::fileExistsAt(const LocalPath& path)
     return fa->isfile(path);
 }
 
+const char* FileSystemAccess::copyMethodName(CopyMethod method)
+{
+    switch (method)
+    {
+    case COPY_METHOD_NONE:
+        return "none";
+    case COPY_METHOD_CLONE:
+        return "reflink";
+    case COPY_METHOD_FILE_RANGE:
+        return "copy_file_range";
+    case COPY_METHOD_SENDFILE:
+        return "sendfile";
+    case COPY_METHOD_SYSTEM:
+        return "system copy";
+    case COPY_METHOD_READ_WRITE:
+        return "read/write";
+    }
+
+    return "unknown";
+}
+
 #ifdef ENABLE_SYNC
 
 // default DirNotify: no notification available
@@ -1055,6 +1137,44 @@ void DirNotify::notify(NotificationDeque& q, LocalNode* l, Notification::ScanReq
     q.pushBack(std::move(n));
 }
 
+void DirNotify::notifyClosedAfterWrite(const LocalPath& fullPath, m_time_t when, m_off_t size, m_time_t mtime)
+{
+    std::lock_guard<std::mutex> g(mMutex);
+
+    if (mClosedAfterWrite.size() >= MAX_CLOSED_AFTER_WRITE)
+    {
+        // files nobody asked about in a while are not going to be asked about anymore
+        for (auto it = mClosedAfterWrite.begin(); it != mClosedAfterWrite.end(); )
+        {
+            if (when - it->second.when > 60)
+            {
+                it = mClosedAfterWrite.erase(it);
+            }
+            else
+            {
+                ++it;
+            }
+        }
+
+        if (mClosedAfterWrite.size() >= MAX_CLOSED_AFTER_WRITE)
+        {
+            mClosedAfterWrite.clear();
+        }
+    }
+
+    mClosedAfterWrite[fullPath] = ClosedAfterWrite{when, size, mtime};
+}
+
+bool DirNotify::fileSettled(const LocalPath& fullPath, m_off_t size, m_time_t mtime)
+{
+    std::lock_guard<std::mutex> g(mMutex);
+
+    auto it = mClosedAfterWrite.find(fullPath);
+    return it != mClosedAfterWrite.end()
+           && it->second.size == size
+           && it->second.mtime == mtime;
+}
+
 DirNotify* FileSystemAccess::newdirnotify(LocalNode&, const LocalPath& rootPath, Waiter*)
 {
     return new DirNotify(rootPath);
@@ -1437,6 +1557,11 @@ bool FileInputStream::read(byte *buffer, unsigned size)
     return false;
 }
 
+void FileInputStream::prefetch(const vector<m_off_t>& offsets, unsigned length)
+{
+    fileAccess->prefetch(offsets, length);
+}
+
 bool LocalPath::empty() const
 {
     assert(invariant());
@@ -2335,6 +2460,7 @@ bool FileDistributor::distributeTo(LocalPath& lp, FileSystemAccess& fsaccess, Ta
                 LOG_debug << "Moving instead of renaming temporary file to target path";
                 if (copyTo(theFile, lp, mMtime, method, fsaccess, transient_error, name_too_long, syncForDebris, confirmFingerprint))
                 {
+                    LOG_debug << "Copied temporary file to target path via " << FileSystemAccess::copyMethodName(fsaccess.last_copy_method);
                     if (!fsaccess.unlinklocal(theFile))
                     {
                         LOG_debug << "Could not remove temp file after final destination copy: " << theFile;
@@ -2350,6 +2476,7 @@ bool FileDistributor::distributeTo(LocalPath& lp, FileSystemAccess& fsaccess, Ta
             // otherwise copy
             if (copyTo(theFile, lp, mMtime, method, fsaccess, transient_error, name_too_long, syncForDebris, confirmFingerprint))
             {
+                LOG_debug << "Copied downloaded file to target path via " << FileSystemAccess::copyMethodName(fsaccess.last_copy_method);
                 removeTarget();
                 return true;
             }
@@ -2370,6 +2497,161 @@ void FileDistributor::removeTarget()
         theFile.clear();
 }
 
+void LocalFileIndex::add(const FileFingerprint& fingerprint, int64_t metaMac, const LocalPath& path)
+{
+    if (!fingerprint.isvalid)
+    {
+        return;
+    }
+
+    remove(path);
+
+    if (mEntries.size() >= MAX_ENTRIES)
+    {
+        remove(LocalPath(mEntries.front().path));
+    }
+
+    auto it = mEntries.insert(mEntries.end(), Entry{fingerprint, metaMac, path});
+    mByFingerprint.emplace(&it->fingerprint, it);
+    mByPath.emplace(path, it);
+}
+
+void LocalFileIndex::remove(const LocalPath& path)
+{
+    auto pathIt = mByPath.find(path);
+    if (pathIt == mByPath.end())
+    {
+        return;
+    }
+
+    auto entryIt = pathIt->second;
+    auto range = mByFingerprint.equal_range(&entryIt->fingerprint);
+    for (auto it = range.first; it != range.second; ++it)
+    {
+        if (it->second == entryIt)
+        {
+            mByFingerprint.erase(it);
+            break;
+        }
+    }
+
+    mByPath.erase(pathIt);
+    mEntries.erase(entryIt);
+}
+
+vector<LocalPath> LocalFileIndex::candidates(const FileFingerprint& fingerprint, int64_t metaMac) const
+{
+    vector<LocalPath> paths;
+
+    if (!fingerprint.isvalid)
+    {
+        return paths;
+    }
+
+    auto range = mByFingerprint.equal_range(&fingerprint);
+    for (auto it = range.first; it != range.second; ++it)
+    {
+        if (it->second->metaMac == metaMac)
+        {
+            paths.push_back(it->second->path);
+        }
+    }
+
+    // same fingerprint entries are kept in insertion order
+    std::reverse(paths.begin(), paths.end());
+    return paths;
+}
+
+void LocalFileIndex::clear()
+{
+    mByFingerprint.clear();
+    mByPath.clear();
+    mEntries.clear();
+}
+
+size_t LocalFileIndex::size() const
+{
+    return mEntries.size();
+}
+
+LocalFileCopy::LocalFileCopy(vector<LocalPath>&& candidates, const LocalPath& target,
+                             const FileFingerprint& fingerprint, const string& nodeKey)
+    : mCandidates(std::move(candidates))
+    , mTarget(target)
+    , mFingerprint(fingerprint)
+    , mNodeKey(nodeKey)
+{
+    assert(mNodeKey.size() == FILENODEKEYLENGTH);
+}
+
+void LocalFileCopy::run()
+{
+    // this runs on a worker thread: don't share the client's FileSystemAccess
+    FSACCESS_CLASS fsAccess;
+    bool copied = false;
+
+    for (auto& candidate : mCandidates)
+    {
+        {
+            std::lock_guard<std::mutex> g(mMutex);
+            if (mCancelled)
+            {
+                break;
+            }
+        }
+
+        if (!fsAccess.copylocal(candidate, mTarget, mFingerprint.mtime))
+        {
+            LOG_debug << "Unable to copy local source for download: " << candidate;
+            mStale.push_back(candidate);
+            continue;
+        }
+
+        auto fa = fsAccess.newfileaccess();
+        bool verified = false;
+
+        if (fa->fopen(mTarget, true, false, FSLogging::logOnError))
+        {
+            FileFingerprint fingerprint;
+            fingerprint.genfingerprint(fa.get());
+
+            verified = fingerprint.isvalid
+                       && fingerprint == mFingerprint
+                       && CompareLocalFileMetaMacWithNodeKey(fa.get(), mNodeKey, FILENODE);
+        }
+
+        if (verified)
+        {
+            LOG_debug << "Download produced from local file " << candidate
+                      << " via " << FileSystemAccess::copyMethodName(fsAccess.last_copy_method);
+            copied = true;
+            break;
+        }
+
+        LOG_debug << "Local source for download has different contents: " << candidate;
+        fa.reset();
+        fsAccess.unlinklocal(mTarget);
+        mStale.push_back(candidate);
+    }
+
+    std::lock_guard<std::mutex> g(mMutex);
+
+    if (copied && mCancelled)
+    {
+        fsAccess.unlinklocal(mTarget);
+        copied = false;
+    }
+
+    mStatus = copied ? SUCCEEDED : FAILED;
+}
+
+bool LocalFileCopy::cancel()
+{
+    std::lock_guard<std::mutex> g(mMutex);
+    mCancelled = true;
+    return mStatus == SUCCEEDED;
+}
+
 bool isNetworkFilesystem(FileSystemType type)
 {
     return type == FS_CIFS
@@ -28,8 +28,6 @@ namespace mega {
 
 #ifdef ENABLE_SYNC
 
-static constexpr int FREQUENCY_HEARTBEAT_DS = 300;
-
 HeartBeatBackupInfo::HeartBeatBackupInfo()
 {
 }
@@ -112,6 +110,54 @@ void HeartBeatSyncInfo::updateSPHBStatus(UnifiedSync& us)
     }
 }
 
+void HeartBeatSyncInfo::update(UnifiedSync& us)
+{
+    if (us.mSync)
+    {
+        auto counts = us.mSync->threadSafeState->transferCounts();
+
+        if (mSnapshotTransferCounts != counts)
+        {
+            mSnapshotTransferCounts = counts;
+            updateLastActionTime();
+        }
+    }
+
+    updateSPHBStatus(us);
+}
+
+bool HeartBeatSyncInfo::Report::operator==(const Report& o) const
+{
+    return backupId == o.backupId &&
+           status == o.status &&
+           progress == o.progress &&
+           pendingUps == o.pendingUps &&
+           pendingDowns == o.pendingDowns &&
+           lastAction == o.lastAction &&
+           lastItemUpdated == o.lastItemUpdated;
+}
+
+bool HeartBeatSyncInfo::reportDue(const Report& report, m_time_t now) const
+{
+    if (mSending) return false;
+
+    auto elapsedSec = now - lastBeat();
+
+    return elapsedSec >= MAX_HEARBEAT_SECS_DELAY ||
+           (elapsedSec >= MIN_HEARTBEAT_SECS_DELAY && report != mLastReport);
+}
+
+void HeartBeatSyncInfo::reported(const Report& report, m_time_t now)
+{
+    mLastReport = report;
+    setLastBeat(now);
+}
+
+bool HeartBeatSyncInfo::mayBeatEarly(m_time_t now) const
+{
+    return !mSending && now - lastBeat() >= MIN_HEARTBEAT_SECS_DELAY;
+}
+
 BackupInfoSync::BackupInfoSync(const SyncConfig& config, const string& device, handle drive, CommandBackupPut::SPState calculatedState)
 {
     backupId = config.mBackupId;
@@ -257,11 +303,86 @@ BackupType BackupInfoSync::getSyncType(const SyncConfig& config)
     }
 }
 
+void HeartBeatBatch::put(const BackupInfoSync& info)
+{
+    for (auto& p : mPuts)
+    {
+        if (p.backupId == info.backupId)
+        {
+            p = info;
+            return;
+        }
+    }
+    mPuts.push_back(info);
+}
+
+void HeartBeatBatch::beat(const HeartBeatSyncInfo::Report& report, BeatCompletion completion)
+{
+    for (auto& b : mBeats)
+    {
+        if (b.first.backupId == report.backupId)
+        {
+            // let the superseded beat's owner know it is no longer in flight
+            if (b.second) b.second(API_OK);
+            b = std::make_pair(report, std::move(completion));
+            return;
+        }
+    }
+    mBeats.emplace_back(report, std::move(completion));
+}
+
+bool HeartBeatBatch::empty() const
+{
+    return mPuts.empty() && mBeats.empty();
+}
+
+size_t HeartBeatBatch::size() const
+{
+    return mPuts.size() + mBeats.size();
+}
+
+void HeartBeatBatch::send(MegaClient& mc)
+{
+    // updates first, so the API knows the state a heartbeat refers to
+    for (auto& p : mPuts)
+    {
+        mc.reqs.add(new CommandBackupPut(&mc, p, nullptr));
+    }
+
+    for (auto& b : mBeats)
+    {
+        const auto& r = b.first;
+        mc.reqs.add(
+            new CommandBackupPutHeartBeat(&mc, r.backupId, r.status,
+                r.progress, r.pendingUps, r.pendingDowns,
+                r.lastAction, r.lastItemUpdated,
+                std::move(b.second)));
+    }
+
+    mPuts.clear();
+    mBeats.clear();
+}
+
 BackupMonitor::BackupMonitor(Syncs& s)
     : syncs(s)
 {
 }
 
+void BackupMonitor::flush()
+{
+    if (mBatch.empty()) return;
+
+    LOG_verbose << "Sending " << mBatch.mPuts.size() << " backup updates and "
+                << mBatch.mBeats.size() << " heartbeats";
+
+    auto batch = std::make_shared<HeartBeatBatch>();
+    std::swap(*batch, mBatch);
+    syncs.queueClient([batch](MegaClient& mc, DBTableTransactionCommitter&)
+        {
+            batch->send(mc);
+        });
+}
+
 void BackupMonitor::updateOrRegisterSync(UnifiedSync& us)
 {
     assert(syncs.onSyncThread());
@@ -276,10 +397,10 @@ void BackupMonitor::updateOrRegisterSync(UnifiedSync& us)
     auto currentInfo = BackupInfoSync(us, syncs.mDownloadsPaused, syncs.mUploadsPaused);
     if (!us.mBackupInfo || currentInfo != *us.mBackupInfo)
     {
-        syncs.queueClient([currentInfo](MegaClient& mc, DBTableTransactionCommitter& committer)
-            {
-                mc.reqs.add(new CommandBackupPut(&mc, currentInfo, nullptr));
-            });
+        mBatch.put(currentInfo);
+
+        // outside of a heartbeat pass, state changes are reported straight away
+        if (!mInBeat) flush();
     }
     us.mBackupInfo = std::make_unique<BackupInfoSync>(currentInfo);
 }
@@ -302,7 +423,7 @@ bool BackupInfoSync::operator!=(const BackupInfoSync &o) const
     return !(*this == o);
 }
 
-void BackupMonitor::beatBackupInfo(UnifiedSync& us)
+void BackupMonitor::beatBackupInfo(UnifiedSync& us, m_time_t now)
 {
     assert(syncs.onSyncThread());
 
@@ -318,66 +439,47 @@ void BackupMonitor::beatBackupInfo(UnifiedSync& us)
     }
 
     std::shared_ptr<HeartBeatSyncInfo> hbs = us.mNextHeartbeat;
+    hbs->update(us);
 
+    m_off_t inflightProgress = 0;
     if (us.mSync)
     {
-        auto counts = us.mSync->threadSafeState->transferCounts();
-
-        if (hbs->mSnapshotTransferCounts != counts)
-        {
-            hbs->mSnapshotTransferCounts = counts;
-            hbs->updateLastActionTime();
-        }
+        // to be figured out for sync rework
+        //inflightProgress = us.mSync->getInflightProgress();
     }
 
-    hbs->updateSPHBStatus(us);
+    auto reportCounts = hbs->mSnapshotTransferCounts;
+    reportCounts -= hbs->mResolvedTransferCounts;
 
-    auto elapsedSec = m_time(nullptr) - hbs->lastBeat();
+    HeartBeatSyncInfo::Report report;
+    report.backupId = us.mConfig.mBackupId;
+    report.status = hbs->sphbStatus();
+    report.progress = uint8_t(100.0 * reportCounts.progress(inflightProgress));
+    report.pendingUps = static_cast<uint32_t>(reportCounts.mUploads.mPending);
+    report.pendingDowns = static_cast<uint32_t>(reportCounts.mDownloads.mPending);
+    report.lastAction = hbs->lastAction();
+    report.lastItemUpdated = hbs->lastItemUpdated();
 
-    if ( !hbs->mSending &&
-         (elapsedSec >= MAX_HEARBEAT_SECS_DELAY ||
-         (elapsedSec*10 >= FREQUENCY_HEARTBEAT_DS && hbs->mModified)))
+    if (report == hbs->lastReport())
     {
+        // nothing to tell after all, eg. a status that changed back
+        hbs->mModified = false;
+    }
 
-        hbs->setLastBeat(m_time(nullptr));
-
-        m_off_t inflightProgress = 0;
-        if (us.mSync)
-        {
-            // to be figured out for sync rework
-            //inflightProgress = us.mSync->getInflightProgress();
-        }
-
-        auto reportCounts = hbs->mSnapshotTransferCounts;
-        reportCounts -= hbs->mResolvedTransferCounts;
-
-        auto progress = uint8_t(100.0 * reportCounts.progress(inflightProgress));
-
-        hbs->mSending = true;
+    if (!hbs->reportDue(report, now)) return;
 
-        auto backupId = us.mConfig.mBackupId;
-        auto status = hbs->sphbStatus();
-        auto pendingUps = static_cast<uint32_t>(reportCounts.mUploads.mPending);
-        auto pendingDowns = static_cast<uint32_t>(reportCounts.mUploads.mPending);
-        auto lastAction = hbs->lastAction();
-        auto lastItemUpdated = hbs->lastItemUpdated();
+    hbs->reported(report, now);
+    hbs->mSending = true;
 
-        syncs.queueClient([=](MegaClient& mc, DBTableTransactionCommitter& committer)
-            {
-                mc.reqs.add(
-                    new CommandBackupPutHeartBeat(&mc, backupId, status,
-                        progress, pendingUps, pendingDowns,
-                        lastAction, lastItemUpdated,
-                        [hbs](Error){
-                            hbs->mSending = false;
-                        }));
-            });
-
-        if (progress >= 100)
+    mBatch.beat(report, [hbs](Error)
         {
-            // once we reach 100%, start counting again from 0 for any later sync activity.
-            hbs->mResolvedTransferCounts = hbs->mSnapshotTransferCounts;
-        }
+            hbs->mSending = false;
+        });
+
+    if (report.progress >= 100)
+    {
+        // once we reach 100%, start counting again from 0 for any later sync activity.
+        hbs->mResolvedTransferCounts = hbs->mSnapshotTransferCounts;
     }
 }
 
@@ -385,14 +487,48 @@ void BackupMonitor::beat()
 {
     assert(syncs.onSyncThread());
 
+    auto now = m_time(nullptr);
+
+    // Changing backups are reported at most every MIN_HEARTBEAT_SECS_DELAY anyway,
+    // so check them all together at that interval and send their beats as one batch.
+    bool pass = now >= mNextBeat;
+    if (pass)
+    {
+        mNextBeat = now + HeartBeatSyncInfo::MIN_HEARTBEAT_SECS_DELAY;
+    }
+
+    mInBeat = true;
+
     // Only send heartbeats for enabled active syncs.
     for (auto& us : syncs.mSyncVec)
     {
-        if (us->mSync && us->mConfig.getEnabled())
+        if (!us->mSync || !us->mConfig.getEnabled())
         {
-            beatBackupInfo(*us);
+            continue;
         }
-    };
+
+        // Between passes, only the counts and status are looked at, so that a backup
+        // changing after a quiet spell is reported now rather than at the next pass.
+        if (!pass)
+        {
+            auto& hbs = *us->mNextHeartbeat;
+            if (!hbs.mayBeatEarly(now))
+            {
+                continue;
+            }
+
+            hbs.update(*us);
+            if (!hbs.mModified)
+            {
+                continue;
+            }
+        }
+
+        beatBackupInfo(*us, now);
+    }
+
+    mInBeat = false;
+    flush();
 }
 
 #endif
@@ -502,7 +502,10 @@ void HttpReq::init()
     bufpos = 0;
     notifiedbufpos = 0;
     contentlength = 0;
+    mContentEncoded = false;
+    mOriginalContentLength = false;
     timeleft = -1;
+    roundtripms = -1;
     lastdata = NEVER;
     outpos = 0;
     in.clear();
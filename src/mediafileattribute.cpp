@@ -25,6 +25,7 @@
 #include "mega/command.h"
 #include "mega/megaclient.h"
 #include "mega/megaapp.h"
+#include "megafs.h"
 
 #ifdef USE_MEDIAINFO
 #include "MediaInfo/MediaInfo.h"
@@ -294,6 +295,115 @@ void MediaFileInfo::addUploadMediaFileAttributes(UploadHandle uploadhandle, std:
     }
 }
 
+void MediaFileInfo::startPropertiesExtraction(MegaClient* client, Transfer* transfer)
+{
+    assert(transfer->type == PUT);
+
+    string ext;
+    if (transfer->mediaExtraction ||
+        transfer->size < 16 ||
+        mediaCodecsFailed ||
+        !client->fsaccess->getextension(transfer->localfilename, ext) ||
+        !MediaProperties::isMediaFilenameExt(ext) ||
+        (transfer->isvalid && mPropertiesCache.count(*transfer)))
+    {
+        return;
+    }
+
+    LOG_debug << "Starting media properties extraction: " << transfer->localfilename;
+
+    auto extraction = std::make_shared<MediaPropertiesExtraction>(transfer->localfilename);
+    transfer->mediaExtraction = extraction;
+
+    // discardable: if it never runs, the client thread does the extraction when it needs the result
+    client->mMediaExtractionQueue.push([extraction](SymmCipher&)
+    {
+        extraction->run();
+    }, true);
+}
+
+bool MediaFileInfo::getCachedProperties(const FileFingerprint& fp, MediaProperties& vp) const
+{
+    if (!fp.isvalid)
+    {
+        return false;
+    }
+
+    auto i = mPropertiesCache.find(fp);
+    if (i == mPropertiesCache.end())
+    {
+        return false;
+    }
+
+    vp = i->second;
+    return true;
+}
+
+void MediaFileInfo::cacheProperties(const FileFingerprint& fp, const MediaProperties& vp)
+{
+    if (!fp.isvalid)
+    {
+        return;
+    }
+
+    if (mPropertiesCache.size() >= MAX_CACHED_PROPERTIES)
+    {
+        mPropertiesCache.clear();
+    }
+    mPropertiesCache[fp] = vp;
+}
+
+MediaPropertiesExtraction::MediaPropertiesExtraction(const LocalPath& localFilename)
+    : mLocalFilename(localFilename)
+{
+}
+
+void MediaPropertiesExtraction::run()
+{
+    {
+        lock_guard<mutex> g(mMutex);
+        if (mState != PENDING)
+        {
+            return;
+        }
+        mState = RUNNING;
+    }
+
+    extract();
+}
+
+bool MediaPropertiesExtraction::result(MediaProperties& vp)
+{
+    lock_guard<mutex> g(mMutex);
+
+    if (mState == DONE)
+    {
+        vp = mProperties;
+        return true;
+    }
+
+    // never wait for a parse in progress: the caller extracts on its own instead,
+    // and a worker that didn't start yet won't bother
+    mState = ABANDONED;
+    return false;
+}
+
+void MediaPropertiesExtraction::extract()
+{
+    // our own FileSystemAccess, as we may be on a worker thread
+    FSACCESS_CLASS fsAccess;
+
+    MediaProperties vp;
+    vp.extractMediaPropertyFileAttributes(mLocalFilename, &fsAccess);
+
+    lock_guard<mutex> g(mMutex);
+    if (mState == RUNNING)
+    {
+        mProperties = vp;
+        mState = DONE;
+    }
+}
+
 #endif  // USE_MEDIAINFO
 
 // ----------------------------------------- xxtea encryption / decryption --------------------------------------------------------
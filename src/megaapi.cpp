@@ -1187,6 +1187,11 @@ MegaSyncStallList* MegaRequest::getMegaSyncStallList() const
     return nullptr;
 }
 
+MegaSyncStallChanges* MegaRequest::getMegaSyncStallChanges() const
+{
+    return nullptr;
+}
+
 #endif // ENABLE_SYNC
 
 MegaVpnCredentials* MegaRequest::getMegaVpnCredentials() const
@@ -3772,6 +3777,11 @@ void MegaApi::getMegaSyncStallList(MegaRequestListener* listener)
     pImpl->getMegaSyncStallList(listener);
 }
 
+void MegaApi::getMegaSyncStallChanges(long long sinceVersion, unsigned maxChanges, MegaRequestListener* listener)
+{
+    pImpl->getMegaSyncStallChanges(sinceVersion, maxChanges, listener);
+}
+
 void MegaApi::clearStalledPath(MegaSyncStall* stall)
 {
     pImpl->clearStalledPath(stall);
@@ -6468,6 +6478,46 @@ const MegaSyncStall* MegaSyncStallList::get(size_t i) const
     return nullptr;
 }
 
+MegaSyncStallChanges* MegaSyncStallChanges::copy() const
+{
+    return nullptr;
+}
+
+size_t MegaSyncStallChanges::size() const
+{
+    return 0;
+}
+
+const MegaSyncStall* MegaSyncStallChanges::get(size_t) const
+{
+    return nullptr;
+}
+
+const char* MegaSyncStallChanges::key(size_t) const
+{
+    return nullptr;
+}
+
+bool MegaSyncStallChanges::isCloudKey(size_t) const
+{
+    return false;
+}
+
+long long MegaSyncStallChanges::getVersion() const
+{
+    return 0;
+}
+
+bool MegaSyncStallChanges::hasMore() const
+{
+    return false;
+}
+
+bool MegaSyncStallChanges::isReset() const
+{
+    return false;
+}
+
 #endif
 
 
@@ -48,6 +48,17 @@
 #include <signal.h>
 #endif
 
+// Whether the HTTP and FTP servers can send local files with sendfile(...)
+#if defined(__linux__) || (defined(__APPLE__) && !(TARGET_OS_IPHONE))
+#define HAVE_TCP_SENDFILE
+#ifdef __linux__
+#include <sys/sendfile.h>
+#else
+#include <sys/socket.h>
+#include <sys/uio.h>
+#endif
+#endif
+
 
 #ifdef __APPLE__
     #include <xlocale.h>
@@ -1578,6 +1589,31 @@ void MegaApiImpl::getMegaSyncStallList(MegaRequestListener* listener)
     waiter->notify();
 }
 
+void MegaApiImpl::getMegaSyncStallChanges(long long sinceVersion, unsigned maxChanges, MegaRequestListener* listener)
+{
+    auto request = new MegaRequestPrivate(MegaRequest::TYPE_GET_SYNC_STALL_CHANGES, listener);
+    request->setNumber(sinceVersion);
+
+    request->performRequest = [this, request, maxChanges]() -> error {
+
+        if (request->getNumber() < 0 || !maxChanges)
+        {
+            return API_EARGS;
+        }
+
+        auto completion = [this, request](unique_ptr<SyncStallChanges> changes) {
+            request->setMegaSyncStallChanges(std::make_unique<MegaSyncStallChangesPrivate>(move(*changes)));
+            fireOnRequestFinish(request, std::make_unique<MegaErrorPrivate>(API_OK));
+        };
+
+        client->syncs.getSyncStallChanges(static_cast<uint64_t>(request->getNumber()), maxChanges, std::move(completion), true);
+        return API_OK;
+    };
+
+    requestQueue.push(request);
+    waiter->notify();
+}
+
 void MegaApiImpl::clearStalledPath(MegaSyncStall* stall)
 {
     // do not report these ones anymore in calls to getMegaSyncStallList
@@ -1754,6 +1790,45 @@ MegaSyncStallListPrivate::MegaSyncStallListPrivate(SyncProblems&& sp, AddressedS
     }
 }
 
+MegaSyncStallChangesPrivate::MegaSyncStallChangesPrivate(SyncStallChanges&& changes)
+    : mVersion(changes.mVersion)
+    , mMore(changes.mMore)
+    , mReset(changes.mReset)
+{
+    mChanges.reserve(changes.mChanges.size());
+    for (auto& c : changes.mChanges)
+    {
+        Change change;
+        if (!c.removed)
+        {
+            change.stall = std::make_shared<MegaSyncStallPrivate>(c.entry);
+        }
+        change.key = c.cloud ? move(c.cloudKey) : c.localKey.toPath(false);
+        change.cloud = c.cloud;
+        mChanges.push_back(move(change));
+    }
+}
+
+MegaSyncStallChangesPrivate* MegaSyncStallChangesPrivate::copy() const
+{
+    return new MegaSyncStallChangesPrivate(*this);
+}
+
+const MegaSyncStall* MegaSyncStallChangesPrivate::get(size_t i) const
+{
+    return i < mChanges.size() ? mChanges[i].stall.get() : nullptr;
+}
+
+const char* MegaSyncStallChangesPrivate::key(size_t i) const
+{
+    return i < mChanges.size() ? mChanges[i].key.c_str() : nullptr;
+}
+
+bool MegaSyncStallChangesPrivate::isCloudKey(size_t i) const
+{
+    return i < mChanges.size() && mChanges[i].cloud;
+}
+
 #endif // ENABLE_SYNC
 
 MegaScheduledCopy *MegaApiImpl::getScheduledCopyByTag(int tag)
@@ -3882,6 +3957,8 @@ MegaRequestPrivate::MegaRequestPrivate(MegaRequestPrivate *request)
 #ifdef ENABLE_SYNC
     if (request->mSyncStallList)
         mSyncStallList.reset(request->mSyncStallList->copy());
+    if (request->mSyncStallChanges)
+        mSyncStallChanges.reset(request->mSyncStallChanges->copy());
 #endif // ENABLE_SYNC
     this->mStringList.reset(request->mStringList ? request->mStringList->copy() : nullptr);
     this->mMegaVpnCredentials.reset(request->mMegaVpnCredentials ? request->mMegaVpnCredentials->copy() : nullptr);
@@ -3935,6 +4012,16 @@ void MegaRequestPrivate::setMegaSyncStallList(unique_ptr<MegaSyncStallList>&& sl
     mSyncStallList = std::move(sl);
 }
 
+MegaSyncStallChanges* MegaRequestPrivate::getMegaSyncStallChanges() const
+{
+    return mSyncStallChanges.get();
+}
+
+void MegaRequestPrivate::setMegaSyncStallChanges(unique_ptr<MegaSyncStallChanges>&& changes)
+{
+    mSyncStallChanges = std::move(changes);
+}
+
 #endif // ENABLE_SYNC
 
 #ifdef ENABLE_CHAT
@@ -4707,6 +4794,7 @@ const char *MegaRequestPrivate::getRequestString() const
         case TYPE_DEL_VPN_CREDENTIAL: return "DEL_VPN_CREDENTIAL";
         case TYPE_CHECK_VPN_CREDENTIAL: return "CHECK_VPN_CREDENTIAL";
         case TYPE_GET_SYNC_STALL_LIST: return "GET_SYNC_STALL_LIST";
+        case TYPE_GET_SYNC_STALL_CHANGES: return "GET_SYNC_STALL_CHANGES";
         case TYPE_FETCH_CREDIT_CARD_INFO: return "FETCH_CREDIT_CARD_INFO";
         case TYPE_MOVE_TO_DEBRIS: return "MOVE_TO_DEBRIS";
         case TYPE_RING_INDIVIDUAL_IN_CALL: return "RING_INDIVIDUAL_IN_CALL";
@@ -9442,6 +9530,31 @@ void MegaApiImpl::startStreaming(MegaNode* node, m_off_t startPos, m_off_t size,
     waiter->notify();
 }
 
+vector<LocalPath> MegaApiImpl::getLocalCopies(MegaNode* node)
+{
+    if (!node || node->isFolder() || !node->getFingerprint())
+    {
+        return vector<LocalPath>();
+    }
+
+    string* nodeKey = node->getNodeKey();
+    if (!nodeKey || nodeKey->size() != FILENODEKEYLENGTH)
+    {
+        return vector<LocalPath>();
+    }
+
+    unique_ptr<FileFingerprint> fingerprint(getFileFingerprintInternal(node->getFingerprint()));
+    if (!fingerprint)
+    {
+        return vector<LocalPath>();
+    }
+
+    int64_t metaMac = MemAccess::get<int64_t>(nodeKey->data() + SymmCipher::KEYLENGTH + sizeof(int64_t));
+
+    SdkMutexGuard g(sdkMutex);
+    return client->mLocalFileIndex.candidates(*fingerprint, metaMac);
+}
+
 void MegaApiImpl::setStreamingMinimumRate(int bytesPerSecond)
 {
     SdkMutexGuard g(sdkMutex);
@@ -15287,6 +15400,12 @@ void MegaApiImpl::nodes_updated(sharedNode_vector* nodes, int count)
         return;
     }
 
+#ifdef HAVE_LIBUV
+    // listings rendered by the local servers may now be stale
+    if (httpServer) httpServer->listingCache.invalidate(nodes);
+    if (ftpServer) ftpServer->listingCache.invalidate(nodes);
+#endif
+
     MegaNodeList *nodeList = NULL;
     if (nodes != NULL)
     {
@@ -18695,8 +18814,7 @@ unsigned MegaApiImpl::sendPendingTransfers(TransferQueue *queue, MegaRecursiveOp
 
                             TreeProcCopy tc;
                             client->proctree(samenode, &tc, false, true);
-                            tc.allocnodes();
-                            client->proctree(samenode, &tc, false, true);
+                            tc.finish(client);
                             tc.nn[0].parenthandle = UNDEF;
 
                             SymmCipher key;
@@ -19864,7 +19982,6 @@ void MegaApiImpl::moveNode(MegaNode* node, MegaNode* newParent, const char* newN
                     return e;
                 }
 
-                unsigned nc;
                 TreeProcCopy tc;
                 NodeHandle ovhandle;
 
@@ -19901,14 +20018,10 @@ void MegaApiImpl::moveNode(MegaNode* node, MegaNode* newParent, const char* newN
                     }
                 }
 
-                // determine number of nodes to be copied
-                client->proctree(node, &tc, !ovhandle.isUndef());
-                tc.allocnodes();
-                nc = tc.nc;
-
                 // build new nodes array
                 client->proctree(node, &tc, !ovhandle.isUndef());
-                if (!nc)
+                tc.finish(client);
+                if (tc.nn.empty())
                 {
                     e = API_EARGS;
                     return e;
@@ -20140,13 +20253,10 @@ error MegaApiImpl::copyTreeFromOwnedNode(shared_ptr<Node> node, const char* newN
         fileAlreadyExisted = node->isvalid && ovn->isvalid && node->EqualExceptValidFlag(*ovn);
     }
 
-    // determine number of nodes to be copied
     TreeProcCopy tc;
-    client->proctree(node, &tc, false, !ovhandle.isUndef());
-    tc.allocnodes();
-
     // build new nodes array
     client->proctree(node, &tc, false, !ovhandle.isUndef());
+    tc.finish(client);
     if (tc.nn.empty())
     {
         LOG_err << "Failed to copy owned node: Failed to find nodes";
@@ -30515,6 +30625,29 @@ uv_buf_t StreamingBuffer::nextBuffer()
     return uv_buf_init(outbuf, (unsigned int)(len));
 }
 
+unsigned StreamingBuffer::nextBuffers(uv_buf_t (&buffers)[2])
+{
+    size_t len = size < maxOutputSize ? size : maxOutputSize;
+
+    buffers[0] = nextBuffer();
+    if (!buffers[0].len)
+    {
+        return 0;
+    }
+
+    if (buffers[0].len >= len)
+    {
+        return 1;
+    }
+
+    // the rest of the data is at the start of the circular buffer
+    assert(!outpos);
+    buffers[1] = uv_buf_init(buffer, static_cast<unsigned int>(len - buffers[0].len));
+    size -= buffers[1].len;
+    outpos += buffers[1].len;
+    return 2;
+}
+
 void StreamingBuffer::freeData(size_t len)
 {
     LOG_verbose << "[Streaming] Streaming buffer free data: len = " << len << ", actual free = " << free << ", new free = " << (free+len) << ", size = " << size << " [capacity = " << capacity << "]";
@@ -30618,6 +30751,116 @@ std::string StreamingBuffer::bufferStatus() const
 // http_parser settings
 http_parser_settings MegaTCPServer::parsercfg;
 
+uint64_t MegaListingCache::generation()
+{
+    std::lock_guard<std::mutex> g(mMutex);
+    return mGeneration;
+}
+
+bool MegaListingCache::get(handle folder, const string& variant, string& listing)
+{
+    std::lock_guard<std::mutex> g(mMutex);
+    for (auto it = mEntries.begin(); it != mEntries.end(); ++it)
+    {
+        if (it->folder == folder && it->variant == variant)
+        {
+            mEntries.splice(mEntries.begin(), mEntries, it);
+            listing = mEntries.front().listing;
+            return true;
+        }
+    }
+    return false;
+}
+
+void MegaListingCache::put(handle folder, const string& variant, const string& listing, uint64_t generation)
+{
+    if (listing.size() > MAX_BYTES / 4)
+    {
+        // not worth evicting everything else for
+        return;
+    }
+
+    std::lock_guard<std::mutex> g(mMutex);
+    if (generation != mGeneration)
+    {
+        // the children may have changed while it was rendered
+        return;
+    }
+
+    for (auto it = mEntries.begin(); it != mEntries.end(); ++it)
+    {
+        if (it->folder == folder && it->variant == variant)
+        {
+            mBytes -= it->listing.size();
+            mEntries.erase(it);
+            break;
+        }
+    }
+
+    mEntries.push_front(Entry{folder, variant, listing});
+    mBytes += listing.size();
+
+    while (mEntries.size() > MAX_ENTRIES || mBytes > MAX_BYTES)
+    {
+        mBytes -= mEntries.back().listing.size();
+        mEntries.pop_back();
+    }
+}
+
+void MegaListingCache::invalidate(handle folder)
+{
+    std::lock_guard<std::mutex> g(mMutex);
+    ++mGeneration;
+    for (auto it = mEntries.begin(); it != mEntries.end(); )
+    {
+        if (it->folder == folder)
+        {
+            mBytes -= it->listing.size();
+            it = mEntries.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+}
+
+void MegaListingCache::invalidate(const sharedNode_vector* nodes)
+{
+    // even with nothing cached, listings being rendered now must not be kept
+    if (!nodes)
+    {
+        clear();
+        return;
+    }
+
+    for (auto& n : *nodes)
+    {
+        if (n->type != FILENODE || n->changed.parent || n->changed.removed)
+        {
+            // folder changes show in their descendants' paths, and a moved
+            // or removed node leaves a stale entry in a parent we no longer know
+            clear();
+            return;
+        }
+        invalidate(n->parentHandle().as8byte());
+    }
+}
+
+void MegaListingCache::clear()
+{
+    std::lock_guard<std::mutex> g(mMutex);
+    ++mGeneration;
+    mEntries.clear();
+    mBytes = 0;
+}
+
+size_t MegaListingCache::size()
+{
+    std::lock_guard<std::mutex> g(mMutex);
+    return mEntries.size();
+}
+
 MegaTCPServer::MegaTCPServer(MegaApiImpl *megaApi, string basePath, bool tls, string certificatepath, string keypath, bool ipv6)
     : useIPv6(ipv6)
 #ifdef ENABLE_EVT_TLS
@@ -30645,6 +30888,7 @@ MegaTCPServer::MegaTCPServer(MegaApiImpl *megaApi, string basePath, bool tls, st
     this->evtrequirescleaning = false;
 #endif
     fsAccess = new MegaFileSystemAccess;
+    verifiedCopies = std::make_shared<MegaTCPVerifiedCopies>();
 
     if (basePath.size())
     {
@@ -30655,6 +30899,7 @@ MegaTCPServer::MegaTCPServer(MegaApiImpl *megaApi, string basePath, bool tls, st
         }
         string sBasePath = lp.toPath(false);
         this->basePath = sBasePath;
+        spillStore = std::make_shared<MegaTCPSpillStore>(this->basePath);
     }
     semaphoresdestroyed = false;
     uv_sem_init(&semaphoreEnd, 0);
@@ -30711,16 +30956,15 @@ int MegaTCPServer::uv_tls_writer(evt_tls_t *evt_tls, void *bfr, int sz)
 
     if (uv_is_writable((uv_stream_t*)(&tcpctx->tcphandle)))
     {
-        uv_write_t *req = new uv_write_t();
+        MegaTCPWriteRequest* req = newWriteRequest(tcpctx);
         tcpctx->writePointers.push_back((char*)bfr);
-        req->data = tcpctx;
         LOG_verbose << "Sending " << sz << " bytes of TLS data on port = " << tcpctx->server->port;
-        if (int err = uv_write(req, (uv_stream_t*)&tcpctx->tcphandle, &b, 1, onWriteFinished_tls_async))
+        if (int err = uv_write(&req->request, (uv_stream_t*)&tcpctx->tcphandle, &b, 1, onWriteFinished_tls_async))
         {
             LOG_warn << "At uv_tls_writer: Finishing due to an error sending the response: " << err;
             tcpctx->writePointers.pop_back();
             delete [] (char*)bfr;
-            delete req;
+            releaseWriteRequest(req);
 
             closeTCPConnection(tcpctx);
         }
@@ -31356,11 +31600,12 @@ void MegaTCPServer::onWriteFinished_tls(evt_tls_t *evt_tls, int status)
 
 void MegaTCPServer::onWriteFinished_tls_async(uv_write_t* req, int status)
 {
-    MegaTCPContext *tcpctx = (MegaTCPContext*)req->data;
+    auto request = static_cast<MegaTCPWriteRequest*>(req->data);
+    MegaTCPContext *tcpctx = request->tcpctx;
     assert(tcpctx->writePointers.size());
     delete [] tcpctx->writePointers.front();
     tcpctx->writePointers.pop_front();
-    delete req;
+    releaseWriteRequest(request);
 
     if (tcpctx->finished)
     {
@@ -31396,17 +31641,62 @@ void MegaTCPServer::onWriteFinished_tls_async(uv_write_t* req, int status)
 
 void MegaTCPServer::onWriteFinished(uv_write_t* req, int status)
 {
-    MegaTCPContext* tcpctx = (MegaTCPContext*) req->data;
+    auto request = static_cast<MegaTCPWriteRequest*>(req->data);
+    MegaTCPContext* tcpctx = request->tcpctx;
     assert(tcpctx != NULL);
+
+    // the request may be reused by the writes issued below
+    releaseWriteRequest(request);
+
     if (tcpctx->finished)
     {
         LOG_debug << "At onWriteFinished; TCP link closed, ignoring the result of the write";
-        delete req;
         return;
     }
 
     tcpctx->server->processWriteFinished(tcpctx, status);
-    delete req;
+}
+
+MegaTCPWriteRequest* MegaTCPServer::newWriteRequest(MegaTCPContext* tcpctx)
+{
+    auto& pool = tcpctx->server->writeRequests;
+
+    MegaTCPWriteRequest* request;
+    if (pool.empty())
+    {
+        request = new MegaTCPWriteRequest();
+    }
+    else
+    {
+        request = pool.back().release();
+        pool.pop_back();
+    }
+
+    request->request.data = request;
+    request->tcpctx = tcpctx;
+    request->server = tcpctx->server;
+    return request;
+}
+
+void MegaTCPServer::releaseWriteRequest(MegaTCPWriteRequest* request)
+{
+    auto& pool = request->server->writeRequests;
+
+    if (pool.size() >= MAX_POOLED_WRITE_REQUESTS)
+    {
+        delete request;
+        return;
+    }
+
+    // don't hold on to large responses
+    if (request->data.capacity() > 65536)
+    {
+        string().swap(request->data);
+    }
+
+    request->data.clear();
+    request->tcpctx = nullptr;
+    pool.emplace_back(request);
 }
 
 MegaTCPContext::MegaTCPContext()
@@ -31436,6 +31726,928 @@ MegaTCPContext::~MegaTCPContext()
         megaApi->removeTransferListener(this);
         megaApi->removeRequestListener(this);
     }
+
+    if (fileSender)
+    {
+        fileSender->detach();
+    }
+
+    if (server && server->spillStore)
+    {
+        server->spillStore->fetchEnded(this);
+    }
+}
+
+void MegaTCPContext::spillTransferData(MegaTransfer* transfer, const char* buffer, size_t size)
+{
+    // kept for later requests of the same range, and for those waiting for it
+    if (!server->useTLS && server->spillStore)
+    {
+        m_off_t next = transfer->getStartPos() + transfer->getTransferredBytes();
+        server->spillStore->write(transfer->getNodeHandle(), next - static_cast<m_off_t>(size), buffer, size);
+        server->spillStore->fetching(this, transfer->getNodeHandle(), next, transfer->getEndPos() + 1);
+    }
+}
+
+MegaTCPFileSender::~MegaTCPFileSender()
+{
+#ifdef HAVE_TCP_SENDFILE
+    if (fileDescriptor >= 0)
+    {
+        close(fileDescriptor);
+    }
+
+    if (socketDescriptor >= 0)
+    {
+        close(socketDescriptor);
+    }
+#endif
+}
+
+bool MegaTCPFileSender::isSupported()
+{
+#ifdef HAVE_TCP_SENDFILE
+    return true;
+#else
+    return false;
+#endif
+}
+
+void MegaTCPFileSender::detach()
+{
+    tcpctx = nullptr;
+    if (polling)
+    {
+        polling = false;
+        ++closing;
+        uv_close((uv_handle_t*)&poll, onClosed);
+    }
+
+    if (timing)
+    {
+        timing = false;
+        ++closing;
+        uv_close((uv_handle_t*)&timer, onClosed);
+    }
+}
+
+void MegaTCPFileSender::onClosed(uv_handle_t* handle)
+{
+    auto sender = static_cast<MegaTCPFileSender*>(handle->data);
+    if (!--sender->closing)
+    {
+        sender->self.reset();
+    }
+}
+
+bool MegaTCPVerifiedCopies::Identity::operator==(const Identity& other) const
+{
+    return device == other.device
+           && inode == other.inode
+           && size == other.size
+           && mtime == other.mtime
+           && ctime == other.ctime;
+}
+
+#ifdef HAVE_TCP_SENDFILE
+static void toIdentity(const struct stat& metadata, MegaTCPVerifiedCopies::Identity& identity)
+{
+    identity.device = static_cast<uint64_t>(metadata.st_dev);
+    identity.inode = static_cast<uint64_t>(metadata.st_ino);
+    identity.size = metadata.st_size;
+#ifdef __APPLE__
+    identity.mtime = metadata.st_mtimespec.tv_sec * 1000000000ll + metadata.st_mtimespec.tv_nsec;
+    identity.ctime = metadata.st_ctimespec.tv_sec * 1000000000ll + metadata.st_ctimespec.tv_nsec;
+#else
+    identity.mtime = metadata.st_mtim.tv_sec * 1000000000ll + metadata.st_mtim.tv_nsec;
+    identity.ctime = metadata.st_ctim.tv_sec * 1000000000ll + metadata.st_ctim.tv_nsec;
+#endif
+}
+#endif
+
+bool MegaTCPVerifiedCopies::identify(int fileDescriptor, Identity& identity)
+{
+#ifdef HAVE_TCP_SENDFILE
+    struct stat metadata;
+    if (fstat(fileDescriptor, &metadata) || !S_ISREG(metadata.st_mode))
+    {
+        return false;
+    }
+    toIdentity(metadata, identity);
+    return true;
+#else
+    static_cast<void>(fileDescriptor);
+    static_cast<void>(identity);
+    return false;
+#endif
+}
+
+bool MegaTCPVerifiedCopies::identify(const LocalPath& path, Identity& identity)
+{
+#ifdef HAVE_TCP_SENDFILE
+    struct stat metadata;
+    if (stat(path.platformEncoded().c_str(), &metadata) || !S_ISREG(metadata.st_mode))
+    {
+        return false;
+    }
+    toIdentity(metadata, identity);
+    return true;
+#else
+    static_cast<void>(path);
+    static_cast<void>(identity);
+    return false;
+#endif
+}
+
+bool MegaTCPVerifiedCopies::isVerified(const LocalPath& path, const Identity& identity)
+{
+    std::lock_guard<std::mutex> g(mMutex);
+    auto it = mEntries.find(path);
+    return it != mEntries.end()
+           && !it->second.checking
+           && it->second.matches
+           && it->second.identity == identity;
+}
+
+bool MegaTCPVerifiedCopies::startChecking(const LocalPath& path, const Identity& identity)
+{
+    std::lock_guard<std::mutex> g(mMutex);
+    auto it = mEntries.find(path);
+    if (it != mEntries.end()
+        && (it->second.checking || it->second.identity == identity))
+    {
+        return false;
+    }
+
+    if (it == mEntries.end() && mEntries.size() >= MAX_ENTRIES)
+    {
+        mEntries.erase(mEntries.begin());
+    }
+
+    auto& entry = mEntries[path];
+    entry.checking = true;
+    entry.matches = false;
+    return true;
+}
+
+void MegaTCPVerifiedCopies::checked(const LocalPath& path, const Identity& identity, bool matches)
+{
+    std::lock_guard<std::mutex> g(mMutex);
+    auto& entry = mEntries[path];
+    entry.checking = false;
+    entry.matches = matches;
+    entry.identity = identity;
+}
+
+MegaTCPSpillStore::MegaTCPSpillStore(const string& directory)
+    : mDirectory(directory)
+{
+}
+
+MegaTCPSpillStore::~MegaTCPSpillStore()
+{
+    {
+        std::lock_guard<std::mutex> g(mMutex);
+        mExiting = true;
+    }
+    mCondition.notify_all();
+
+    if (mThread.joinable())
+    {
+        mThread.join();
+    }
+}
+
+MegaTCPSpillStore::Entry::~Entry()
+{
+#ifdef HAVE_TCP_SENDFILE
+    if (fileDescriptor >= 0)
+    {
+        close(fileDescriptor);
+    }
+#endif
+}
+
+std::shared_ptr<MegaTCPSpillStore::Entry> MegaTCPSpillStore::find(handle node)
+{
+    for (auto it = mEntries.begin(); it != mEntries.end(); ++it)
+    {
+        if ((*it)->node == node)
+        {
+            mEntries.splice(mEntries.begin(), mEntries, it);
+            return mEntries.front();
+        }
+    }
+    return nullptr;
+}
+
+std::shared_ptr<MegaTCPSpillStore::Entry> MegaTCPSpillStore::create(handle node)
+{
+#ifdef HAVE_TCP_SENDFILE
+    if (mEntries.size() >= MAX_NODES)
+    {
+        // make room by dropping the least recently used node nobody is reading
+        auto it = std::find_if(mEntries.rbegin(), mEntries.rend(), [](const std::shared_ptr<Entry>& e) { return !e->readers; });
+        if (it == mEntries.rend())
+        {
+            return nullptr;
+        }
+
+        LOG_debug << "Dropping " << (*it)->bytes << " bytes of streamed data of node " << toNodeHandle((*it)->node);
+        mBytes -= (*it)->bytes;
+        mEntries.erase(std::next(it).base());
+    }
+
+    // named as the temporary files of uploads to the HTTP server
+    string path = mDirectory + "spillfile" + LocalPath::tmpNameLocal().toPath(false);
+    int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+    if (fd < 0)
+    {
+        LOG_warn << "Unable to create a file for streamed data: " << errno;
+        return nullptr;
+    }
+
+    // only reachable through the descriptor from now on
+    unlink(path.c_str());
+
+    LOG_debug << "Keeping the data streamed for node " << toNodeHandle(node);
+    auto entry = std::make_shared<Entry>();
+    entry->node = node;
+    entry->fileDescriptor = fd;
+    mEntries.push_front(entry);
+    return entry;
+#else
+    static_cast<void>(node);
+    return nullptr;
+#endif
+}
+
+bool MegaTCPSpillStore::trim(m_off_t needed)
+{
+#ifdef HAVE_TCP_SENDFILE
+    // the least recently used nodes lose their lowest ranges first, a bit at a time
+    for (auto it = mEntries.rbegin(); it != mEntries.rend() && mBytes + needed > MAX_BYTES; )
+    {
+        auto& entry = **it;
+        if (entry.readers || entry.ranges.empty())
+        {
+            // a request may be sending any of its data
+            ++it;
+            continue;
+        }
+
+        auto range = entry.ranges.begin();
+        m_off_t start = range->first;
+        m_off_t end = std::min(range->second, start + TRIM_BYTES);
+
+        bool punched = false;
+#ifdef __linux__
+        punched = !fallocate(entry.fileDescriptor, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, static_cast<off_t>(start), static_cast<off_t>(end - start));
+#elif defined(F_PUNCHHOLE)
+        fpunchhole_t hole = {0, 0, static_cast<off_t>(start), static_cast<off_t>(end - start)};
+        punched = !fcntl(entry.fileDescriptor, F_PUNCHHOLE, &hole);
+#endif
+
+        if (!punched)
+        {
+            // the space can only be released along with the file
+            LOG_debug << "Dropping " << entry.bytes << " bytes of streamed data of node " << toNodeHandle(entry.node);
+            mBytes -= entry.bytes;
+            it = decltype(it)(mEntries.erase(std::next(it).base()));
+            continue;
+        }
+
+        if (end == range->second)
+        {
+            entry.ranges.erase(range);
+        }
+        else
+        {
+            entry.ranges[end] = range->second;
+            entry.ranges.erase(range);
+        }
+        entry.bytes -= end - start;
+        mBytes -= end - start;
+    }
+#endif
+
+    return mBytes + needed <= MAX_BYTES;
+}
+
+m_off_t MegaTCPSpillStore::addRange(std::map<m_off_t, m_off_t>& ranges, m_off_t start, m_off_t end)
+{
+    m_off_t added = end - start;
+    m_off_t newStart = start;
+    m_off_t newEnd = end;
+
+    auto it = ranges.upper_bound(start);
+    if (it != ranges.begin() && std::prev(it)->second >= start)
+    {
+        --it;
+    }
+
+    // merge with every range this one overlaps or touches
+    while (it != ranges.end() && it->first <= end)
+    {
+        m_off_t overlap = std::min(it->second, end) - std::max(it->first, start);
+        if (overlap > 0)
+        {
+            added -= overlap;
+        }
+        newStart = std::min(newStart, it->first);
+        newEnd = std::max(newEnd, it->second);
+        it = ranges.erase(it);
+    }
+
+    ranges[newStart] = newEnd;
+    return added;
+}
+
+void MegaTCPSpillStore::write(handle node, m_off_t offset, const char* data, size_t len)
+{
+#ifdef HAVE_TCP_SENDFILE
+    if (!len || offset < 0)
+    {
+        return;
+    }
+
+    std::lock_guard<std::mutex> g(mMutex);
+
+    // nodes only requested once aren't kept
+    auto entry = find(node);
+    if (!entry || mExiting)
+    {
+        return;
+    }
+
+    if (mPendingBytes + len > MAX_PENDING_BYTES)
+    {
+        LOG_verbose << "Not keeping streamed data: too much pending already";
+        return;
+    }
+
+    mPending.push_back(Pending{std::move(entry), offset, string(data, len)});
+    mPendingBytes += len;
+
+    if (!mThread.joinable())
+    {
+        try
+        {
+            mThread = std::thread([this]() { writerLoop(); });
+        }
+        catch (std::system_error& e)
+        {
+            LOG_err << "Failed to start the thread writing streamed data: " << e.what();
+            mPending.clear();
+            mPendingBytes = 0;
+            return;
+        }
+    }
+    mCondition.notify_all();
+#else
+    static_cast<void>(node);
+    static_cast<void>(offset);
+    static_cast<void>(data);
+    static_cast<void>(len);
+#endif
+}
+
+void MegaTCPSpillStore::writerLoop()
+{
+#ifdef HAVE_TCP_SENDFILE
+    std::unique_lock<std::mutex> g(mMutex);
+    for (;;)
+    {
+        mCondition.wait(g, [this]() { return mExiting || !mPending.empty(); });
+        if (mExiting)
+        {
+            break;
+        }
+
+        Pending pending = std::move(mPending.front());
+        mPending.pop_front();
+        mPendingBytes -= pending.data.size();
+
+        auto& entry = pending.entry;
+        m_off_t len = static_cast<m_off_t>(pending.data.size());
+        bool kept = std::find(mEntries.begin(), mEntries.end(), entry) != mEntries.end();
+        if (kept && !trim(len))
+        {
+            // everything is being read
+            kept = false;
+        }
+
+        if (kept)
+        {
+            mWriting = true;
+            mWritingEntry = entry;
+            mWritingStart = pending.offset;
+            mWritingEnd = pending.offset + len;
+            g.unlock();
+
+            size_t written = 0;
+            while (written < pending.data.size())
+            {
+                auto result = pwrite(entry->fileDescriptor, pending.data.data() + written, pending.data.size() - written,
+                                     static_cast<off_t>(pending.offset + static_cast<m_off_t>(written)));
+                if (result < 0)
+                {
+                    if (errno == EINTR)
+                    {
+                        continue;
+                    }
+                    LOG_warn << "Unable to keep streamed data: " << errno;
+                    break;
+                }
+                written += static_cast<size_t>(result);
+            }
+
+            g.lock();
+            mWriting = false;
+            mWritingEntry.reset();
+
+            // unless it was dropped meanwhile
+            if (written && std::find(mEntries.begin(), mEntries.end(), entry) != mEntries.end())
+            {
+                auto added = addRange(entry->ranges, pending.offset, pending.offset + static_cast<m_off_t>(written));
+                entry->bytes += added;
+                mBytes += added;
+            }
+        }
+
+        if (mPending.empty())
+        {
+            mCondition.notify_all();
+        }
+    }
+#endif
+}
+
+void MegaTCPSpillStore::fetching(const void* fetcher, handle node, m_off_t next, m_off_t end)
+{
+#ifdef HAVE_TCP_SENDFILE
+    std::lock_guard<std::mutex> g(mMutex);
+    mFetches[fetcher] = Fetch{node, next, end};
+#else
+    static_cast<void>(fetcher);
+    static_cast<void>(node);
+    static_cast<void>(next);
+    static_cast<void>(end);
+#endif
+}
+
+void MegaTCPSpillStore::fetchEnded(const void* fetcher)
+{
+    std::lock_guard<std::mutex> g(mMutex);
+    mFetches.erase(fetcher);
+}
+
+bool MegaTCPSpillStore::coming(const Entry& entry, m_off_t position, m_off_t end) const
+{
+    // through what's held, queued or being written
+    for (bool advanced = true; advanced && position < end; )
+    {
+        advanced = false;
+
+        auto it = entry.ranges.upper_bound(position);
+        if (it != entry.ranges.begin() && std::prev(it)->second > position)
+        {
+            position = std::prev(it)->second;
+            advanced = true;
+        }
+
+        for (auto& pending : mPending)
+        {
+            m_off_t pendingEnd = pending.offset + static_cast<m_off_t>(pending.data.size());
+            if (pending.entry.get() == &entry && pending.offset <= position && position < pendingEnd)
+            {
+                position = pendingEnd;
+                advanced = true;
+            }
+        }
+
+        if (mWriting && mWritingEntry.get() == &entry && mWritingStart <= position && position < mWritingEnd)
+        {
+            position = mWritingEnd;
+            advanced = true;
+        }
+    }
+
+    if (position >= end)
+    {
+        return true;
+    }
+
+    // and then by a request that hasn't got that far yet
+    for (auto& fetch : mFetches)
+    {
+        if (fetch.second.node == entry.node && fetch.second.next <= position && fetch.second.end >= end)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+m_off_t MegaTCPSpillStore::readable(handle node, m_off_t offset, m_off_t end)
+{
+#ifdef HAVE_TCP_SENDFILE
+    std::lock_guard<std::mutex> g(mMutex);
+
+    auto entry = find(node);
+    if (!entry)
+    {
+        return -1;
+    }
+
+    auto it = entry->ranges.upper_bound(offset);
+    if (it != entry->ranges.begin() && (--it)->second > offset)
+    {
+        return std::min(it->second, end) - offset;
+    }
+
+    return coming(*entry, offset, end) ? 0 : -1;
+#else
+    static_cast<void>(node);
+    static_cast<void>(offset);
+    static_cast<void>(end);
+    return -1;
+#endif
+}
+
+void MegaTCPSpillStore::sync()
+{
+    std::unique_lock<std::mutex> g(mMutex);
+    mCondition.wait(g, [this]() { return mExiting || (mPending.empty() && !mWriting); });
+}
+
+int MegaTCPSpillStore::open(handle node, m_off_t offset, m_off_t len, std::shared_ptr<void>& pin)
+{
+#ifdef HAVE_TCP_SENDFILE
+    std::lock_guard<std::mutex> g(mMutex);
+
+    auto entry = find(node);
+    if (!entry)
+    {
+        auto it = std::find(mRequested.begin(), mRequested.end(), node);
+        if (it == mRequested.end())
+        {
+            mRequested.push_front(node);
+            if (mRequested.size() > 2 * MAX_NODES)
+            {
+                mRequested.pop_back();
+            }
+        }
+        else
+        {
+            // a second request: what's streamed from now on is kept
+            mRequested.erase(it);
+            entry = create(node);
+        }
+    }
+
+    // any of it may still be coming from another request
+    if (!entry || !coming(*entry, offset, offset + len))
+    {
+        return -1;
+    }
+
+    int fd = fcntl(entry->fileDescriptor, F_DUPFD_CLOEXEC, 0);
+    if (fd >= 0)
+    {
+        ++entry->readers;
+        pin = std::shared_ptr<void>(entry.get(), [entry](void*) { --entry->readers; });
+    }
+    return fd;
+#else
+    static_cast<void>(node);
+    static_cast<void>(offset);
+    static_cast<void>(len);
+    static_cast<void>(pin);
+    return -1;
+#endif
+}
+
+m_off_t MegaTCPSpillStore::bytes()
+{
+    std::lock_guard<std::mutex> g(mMutex);
+    return mBytes;
+}
+
+bool MegaTCPServer::openLocalCopy(MegaTCPContext* tcpctx, MegaNode* node, m_off_t offset)
+{
+#ifdef HAVE_TCP_SENDFILE
+    if (tcpctx->server->useTLS || !node)
+    {
+        return false;
+    }
+
+    auto candidates = tcpctx->megaApi->getLocalCopies(node);
+    unique_ptr<FileFingerprint> fingerprint(candidates.empty() ? nullptr : MegaApiImpl::getFileFingerprintInternal(node->getFingerprint()));
+    if (!fingerprint || !tcpctx->server->verifiedCopies)
+    {
+        candidates.clear();
+    }
+
+    for (auto& candidate : candidates)
+    {
+        int fd = open(candidate.platformEncoded().c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+        {
+            continue;
+        }
+
+        auto sender = std::make_shared<MegaTCPFileSender>();
+        sender->fileDescriptor = fd;
+        sender->offset = offset;
+
+        // nothing is read here, on the loop thread: the copy is served once its fingerprint and
+        // MetaMAC were checked in the background, and while it's still the file that was checked
+        MegaTCPVerifiedCopies::Identity identity;
+        if (!MegaTCPVerifiedCopies::identify(fd, identity) || identity.size != fingerprint->size)
+        {
+            LOG_debug << "Local copy of node " << toNodeHandle(node->getHandle()) << " no longer matches: " << candidate;
+            continue;
+        }
+
+        if (!tcpctx->server->verifiedCopies->isVerified(candidate, identity))
+        {
+            checkLocalCopy(tcpctx->server, candidate, identity, *fingerprint, *node->getNodeKey());
+            continue;
+        }
+
+        LOG_debug << "Serving node " << toNodeHandle(node->getHandle()) << " from local copy: " << candidate;
+        sender->tcpctx = tcpctx;
+        tcpctx->fileSender = std::move(sender);
+        return true;
+    }
+
+    // or from what another request fetched, or is fetching
+    std::shared_ptr<void> pin;
+    int fd = tcpctx->server->spillStore ? tcpctx->server->spillStore->open(node->getHandle(), offset, tcpctx->size, pin) : -1;
+    if (fd >= 0)
+    {
+        LOG_debug << "Serving " << tcpctx->size << " bytes of node " << toNodeHandle(node->getHandle())
+                  << " from offset " << offset << " from data streamed by other requests";
+        auto sender = std::make_shared<MegaTCPFileSender>();
+        sender->fileDescriptor = fd;
+        sender->offset = offset;
+        sender->pin = std::move(pin);
+        sender->spillStore = tcpctx->server->spillStore;
+        sender->node = node->getHandle();
+        sender->end = offset + tcpctx->size;
+        sender->tcpctx = tcpctx;
+        tcpctx->fileSender = std::move(sender);
+        return true;
+    }
+#endif
+
+    return false;
+}
+
+namespace {
+
+// fingerprint and MetaMAC check of a local copy, run on the libuv threadpool
+struct LocalCopyCheck
+{
+    uv_work_t work;
+    std::shared_ptr<MegaTCPVerifiedCopies> copies;
+    LocalPath path;
+    MegaTCPVerifiedCopies::Identity identity;
+
+    // the node's
+    FileFingerprint fingerprint;
+    std::string nodeKey;
+
+    bool matches = false;
+};
+
+} // namespace
+
+void MegaTCPServer::checkLocalCopy(MegaTCPServer* server, const LocalPath& path, const MegaTCPVerifiedCopies::Identity& identity,
+                                   const FileFingerprint& fingerprint, const string& nodeKey)
+{
+    if (nodeKey.size() != FILENODEKEYLENGTH || !server->verifiedCopies->startChecking(path, identity))
+    {
+        return;
+    }
+
+    LOG_debug << "Checking the MetaMAC of local copy: " << path;
+
+    auto check = new LocalCopyCheck;
+    check->copies = server->verifiedCopies;
+    check->path = path;
+    check->identity = identity;
+    check->fingerprint = fingerprint;
+    check->nodeKey = nodeKey;
+    check->work.data = check;
+
+    int err = uv_queue_work(&server->uv_loop, &check->work, onLocalCopyCheck, onLocalCopyChecked);
+    if (err)
+    {
+        LOG_warn << "Unable to check local copy: " << err;
+        // not recorded as checked with this identity, so it's tried again
+        check->copies->checked(path, MegaTCPVerifiedCopies::Identity(), false);
+        delete check;
+    }
+}
+
+void MegaTCPServer::onLocalCopyCheck(uv_work_t* req)
+{
+    auto check = static_cast<LocalCopyCheck*>(req->data);
+
+    // this runs on a worker thread: don't share the server's FileSystemAccess
+    MegaFileSystemAccess fsAccess;
+    auto fa = fsAccess.newfileaccess(false);
+
+    // what's read must be the file the server thread saw, and it must not change meanwhile
+    MegaTCPVerifiedCopies::Identity before, after;
+    FileFingerprint local;
+    check->matches = MegaTCPVerifiedCopies::identify(check->path, before)
+                     && before == check->identity
+                     && fa->fopen(check->path, true, false, FSLogging::logOnError)
+                     && (local.genfingerprint(fa.get()), local.isvalid)
+                     && local.EqualExceptValidFlag(check->fingerprint)
+                     && CompareLocalFileMetaMacWithNodeKey(fa.get(), check->nodeKey, FILENODE)
+                     && MegaTCPVerifiedCopies::identify(check->path, after)
+                     && after == check->identity;
+}
+
+void MegaTCPServer::onLocalCopyChecked(uv_work_t* req, int status)
+{
+    unique_ptr<LocalCopyCheck> check(static_cast<LocalCopyCheck*>(req->data));
+
+    bool matches = !status && check->matches;
+    LOG_debug << "Local copy " << (matches ? "matches" : "doesn't match") << " its node: " << check->path;
+    check->copies->checked(check->path, check->identity, matches);
+}
+
+void MegaTCPServer::sendFileChunk(MegaTCPContext* tcpctx)
+{
+#ifdef HAVE_TCP_SENDFILE
+    auto& sender = tcpctx->fileSender;
+    assert(sender);
+
+    int err = 0;
+    if (!sender->polling)
+    {
+        uv_os_fd_t socket;
+        err = uv_fileno((uv_handle_t*)&tcpctx->tcphandle, &socket);
+
+        if (!err && (sender->socketDescriptor = fcntl(socket, F_DUPFD_CLOEXEC, 0)) < 0)
+        {
+            err = uv_translate_sys_error(errno);
+        }
+
+        if (!err && !(err = uv_poll_init(&tcpctx->server->uv_loop, &sender->poll, sender->socketDescriptor)))
+        {
+            sender->poll.data = sender.get();
+            sender->polling = true;
+            sender->self = sender;
+        }
+    }
+
+    if (!err)
+    {
+        sender->length = std::min<m_off_t>(tcpctx->size - tcpctx->bytesWritten, StreamingBuffer::MAX_BUFFER_SIZE);
+        sender->sent = 0;
+
+        if (sender->spillStore)
+        {
+            m_off_t readable = sender->spillStore->readable(sender->node, sender->offset, sender->end);
+            if (readable < 0)
+            {
+                LOG_warn << "Finishing: the data of node " << toNodeHandle(sender->node) << " from offset " << sender->offset << " is no longer coming";
+                closeTCPConnection(tcpctx);
+                return;
+            }
+
+            if (!readable)
+            {
+                // not fetched yet by the request we're following
+                if (!sender->timing)
+                {
+                    err = uv_timer_init(&tcpctx->server->uv_loop, &sender->timer);
+                    if (!err)
+                    {
+                        sender->timer.data = sender.get();
+                        sender->timing = true;
+                        sender->self = sender;
+                    }
+                }
+
+                if (!err && !(err = uv_timer_start(&sender->timer, onSpillWait, MegaTCPFileSender::SPILL_WAIT_MS, 0)))
+                {
+                    return;
+                }
+            }
+            else
+            {
+                sender->length = std::min(sender->length, readable);
+            }
+        }
+    }
+
+    if (!err)
+    {
+        LOG_verbose << "Sending " << sender->length << " bytes from offset " << sender->offset << " of a local file";
+
+        // sent from the callback, so that chunks don't recurse through processWriteFinished
+        err = uv_poll_start(&sender->poll, UV_WRITABLE, onFileChunkWritable);
+    }
+
+    if (err)
+    {
+        LOG_warn << "Finishing due to an error sending a local file: " << err;
+        closeTCPConnection(tcpctx);
+    }
+#else
+    assert(false);
+    closeTCPConnection(tcpctx);
+#endif
+}
+
+void MegaTCPServer::onFileChunkWritable(uv_poll_t* handle, int status, int)
+{
+#ifdef HAVE_TCP_SENDFILE
+    auto sender = static_cast<MegaTCPFileSender*>(handle->data);
+
+    int err = status < 0 ? status : 0;
+    while (!err && sender->sent < sender->length)
+    {
+        off_t offset = sender->offset + sender->sent;
+        m_off_t remaining = sender->length - sender->sent;
+        m_off_t sent = 0;
+
+#ifdef __linux__
+        auto result = sendfile(sender->socketDescriptor, sender->fileDescriptor, &offset, static_cast<size_t>(remaining));
+        if (result > 0)
+        {
+            sent = result;
+        }
+#else
+        off_t length = remaining;
+        auto result = sendfile(sender->fileDescriptor, sender->socketDescriptor, offset, &length, nullptr, 0);
+        sent = length;
+#endif
+
+        if (sent > 0)
+        {
+            sender->sent += sent;
+            continue;
+        }
+
+        if (!result)
+        {
+            // the file is shorter than expected
+            err = UV_EIO;
+            break;
+        }
+
+        if (errno == EINTR)
+        {
+            continue;
+        }
+
+        if (errno == EAGAIN || errno == EWOULDBLOCK)
+        {
+            // called again once there's room
+            return;
+        }
+
+        err = uv_translate_sys_error(errno);
+    }
+
+    uv_poll_stop(handle);
+
+    MegaTCPContext* tcpctx = sender->tcpctx;
+    if (!tcpctx || tcpctx->finished)
+    {
+        LOG_debug << "At onFileChunkWritable; TCP link closed, ignoring the result of the send";
+        return;
+    }
+
+    tcpctx->bytesWritten += sender->sent;
+    sender->offset += sender->sent;
+
+    tcpctx->server->processWriteFinished(tcpctx, err);
+#else
+    static_cast<void>(handle);
+    static_cast<void>(status);
+#endif
+}
+
+void MegaTCPServer::onSpillWait(uv_timer_t* handle)
+{
+    auto sender = static_cast<MegaTCPFileSender*>(handle->data);
+
+    MegaTCPContext* tcpctx = sender->tcpctx;
+    if (!tcpctx || tcpctx->finished)
+    {
+        return;
+    }
+
+    sendFileChunk(tcpctx);
 }
 
 void MegaTCPServer::onAsyncEvent(uv_async_t* handle)
@@ -31512,6 +32724,11 @@ void MegaTCPServer::closeConnection(MegaTCPContext *tcpctx)
 void MegaTCPServer::closeTCPConnection(MegaTCPContext *tcpctx)
 {
     tcpctx->finished = true;
+    if (tcpctx->fileSender)
+    {
+        tcpctx->fileSender->detach();
+    }
+
     if (!uv_is_closing((uv_handle_t*)&tcpctx->tcphandle))
     {
         tcpctx->server->remainingcloseevents++;
@@ -31642,6 +32859,14 @@ void MegaHTTPServer::processWriteFinished(MegaTCPContext* tcpctx, int status)
         return;
     }
 
+    if (httpctx->fileSender)
+    {
+        // the body is sent straight from a local copy
+        httpctx->lastBufferLen = 0;
+        sendFileChunk(httpctx);
+        return;
+    }
+
     uv_mutex_lock(&httpctx->mutex);
     if (httpctx->lastBufferLen)
     {
@@ -32055,14 +33280,23 @@ string MegaHTTPServer::getWebDavPropFindResponseForNode(string baseURL, string s
     web << getWebDavProfFindNodeContents(node, subbaseURL, httpserver->isOfflineAttributeEnabled());
     if (node->isFolder() && (httpctx->depth != 0))
     {
-        MegaNodeList *children = httpctx->megaApi->getChildren(node, MegaApi::ORDER_NONE);
-        for (int i = 0; i < children->size(); i++)
+        // the children's entries depend on the URL they are listed under
+        string variant = "dav/" + std::to_string(httpserver->isOfflineAttributeEnabled()) + "/" + subbaseURL;
+        string childrenContents;
+        auto generation = httpserver->listingCache.generation();
+        if (!httpserver->listingCache.get(node->getHandle(), variant, childrenContents))
         {
-            MegaNode *child = children->get(i);
-            string childURL = subbaseURL + child->getName();
-            web << getWebDavProfFindNodeContents(child, childURL, httpserver->isOfflineAttributeEnabled());
+            MegaNodeList *children = httpctx->megaApi->getChildren(node, MegaApi::ORDER_NONE);
+            for (int i = 0; i < children->size(); i++)
+            {
+                MegaNode *child = children->get(i);
+                string childURL = subbaseURL + child->getName();
+                childrenContents.append(getWebDavProfFindNodeContents(child, childURL, httpserver->isOfflineAttributeEnabled()));
+            }
+            delete children;
+            httpserver->listingCache.put(node->getHandle(), variant, childrenContents, generation);
         }
-        delete children;
+        web << childrenContents;
     }
 
     web << "</d:multistatus>"
@@ -32080,10 +33314,38 @@ string MegaHTTPServer::getWebDavPropFindResponseForNode(string baseURL, string s
 }
 
 string MegaHTTPServer::getResponseForNode(MegaNode *node, MegaHTTPContext* httpctx)
+{
+    std::ostringstream response;
+    string sweb;
+
+    string variant = "html/" + std::to_string(httpctx->megaApi->httpServerGetRestrictedMode());
+    auto generation = httpctx->server->listingCache.generation();
+    if (!httpctx->server->listingCache.get(node->getHandle(), variant, sweb))
+    {
+        sweb = getHtmlListingForNode(node, httpctx);
+        httpctx->server->listingCache.put(node->getHandle(), variant, sweb, generation);
+    }
+
+    response << "HTTP/1.1 200 OK\r\n"
+        << "Content-Type: text/html; charset=utf-8\r\n"
+        << "Connection: close\r\n"
+        << "Content-Length: " << sweb.size() << "\r\n"
+        << "Access-Control-Allow-Origin: *\r\n"
+        << "\r\n";
+
+    if (httpctx->parser.method != HTTP_HEAD)
+    {
+        response << sweb;
+    }
+    httpctx->resultCode = API_OK;
+
+    return response.str();
+}
+
+string MegaHTTPServer::getHtmlListingForNode(MegaNode *node, MegaHTTPContext* httpctx)
 {
     MegaNode *parent = httpctx->megaApi->getParentNode(node);
     MegaNodeList *children = httpctx->megaApi->getChildren(node, MegaApi::ORDER_NONE);
-    std::ostringstream response;
     std::ostringstream web;
 
     // Title
@@ -32233,21 +33495,7 @@ string MegaHTTPServer::getResponseForNode(MegaNode *node, MegaHTTPContext* httpc
     web << "</table>";
     delete children;
 
-    string sweb = web.str();
-    response << "HTTP/1.1 200 OK\r\n"
-        << "Content-Type: text/html; charset=utf-8\r\n"
-        << "Connection: close\r\n"
-        << "Content-Length: " << sweb.size() << "\r\n"
-        << "Access-Control-Allow-Origin: *\r\n"
-        << "\r\n";
-
-    if (httpctx->parser.method != HTTP_HEAD)
-    {
-        response << sweb;
-    }
-    httpctx->resultCode = API_OK;
-
-    return response.str();
+    return web.str();
 }
 
 string MegaHTTPServer::getHTTPMethodName(int httpmethod)
@@ -33330,6 +34578,11 @@ int MegaHTTPServer::streamNode(MegaHTTPContext *httpctx)
         httpctx->size = len;
     }
 
+    // the body will follow the headers straight from a local copy if there is one
+    bool localCopy = httpctx->parser.method != HTTP_HEAD
+                     && len
+                     && openLocalCopy(httpctx, node, start);
+
     sendHeaders(httpctx, &resstr);
     if (httpctx->parser.method == HTTP_HEAD)
     {
@@ -33338,7 +34591,11 @@ int MegaHTTPServer::streamNode(MegaHTTPContext *httpctx)
 
     LOG_debug << "Requesting range. From " << start << "  size " << len;
     httpctx->rangeWritten = 0;
-    if (start || len)
+    if (localCopy)
+    {
+        LOG_debug << "Skipping startStreaming call since the data is available locally";
+    }
+    else if (start || len)
     {
         httpctx->streamingBuffer.reset(!httpctx->lastBufferLen, resstr.size());
         httpctx->megaApi->startStreaming(node, start, len, httpctx);
@@ -33381,11 +34638,10 @@ void MegaHTTPServer::sendHeaders(MegaHTTPContext *httpctx, string *headers)
     else
     {
 #endif
-        uv_write_t *req = new uv_write_t();
-        req->data = httpctx;
-        if (int err = uv_write(req, (uv_stream_t*)&httpctx->tcphandle, &resbuf, 1, onWriteFinished))
+        MegaTCPWriteRequest* req = newWriteRequest(httpctx);
+        if (int err = uv_write(&req->request, (uv_stream_t*)&httpctx->tcphandle, &resbuf, 1, onWriteFinished))
         {
-            delete req;
+            releaseWriteRequest(req);
             LOG_warn << "Finishing due to an error sending the response: " << err;
             closeTCPConnection(httpctx);
         }
@@ -33411,14 +34667,21 @@ void MegaHTTPServer::processAsyncEvent(MegaTCPContext* tcpctx)
         return;
     }
 
+    // pending responses go out in a single write
+    string pendingResponses;
     uv_mutex_lock(&httpctx->mutex_responses);
     while (httpctx->responses.size())
     {
-        sendHeaders(httpctx,&httpctx->responses.front());
+        pendingResponses.append(httpctx->responses.front());
         httpctx->responses.pop_front();
     }
     uv_mutex_unlock(&httpctx->mutex_responses);
 
+    if (pendingResponses.size())
+    {
+        sendHeaders(httpctx, &pendingResponses);
+    }
+
     if (httpctx->nodereceived)
     {
         httpctx->nodereceived = false;
@@ -33454,6 +34717,12 @@ void MegaHTTPServer::sendNextBytes(MegaHTTPContext *httpctx)
         return;
     }
 
+    if (httpctx->fileSender)
+    {
+        LOG_verbose << "[Streaming] Skipping write. Data is sent from a local copy";
+        return;
+    }
+
     if (httpctx->lastBuffer)
     {
         LOG_verbose << "[Streaming] Skipping write due to another ongoing write";
@@ -33474,19 +34743,33 @@ void MegaHTTPServer::sendNextBytes(MegaHTTPContext *httpctx)
         return;
     }
 
-    uv_buf_t resbuf = httpctx->streamingBuffer.nextBuffer();
+    // plain connections take the data wrapping around the circular buffer in the same write
+    uv_buf_t resbufs[2];
+    unsigned nbufs;
+    if (httpctx->server->useTLS)
+    {
+        resbufs[0] = httpctx->streamingBuffer.nextBuffer();
+        nbufs = resbufs[0].len ? 1 : 0;
+    }
+    else
+    {
+        nbufs = httpctx->streamingBuffer.nextBuffers(resbufs);
+    }
     uv_mutex_unlock(&httpctx->mutex);
 
-    if (!resbuf.len)
+    if (!nbufs)
     {
         LOG_debug << "[Streaming] Skipping write. No data available. " << httpctx->streamingBuffer.bufferStatus();
         return;
     }
 
-    LOG_verbose << "Writing " << resbuf.len << " bytes";
-    httpctx->rangeWritten += resbuf.len;
+    uv_buf_t& resbuf = resbufs[0];
+    size_t len = resbuf.len + (nbufs > 1 ? resbufs[1].len : 0);
+
+    LOG_verbose << "Writing " << len << " bytes";
+    httpctx->rangeWritten += len;
     httpctx->lastBuffer = resbuf.base;
-    httpctx->lastBufferLen = resbuf.len;
+    httpctx->lastBufferLen = len;
 
 #ifdef ENABLE_EVT_TLS
     if (httpctx->server->useTLS)
@@ -33502,12 +34785,11 @@ void MegaHTTPServer::sendNextBytes(MegaHTTPContext *httpctx)
     else
     {
 #endif
-        uv_write_t *req = new uv_write_t();
-        req->data = httpctx;
+        MegaTCPWriteRequest* req = newWriteRequest(httpctx);
 
-        if (int err = uv_write(req, (uv_stream_t*)&httpctx->tcphandle, &resbuf, 1, onWriteFinished))
+        if (int err = uv_write(&req->request, (uv_stream_t*)&httpctx->tcphandle, resbufs, nbufs, onWriteFinished))
         {
-            delete req;
+            releaseWriteRequest(req);
             LOG_warn << "[Streaming] Finishing due to an error in uv_write: " << err;
             httpctx->finished = true;
             if (!uv_is_closing((uv_handle_t*)&httpctx->tcphandle))
@@ -33591,6 +34873,8 @@ bool MegaHTTPContext::onTransferData(MegaApi *, MegaTransfer *transfer, char *bu
     streamingBuffer.append(buffer, size);
     uv_mutex_unlock(&mutex);
 
+    spillTransferData(transfer, buffer, size);
+
     // notify the HTTP server
     uv_async_send(&asynchandle);
     return !pause;
@@ -34701,6 +35985,9 @@ void MegaFTPServer::processReceivedData(MegaTCPContext *tcpctx, ssize_t nread, c
 #else
                 MegaFTPDataServer *fds = new MegaFTPDataServer(megaApi, basePath, ftpctx, useTLS, string(), string());
 #endif
+                // data connections come and go, but what they streamed is kept by this server
+                fds->spillStore = spillStore;
+                fds->verifiedCopies = verifiedCopies;
                 bool result = fds->start(ftpctx->pasiveport, localOnly);
                 if (result)
                 {
@@ -34860,34 +36147,39 @@ void MegaFTPServer::processReceivedData(MegaTCPContext *tcpctx, ssize_t nread, c
             {
                 if (node->isFolder())
                 {
-                    MegaNodeList *children = ftpctx->megaApi->getChildren(node, MegaApi::ORDER_NONE);
                     assert(!ftpctx->ftpDataServer->resultmsj.size());
 
-                    if (ftpctx->command == FTP_CMD_LIST)
+                    string variant = (ftpctx->command == FTP_CMD_LIST ? "LIST/" : "NLST/") + crlfout;
+                    string& listing = ftpctx->ftpDataServer->resultmsj;
+                    auto generation = listingCache.generation();
+                    if (!listingCache.get(node->getHandle(), variant, listing))
                     {
-                        ftpctx->ftpDataServer->resultmsj.append(getListingLineFromNode(node,"."));
-                        ftpctx->ftpDataServer->resultmsj.append(crlfout);
-                    }
+                        MegaNodeList *children = ftpctx->megaApi->getChildren(node, MegaApi::ORDER_NONE);
 
-                    for (int i = 0; i < children->size(); i++)
-                    {
-                        MegaNode *child = children->get(i);
-                        //string childURL = subbaseURL + child->getName();
-                        string toret;
                         if (ftpctx->command == FTP_CMD_LIST)
                         {
-                            toret = getListingLineFromNode(child);
+                            listing.append(getListingLineFromNode(node,"."));
+                            listing.append(crlfout);
                         }
-                        else //NLST
+
+                        for (int i = 0; i < children->size(); i++)
                         {
-                            toret = child->getName();
+                            MegaNode *child = children->get(i);
+                            if (ftpctx->command == FTP_CMD_LIST)
+                            {
+                                listing.append(getListingLineFromNode(child));
+                            }
+                            else //NLST
+                            {
+                                listing.append(child->getName());
+                            }
+                            listing.append(crlfout);
                         }
-                        toret.append(crlfout);
-                        ftpctx->ftpDataServer->resultmsj.append(toret);
-                    }
-                    delete children;
+                        delete children;
 
-                    ftpctx->ftpDataServer->resultmsj.append(crlfout);
+                        listing.append(crlfout);
+                        listingCache.put(node->getHandle(), variant, listing, generation);
+                    }
 
                     response = "150 Here comes the directory listing";
                 }
@@ -35292,13 +36584,20 @@ void MegaFTPServer::processAsyncEvent(MegaTCPContext *tcpctx)
 
     MegaFTPContext* ftpctx = dynamic_cast<MegaFTPContext *>(tcpctx);
 
+    // pending responses go out in a single write
+    string pendingResponses;
     uv_mutex_lock(&ftpctx->mutex_responses);
     while (ftpctx->responses.size())
     {
-        answer(tcpctx,ftpctx->responses.front().c_str(),ftpctx->responses.front().size());
+        pendingResponses.append(ftpctx->responses.front());
         ftpctx->responses.pop_front();
     }
     uv_mutex_unlock(&ftpctx->mutex_responses);
+
+    if (pendingResponses.size())
+    {
+        answer(tcpctx, pendingResponses.c_str(), pendingResponses.size());
+    }
 }
 
 void MegaFTPServer::processOnAsyncEventClose(MegaTCPContext* tcpctx)
@@ -35325,11 +36624,14 @@ void MegaTCPServer::answer(MegaTCPContext* tcpctx, const char *rsp, size_t rlen)
     else
     {
 #endif
-        uv_write_t *req = new uv_write_t();
-        req->data = tcpctx;
-        if (int err = uv_write(req, (uv_stream_t*)&tcpctx->tcphandle, &resbuf, 1, onWriteFinished))
+        // the response must outlive the write
+        MegaTCPWriteRequest* req = newWriteRequest(tcpctx);
+        req->data.assign(rsp, rlen);
+        resbuf = uv_buf_init(&req->data[0], static_cast<unsigned>(rlen));
+
+        if (int err = uv_write(&req->request, (uv_stream_t*)&tcpctx->tcphandle, &resbuf, 1, onWriteFinished))
         {
-            delete req;
+            releaseWriteRequest(req);
             LOG_warn << "Finishing due to an error sending the response: " << err;
             closeTCPConnection(tcpctx);
         }
@@ -35637,6 +36939,14 @@ void MegaFTPDataServer::processWriteFinished(MegaTCPContext *tcpctx, int status)
             return;
         }
 
+        if (ftpdatactx->fileSender)
+        {
+            // the data is sent straight from a local copy
+            ftpdatactx->lastBufferLen = 0;
+            sendFileChunk(ftpdatactx);
+            return;
+        }
+
         uv_mutex_lock(&ftpdatactx->mutex);
         if (ftpdatactx->lastBufferLen)
         {
@@ -35831,7 +37141,9 @@ void MegaFTPDataServer::processAsyncEvent(MegaTCPContext *tcpctx)
 
     if (resultmsj.size())
     {
-        LOG_debug << " responding DATA: " << resultmsj;
+        // listings of large folders are too big to log whole
+        LOG_debug << " responding DATA: " << resultmsj.substr(0, 512)
+                  << (resultmsj.size() > 512 ? " [...] (" + std::to_string(resultmsj.size()) + " bytes)" : "");
         answer(ftpdatactx, resultmsj.c_str(), resultmsj.size());
     }
     else if (remotePathToUpload.size())
@@ -35903,7 +37215,17 @@ void MegaFTPDataServer::processAsyncEvent(MegaTCPContext *tcpctx)
 
             LOG_debug << "Requesting range. From " << start << "  size " << len;
             ftpdatactx->rangeWritten = 0;
-            if (start || len)
+            if (ftpdatactx->fileSender)
+            {
+                ftpdatactx->fileSender->detach();
+                ftpdatactx->fileSender.reset();
+            }
+            if (len && openLocalCopy(ftpdatactx, nodeToDownload, start))
+            {
+                LOG_debug << "Sending data from a local copy instead of streaming";
+                sendFileChunk(ftpdatactx);
+            }
+            else if (start || len)
             {
                 ftpdatactx->megaApi->startStreaming(nodeToDownload, start, len, ftpdatactx);
             }
@@ -35985,6 +37307,12 @@ void MegaFTPDataServer::sendNextBytes(MegaFTPDataContext *ftpdatactx)
         return;
     }
 
+    if (ftpdatactx->fileSender)
+    {
+        LOG_verbose << "[Streaming] Skipping write. Data is sent from a local copy";
+        return;
+    }
+
     if (ftpdatactx->lastBuffer)
     {
         LOG_verbose << "[Streaming] Skipping write due to another ongoing write";
@@ -36005,19 +37333,33 @@ void MegaFTPDataServer::sendNextBytes(MegaFTPDataContext *ftpdatactx)
         return;
     }
 
-    uv_buf_t resbuf = ftpdatactx->streamingBuffer.nextBuffer();
+    // plain connections take the data wrapping around the circular buffer in the same write
+    uv_buf_t resbufs[2];
+    unsigned nbufs;
+    if (ftpdatactx->server->useTLS)
+    {
+        resbufs[0] = ftpdatactx->streamingBuffer.nextBuffer();
+        nbufs = resbufs[0].len ? 1 : 0;
+    }
+    else
+    {
+        nbufs = ftpdatactx->streamingBuffer.nextBuffers(resbufs);
+    }
     uv_mutex_unlock(&ftpdatactx->mutex);
 
-    if (!resbuf.len)
+    if (!nbufs)
     {
         LOG_verbose << "[Streaming] Skipping write. No data available. " << ftpdatactx->streamingBuffer.bufferStatus();
         return;
     }
 
-    LOG_verbose << "Writing " << resbuf.len << " bytes" << " buffered = " << ftpdatactx->streamingBuffer.availableData();
-    ftpdatactx->rangeWritten += resbuf.len;
+    uv_buf_t& resbuf = resbufs[0];
+    size_t len = resbuf.len + (nbufs > 1 ? resbufs[1].len : 0);
+
+    LOG_verbose << "Writing " << len << " bytes" << " buffered = " << ftpdatactx->streamingBuffer.availableData();
+    ftpdatactx->rangeWritten += len;
     ftpdatactx->lastBuffer = resbuf.base;
-    ftpdatactx->lastBufferLen = resbuf.len;
+    ftpdatactx->lastBufferLen = len;
 
 #ifdef ENABLE_EVT_TLS
     if (ftpdatactx->server->useTLS)
@@ -36033,12 +37375,11 @@ void MegaFTPDataServer::sendNextBytes(MegaFTPDataContext *ftpdatactx)
     else
     {
 #endif
-        uv_write_t *req = new uv_write_t();
-        req->data = ftpdatactx;
+        MegaTCPWriteRequest* req = newWriteRequest(ftpdatactx);
 
-        if (int err = uv_write(req, (uv_stream_t*)&ftpdatactx->tcphandle, &resbuf, 1, onWriteFinished))
+        if (int err = uv_write(&req->request, (uv_stream_t*)&ftpdatactx->tcphandle, resbufs, nbufs, onWriteFinished))
         {
-            delete req;
+            releaseWriteRequest(req);
             LOG_warn << "[Streaming] Finishing due to an error in uv_write: " << err;
             closeTCPConnection(ftpdatactx);
         }
@@ -36110,6 +37451,8 @@ bool MegaFTPDataContext::onTransferData(MegaApi *, MegaTransfer *transfer, char
     streamingBuffer.append(buffer, size);
     uv_mutex_unlock(&mutex);
 
+    spillTransferData(transfer, buffer, size);
+
     // notify the HTTP server
     uv_async_send(&asynchandle);
     return !pause;
@@ -471,7 +471,7 @@ void MegaClient::mergenewshare(NewShare *s, bool notify, bool skipWriteInDb)
                         sendevent(99428,"Replacing share key", 0);
                     }
                 }
-                n->sharekey.reset(new SymmCipher(s->key));
+                n->sharekey.reset(new SymmKey(s->key));
                 skreceived = true;
             }
         }
@@ -1607,6 +1607,9 @@ void MegaClient::init()
     abortlockrequest();
     transferHttpCounter = 0;
     nextDispatchTransfersDs = 0;
+    failUploadPutnodes(API_EINCOMPLETE);
+    nextUploadPutnodesFlushDs = 0;
+    mLocalFileIndex.clear();
 
     jsonsc.pos = NULL;
     insca = false;
@@ -1634,6 +1637,8 @@ void MegaClient::init()
 
 MegaClient::MegaClient(MegaApp* a, shared_ptr<Waiter> w, HttpIO* h, DbAccess* d, GfxProc* g, const char* k, const char* u, unsigned workerThreadCount, ClientType clientType)
    : mAsyncQueue(*w, workerThreadCount)
+   , mLocalFileCopyQueue(*w, workerThreadCount ? 1 : 0)
+   , mMediaExtractionQueue(*w, workerThreadCount ? 1 : 0)
    , mCachedStatus(this)
    , useralerts(*this)
    , btugexpiration(rng)
@@ -2253,6 +2258,12 @@ void MegaClient::exec()
             }
         }
 
+        // send the putnodes of completed uploads once their coalescing window has expired
+        if (nextUploadPutnodesFlushDs && nextUploadPutnodesFlushDs <= Waiter::ds)
+        {
+            flushUploadPutnodes(false);
+        }
+
         // handle API client-server requests
         for (;;)
         {
@@ -2273,7 +2284,9 @@ void MegaClient::exec()
                         break;
 
                     case REQ_INFLIGHT:
-                        if (pendingcs->contentlength > 0)
+                        // compressed responses may not announce their decoded size,
+                        // but chunked ones are still consumed as they arrive
+                        if (pendingcs->contentlength > 0 || pendingcs->mChunked)
                         {
                             if (fetchingnodes && fnstats.timeToFirstByte == NEVER
                                     && pendingcs->bufpos > 10)
@@ -2294,7 +2307,10 @@ void MegaClient::exec()
                                 }
 
                                 abortlockrequest();
-                                app->request_response_progress(pendingcs->bufpos, pendingcs->contentlength);
+                                if (pendingcs->contentlength > 0)
+                                {
+                                    app->request_response_progress(pendingcs->bufpos, pendingcs->contentlength);
+                                }
                                 pendingcs->notifiedbufpos = pendingcs->bufpos;
                             }
                         }
@@ -2618,8 +2634,8 @@ void MegaClient::exec()
             {
             case REQ_SUCCESS:
                 pendingscTimedOut = false;
-                if (pendingsc->contentlength == 1
-                        && pendingsc->in.size()
+                if ((pendingsc->contentlength == 1 || pendingsc->mContentEncoded)
+                        && pendingsc->in.size() == 1
                         && pendingsc->in[0] == '0')
                 {
                     LOG_debug << "SC keep-alive received";
@@ -2986,23 +3002,23 @@ void MegaClient::exec()
             getOrCreateSyncdebrisFolder();
         }
 
-        if (!syncs.clientThreadActions.empty())
+        if (syncs.clientActionsPending())
         {
             CodeCounter::ScopeTimer ccst(performanceStats.clientThreadActions);
 
             dstime ctr_start = waiter->ds;
             size_t ctr_N = 0;
             TransferDbCommitter committer(tctable);
-            std::function<void(MegaClient&, TransferDbCommitter&)> f;
+            Syncs::QueuedClientFunc f;
 
             waiter->bumpds();
-            while (ctr_start + 5 >= waiter->ds && syncs.clientThreadActions.popFront(f))
+            while (ctr_start + 5 >= waiter->ds && syncs.nextClientAction(f))
             {
                 f(*this, committer);
                 ++ctr_N;
                 waiter->bumpds();
             }
-            if (auto n = syncs.clientThreadActions.size())
+            if (auto n = syncs.clientActionsCount())
             {
                 LOG_debug << "Processed " << ctr_N << " sync requests in " << (waiter->ds - ctr_start) << "ms, " << n << " requests outstanding";
             }
@@ -3153,7 +3169,7 @@ int MegaClient::preparewait()
     WAIT_CLASS::bumpds();
 
 #ifdef ENABLE_SYNC
-    if (!syncs.clientThreadActions.empty())
+    if (syncs.clientActionsPending())
     {
         nds = Waiter::ds;
         return Waiter::NEEDEXEC;
@@ -3182,6 +3198,12 @@ int MegaClient::preparewait()
             nds = nextDispatchTransfersDs > Waiter::ds ? nextDispatchTransfersDs : Waiter::ds;
         }
 
+        // pending putnodes of completed uploads
+        if (nextUploadPutnodesFlushDs && nextUploadPutnodesFlushDs < nds)
+        {
+            nds = nextUploadPutnodesFlushDs > Waiter::ds ? nextUploadPutnodesFlushDs : Waiter::ds;
+        }
+
         for (pendinghttp_map::iterator it = pendinghttp.begin(); it != pendinghttp.end(); it++)
         {
             if (it->second->isbtactive)
@@ -3508,6 +3530,90 @@ bool MegaClient::abortbackoff(bool includexfers)
     return r;
 }
 
+bool MegaClient::startLocalFileCopy(Transfer* t)
+{
+    if (t->localFileCopy)
+    {
+        switch (t->localFileCopy->status())
+        {
+            case LocalFileCopy::PENDING:
+                return false;
+
+            case LocalFileCopy::SUCCEEDED:
+                return true;
+
+            case LocalFileCopy::FAILED:
+                for (auto& path : t->localFileCopy->staleCandidates())
+                {
+                    mLocalFileIndex.remove(path);
+                }
+                t->localFileCopy.reset();
+                return true;
+        }
+    }
+
+    if (t->localFileCopyTried)
+    {
+        return true;
+    }
+    t->localFileCopyTried = true;
+
+    // only for downloads that didn't receive any data yet
+    if (!t->size || t->pos || t->chunkmacs.size())
+    {
+        return true;
+    }
+
+    auto candidates = mLocalFileIndex.candidates(*t, t->metamac);
+    if (candidates.empty())
+    {
+        return true;
+    }
+
+    // rebuild the node key to verify the MetaMAC of the copy
+    byte nodeKey[FILENODEKEYLENGTH];
+    memcpy(nodeKey, t->transferkey.data(), SymmCipher::KEYLENGTH);
+    MemAccess::set<int64_t>(nodeKey + SymmCipher::KEYLENGTH, t->ctriv);
+    MemAccess::set<int64_t>(nodeKey + SymmCipher::KEYLENGTH + sizeof(int64_t), t->metamac);
+    SymmCipher::xorblock(nodeKey + SymmCipher::KEYLENGTH, nodeKey);
+
+    LOG_debug << "Trying to produce download from " << candidates.size() << " local file(s) with the same contents: " << t->localfilename;
+
+    auto copy = std::make_shared<LocalFileCopy>(std::move(candidates), t->localfilename, *t, string((const char*)nodeKey, sizeof nodeKey));
+    t->localFileCopy = copy;
+
+    mLocalFileCopyQueue.push([copy](SymmCipher&)
+    {
+        copy->run();
+    }, false);
+
+    return false;
+}
+
+void MegaClient::activateCompletedTransfer(Transfer* t)
+{
+    LOG_debug << "Activating transfer produced locally";
+
+    // no file to write: the slot completes the transfer on its first doio()
+    TransferSlot* ts = new TransferSlot(t);
+    ts->fa.reset();
+
+    t->pos = t->size;
+    t->progresscompleted = t->size;
+    ts->progressreported = t->size;
+    ts->starttime = ts->lastdata = Waiter::ds;
+
+    ts->slots_it = tslots.insert(tslots.begin(), ts);
+
+    for (file_list::iterator it = t->files.begin(); it != t->files.end(); it++)
+    {
+        (*it)->start();
+    }
+    app->transfer_update(t);
+
+    performanceStats.transferStarts += 1;
+}
+
 // activate enough queued transfers as necessary to keep the system busy - but not too busy
 void MegaClient::dispatchTransfers()
 {
@@ -3835,6 +3941,23 @@ void MegaClient::dispatchTransfers()
                 app->transfer_prepare(nexttransfer);
             }
 
+            if (nexttransfer->type == GET && !nexttransfer->localfilename.empty() && !nexttransfer->slot)
+            {
+                // the contents may be on the disk already
+                if (!startLocalFileCopy(nexttransfer))
+                {
+                    continue;
+                }
+
+                if (nexttransfer->localFileCopy)
+                {
+                    assert(nexttransfer->localFileCopy->status() == LocalFileCopy::SUCCEEDED);
+                    nexttransfer->localFileCopy.reset();
+                    activateCompletedTransfer(nexttransfer);
+                    continue;
+                }
+            }
+
             bool openok = false;
             bool openfinished = false;
 
@@ -3983,6 +4106,14 @@ void MegaClient::dispatchTransfers()
                                 }
                             }
                         }
+
+#ifdef USE_MEDIAINFO
+                        // parse video/audio properties while the data is sent, rather than once it's complete
+                        if (!gfxdisabled)
+                        {
+                            mediaFileInfo.startPropertiesExtraction(this, nexttransfer);
+                        }
+#endif
                     }
                     else
                     {
@@ -4340,12 +4471,12 @@ void MegaClient::locallogout(bool removecaches, bool keepSyncsConfigFile)
     syncs.locallogout(removecaches, keepSyncsConfigFile, false);
 
     // Process any lingering client actions.
-    if (!syncs.clientThreadActions.empty())
+    if (syncs.clientActionsPending())
     {
         TransferDbCommitter committer(tctable);
         Syncs::QueuedClientFunc func;
 
-        while (syncs.clientThreadActions.popFront(func))
+        while (syncs.nextClientAction(func))
         {
             func(*this, committer);
         }
@@ -8791,6 +8922,137 @@ void MegaClient::putnodes(const char* user, vector<NewNode>&& newnodes, int tag,
     queuepubkeyreq(user, std::make_unique<PubKeyActionPutNodes>(std::move(newnodes), tag, std::move(completion)));
 }
 
+void MegaClient::putnodesOfUpload(NodeHandle target, VersioningOption vo, NewNode&& newnode, int tag, putsource_t source, bool canChangeVault, CommandPutNodes::Completion&& completion)
+{
+    UploadPutnodesBatch& batch = mUploadPutnodesBatches[std::make_tuple(target, vo, source, canChangeVault)];
+    if (batch.newnodes.empty())
+    {
+        batch.flushDs = Waiter::ds + UPLOAD_PUTNODES_BATCH_DS;
+    }
+
+    batch.newnodes.push_back(std::move(newnode));
+    batch.completions.emplace_back(tag, std::move(completion));
+
+    if (batch.newnodes.size() >= UPLOAD_PUTNODES_BATCH_MAX)
+    {
+        // no point in waiting any longer for this target
+        batch.flushDs = Waiter::ds;
+    }
+
+    if (!nextUploadPutnodesFlushDs || batch.flushDs < nextUploadPutnodesFlushDs)
+    {
+        nextUploadPutnodesFlushDs = batch.flushDs;
+    }
+}
+
+void MegaClient::flushUploadPutnodes(bool force)
+{
+    nextUploadPutnodesFlushDs = 0;
+
+    for (auto it = mUploadPutnodesBatches.begin(); it != mUploadPutnodesBatches.end(); )
+    {
+        UploadPutnodesBatch& batch = it->second;
+        if (!force && batch.flushDs > Waiter::ds)
+        {
+            if (!nextUploadPutnodesFlushDs || batch.flushDs < nextUploadPutnodesFlushDs)
+            {
+                nextUploadPutnodesFlushDs = batch.flushDs;
+            }
+            ++it;
+            continue;
+        }
+
+        NodeHandle target = std::get<0>(it->first);
+        VersioningOption vo = std::get<1>(it->first);
+        putsource_t source = std::get<2>(it->first);
+        bool canChangeVault = std::get<3>(it->first);
+
+        auto completions = std::make_shared<vector<std::pair<int, CommandPutNodes::Completion>>>(std::move(batch.completions));
+        int firstTag = completions->front().first;
+
+        LOG_debug << "Sending putnodes for " << batch.newnodes.size() << " completed upload(s) to " << target;
+
+        // split the result of the single command into the result for each upload
+        auto splitResult = [this, target, completions](const Error& e, targettype_t t, vector<NewNode>& nn, bool targetOverride, int)
+        {
+            assert(e != API_OK || nn.size() == completions->size());
+
+            for (size_t i = 0; i < completions->size(); ++i)
+            {
+                vector<NewNode> single;
+                Error nodeError = e;
+                bool nodeTargetOverride = targetOverride;
+
+                if (i < nn.size())
+                {
+                    NewNode& newnode = nn[i];
+
+                    if (newnode.mError != API_OK)
+                    {
+                        // a node's own error is more precise than the command's, whatever the latter is
+                        nodeError = newnode.mError;
+                    }
+                    else if (e == API_OK)
+                    {
+                        if (!newnode.added)
+                        {
+                            nodeError = API_ENOENT;
+                        }
+                        else
+                        {
+                            shared_ptr<Node> added = nodebyhandle(newnode.mAddedHandle);
+                            nodeTargetOverride = added && NodeHandle().set6byte(added->parenthandle) != target;
+                        }
+                    }
+
+                    single.push_back(std::move(newnode));
+                }
+
+                int nodeTag = (*completions)[i].first;
+                CommandPutNodes::Completion& completion = (*completions)[i].second;
+
+                if (completion) completion(nodeError, t, single, nodeTargetOverride, nodeTag);
+                else app->putnodes_result(nodeError, t, single, nodeTargetOverride, nodeTag);
+            }
+        };
+
+        auto cmd = new CommandPutNodes(this, target, NULL, vo, std::move(batch.newnodes), firstTag, source, nullptr, std::move(splitResult), canChangeVault);
+        for (size_t i = 1; i < completions->size(); ++i)
+        {
+            cmd->mCoalescedTags.push_back((*completions)[i].first);
+        }
+        reqs.add(cmd);
+
+        it = mUploadPutnodesBatches.erase(it);
+    }
+}
+
+void MegaClient::failUploadPutnodes(error e)
+{
+    // moved out first, as completions may queue more uploads
+    auto batches = std::move(mUploadPutnodesBatches);
+    mUploadPutnodesBatches.clear();
+
+    for (auto& entry : batches)
+    {
+        UploadPutnodesBatch& batch = entry.second;
+        for (size_t i = 0; i < batch.completions.size(); ++i)
+        {
+            vector<NewNode> single;
+            if (i < batch.newnodes.size())
+            {
+                single.push_back(std::move(batch.newnodes[i]));
+            }
+
+            int tag = batch.completions[i].first;
+            CommandPutNodes::Completion& completion = batch.completions[i].second;
+
+            if (completion) completion(e, NODE_HANDLE, single, false, tag);
+            else app->putnodes_result(e, NODE_HANDLE, single, false, tag);
+        }
+    }
+}
+
 void MegaClient::putFileAttributes(handle h, fatype t, const string& encryptedAttributes, int tag)
 {
     std::shared_ptr<Node> node = mNodeManager.getNodeByHandle(NodeHandle().set6byte(h));
@@ -9676,7 +9938,7 @@ int MegaClient::readnode(JSON* j, int notify, putsource_t source, vector<NewNode
                         {
                             // If logged into writable folder, we need the sharekey set in the root node
                             // so as to include it in subsequent put nodes
-                            n->sharekey.reset(new SymmCipher(key)); //we use the "master key", in this case the secret share key
+                            n->sharekey.reset(new SymmKey(key.key)); //we use the "master key", in this case the secret share key
                         }
                     }
                 }
@@ -11681,13 +11943,13 @@ void MegaClient::openShareDialog(Node* n, std::function<void(Error)> completion)
             LOG_debug << "Creating new share key for " << toHandle(n->nodehandle);
             byte key[SymmCipher::KEYLENGTH];
             rng.genblock(key, sizeof key);
-            n->sharekey.reset(new SymmCipher(key));
+            n->sharekey.reset(new SymmKey(key));
             updateKeys = true;
         }
         else
         {
             LOG_debug << "Setting node's sharekey from KeyManager (openShareDialog)";
-            n->sharekey.reset(new SymmCipher((const byte*)previousKey.data()));
+            n->sharekey.reset(new SymmKey((const byte*)previousKey.data()));
         }
     }
     else assert(mKeyManager.getShareKey(n->nodehandle).size());
@@ -11815,13 +12077,13 @@ void MegaClient::setShareCompletion(Node *n, User *user, accesslevel_t a, bool w
             LOG_debug << "Creating new share key for folder link on " << toHandle(n->nodehandle);
             byte key[SymmCipher::KEYLENGTH];
             rng.genblock(key, sizeof key);
-            n->sharekey.reset(new SymmCipher(key));
+            n->sharekey.reset(new SymmKey(key));
             newShareKey = true;
         }
         else
         {
             LOG_debug << "Reusing node's sharekey from KeyManager for folder link on " << toHandle(n->nodehandle);
-            n->sharekey.reset(new SymmCipher((const byte*)previousKey.data()));
+            n->sharekey.reset(new SymmKey((const byte*)previousKey.data()));
         }
     }
 
@@ -12468,6 +12730,16 @@ void MegaClient::transfercacheadd(Transfer *transfer, TransferDbCommitter* commi
         if (committer) committer->addTransferCount += 1;
         tctable->checkCommitter(committer);
         tctable->put(MegaClient::CACHEDTRANSFER, transfer, &tckey);
+
+        if (transfer->dbid)
+        {
+            CachedTransfer index(*transfer);
+            string data;
+            if (index.serialize(&data) && PaddedCBC::encrypt(rng, &data, &tckey))
+            {
+                tctable->put(CachedTransfer::indexId(transfer->dbid), &data);
+            }
+        }
     }
 }
 
@@ -12477,7 +12749,16 @@ void MegaClient::transfercachedel(Transfer *transfer, TransferDbCommitter* commi
     {
         if (committer) committer->removeTransferCount += 1;
         tctable->checkCommitter(committer);
-        tctable->del(transfer->dbid);
+        transfercachedel(transfer->dbid);
+    }
+}
+
+void MegaClient::transfercachedel(uint32_t dbid)
+{
+    if (tctable && dbid)
+    {
+        tctable->del(dbid);
+        tctable->del(CachedTransfer::indexId(dbid));
     }
 }
 
@@ -14115,27 +14396,38 @@ void MegaClient::purgeOrphanTransfers(bool remove)
         TransferDbCommitter committer(tctable);
         while (multi_cachedtransfers[d].size())
         {
-            transfer_multimap::iterator it = multi_cachedtransfers[d].begin();
-            Transfer *transfer = it->second;
-            if (remove || (purgeOrphanTransfers && (m_time() - transfer->lastaccesstime) >= 172500))
+            cachedtransfer_multimap::iterator it = multi_cachedtransfers[d].begin();
+            CachedTransfer *cachedTransfer = it->second;
+            if (remove || (purgeOrphanTransfers && (m_time() - cachedTransfer->lastaccesstime) >= 172500))
             {
                 if (purgeCount == 0)
                 {
                     LOG_warn << "Purging orphan transfers";
                 }
                 purgeCount ++;
-                transfer->finished = true;
+
+                // build the Transfer so its destructor cleans up the cache record and any partial download
+                if (Transfer *transfer = cachedTransfer->materialize(this))
+                {
+                    transfer->finished = true;
+
+                    // if the transfer is still in cachedtransfers, then the app never knew about it
+                    // during this running instance, so no need to call the app back here.
+                    //app->transfer_removed(transfer);
+
+                    delete transfer;
+                }
+                else
+                {
+                    transfercachedel(cachedTransfer->dbid);
+                }
             }
             else
             {
                 notPurged ++;
             }
 
-            // if the transfer is still in cachedtransfers, then the app never knew about it
-            // during this running instance, so no need to call the app back here.
-            //app->transfer_removed(transfer);
-
-            delete transfer;
+            delete cachedTransfer;
             multi_cachedtransfers[d].erase(it);
         }
     }
@@ -14204,39 +14496,82 @@ void MegaClient::enabletransferresumption(const char *loggedoutid)
 
     uint32_t id;
     string data;
-    Transfer* t;
     size_t cachedTransfersLoaded = 0;
     size_t cachedFilesLoaded = 0;
 
     LOG_info << "Loading transfers from local cache";
-    tctable->rewind();
     {
         TransferDbCommitter committer(tctable); // needed in case of tctable->del()
-        while (tctable->next(&id, &data, &tckey))
+
+        // transfers are loaded from their index records only.  Caches from before those existed get them now, once
+        if (!tctable->get(CACHEDTRANSFERINDEX, &data))
         {
-            switch (id & 15)
+            LOG_info << "Indexing cached transfers";
+            tctable->rewindByType(CACHEDTRANSFER);
+            while (tctable->next(&id, &data, &tckey))
             {
-                case CACHEDTRANSFER:
-                    if ((t = Transfer::unserialize(this, &data, multi_cachedtransfers)))
-                    {
-                        t->dbid = id;
-                        if (t->priority > transferlist.currentpriority)
-                        {
-                            transferlist.currentpriority = t->priority;
-                        }
-                        cachedTransfersLoaded += 1;
-                    }
-                    else
+                if ((id & 15) != CACHEDTRANSFER)
+                {
+                    continue;
+                }
+
+                unique_ptr<Transfer> t(Transfer::unserialize(this, &data, nullptr));
+                if (t)
+                {
+                    t->dbid = id;
+                    CachedTransfer index(*t);
+                    data.clear();
+                    if (index.serialize(&data) && PaddedCBC::encrypt(rng, &data, &tckey))
                     {
-                        tctable->del(id);
-                        LOG_err << "Failed - transfer record read error, or duplicate";
+                        tctable->put(CachedTransfer::indexId(id), &data);
                     }
-                    break;
-                case CACHEDFILE:
-                    cachedfiles.push_back(data);
-                    cachedfilesdbids.push_back(id);
-                    cachedFilesLoaded += 1;
-                    break;
+                }
+                else
+                {
+                    tctable->del(id);
+                    LOG_err << "Failed - transfer record read error";
+                }
+            }
+
+            // marks the cache as indexed
+            data = "1";
+            PaddedCBC::encrypt(rng, &data, &tckey);
+            tctable->put(CACHEDTRANSFERINDEX, &data);
+        }
+
+        tctable->rewindByType(CACHEDTRANSFERINDEX);
+        while (tctable->next(&id, &data, &tckey))
+        {
+            if ((id & 15) != CACHEDTRANSFERINDEX || id == CACHEDTRANSFERINDEX)
+            {
+                continue;
+            }
+
+            if (CachedTransfer* t = CachedTransfer::unserialize(data))
+            {
+                t->dbid = CachedTransfer::transferId(id);
+                multi_cachedtransfers[t->type].emplace(t, t);
+                if (t->priority > transferlist.currentpriority)
+                {
+                    transferlist.currentpriority = t->priority;
+                }
+                cachedTransfersLoaded += 1;
+            }
+            else
+            {
+                transfercachedel(CachedTransfer::transferId(id));
+                LOG_err << "Failed - transfer index read error";
+            }
+        }
+
+        tctable->rewindByType(CACHEDFILE);
+        while (tctable->next(&id, &data, &tckey))
+        {
+            if ((id & 15) == CACHEDFILE)
+            {
+                cachedfiles.push_back(data);
+                cachedfilesdbids.push_back(id);
+                cachedFilesLoaded += 1;
             }
         }
     }
@@ -14451,7 +14786,7 @@ void MegaClient::fetchnodes(bool nocache, bool loadSyncs, bool forceLoadFromServ
                 // so as to include it in subsequent put nodes
                 if (std::shared_ptr<Node> n = nodeByHandle(mNodeManager.getRootNodeFiles()))
                 {
-                    n->sharekey.reset(new SymmCipher(key)); //we use the "master key", in this case the secret share key
+                    n->sharekey.reset(new SymmKey(key.key)); //we use the "master key", in this case the secret share key
                 }
             }
 
@@ -16536,8 +16871,7 @@ void MegaClient::execmovetosyncdebris(Node* requestedNode, std::function<void(No
                     LOG_debug << "Copy and delete to cloud Syncdebris: " << n->displaypath() << " in " << debrisTarget->displaypath() << " Nhandle: " << LOG_NODEHANDLE(n->nodehandle);
                     TreeProcCopy tc;
                     proctree(n, &tc, false, false);
-                    tc.allocnodes();
-                    proctree(n, &tc, false, false);
+                    tc.finish(this);
                     tc.nn[0].parenthandle = UNDEF;
                     putnodes(debrisTarget->nodeHandle(), NoVersioning, std::move(tc.nn), nullptr, reqtag, rec.mCanChangeVault, [this, rec](const Error&e, targettype_t, vector<NewNode>&, bool, int)
                     {
@@ -16844,13 +17178,13 @@ bool MegaClient::startxfer(direction_t d, File* f, TransferDbCommitter& committe
         {
             // there is no existing transfer uploading this file (or any duplicate of it)
             // check if there used to be, and can we resume one.
-            // Note that these multi_cachedtransfers always have an empty Files list, those are not attached when loading from db
+            // Note that these multi_cachedtransfers have no Files list, those are not attached when loading from db
             // Only the Transfer's own localpath field tells us the path it was uploading
 
             auto range = multi_cachedtransfers[d].equal_range(f);
+            auto cachedIt = range.second;
             for (auto it = range.first; it != range.second; ++it)
             {
-                assert(it->second->files.empty());
                 if (it->second->localfilename.empty()) continue;
 
                 if (d == PUT)
@@ -16859,8 +17193,7 @@ bool MegaClient::startxfer(direction_t d, File* f, TransferDbCommitter& committe
                     if (it->second->localfilename == f->getLocalname())
                     {
                         // the exact same file, so use this one (fingerprint is double checked below)
-                        t = it->second;
-                        multi_cachedtransfers[d].erase(it);
+                        cachedIt = it;
                         break;
                     }
                 }
@@ -16871,14 +17204,13 @@ bool MegaClient::startxfer(direction_t d, File* f, TransferDbCommitter& committe
                        !it->second->downloadFileHandle.isUndef())
                     {
                         // the exact same cloud file, so use this one
-                        t = it->second;
-                        multi_cachedtransfers[d].erase(it);
+                        cachedIt = it;
                         break;
                     }
                 }
             }
 
-            if (!t && d == PUT)
+            if (cachedIt == range.second && d == PUT)
             {
                 // look to see if there a cached transfer that is similar enough
                 // this case could occur if there were multiple Files before the transfer
@@ -16887,7 +17219,6 @@ bool MegaClient::startxfer(direction_t d, File* f, TransferDbCommitter& committe
 
                 for (auto it = range.first; it != range.second; ++it)
                 {
-                    assert(it->second->files.empty());
                     if (it->second->localfilename.empty()) continue;
 
                     string ext1, ext2;
@@ -16900,14 +17231,26 @@ bool MegaClient::startxfer(direction_t d, File* f, TransferDbCommitter& committe
                         if (treatAsIfFileDataEqual(*f, ext1,
                                                    *it->first, ext2))
                         {
-                            t = it->second;
-                            multi_cachedtransfers[d].erase(it);
+                            cachedIt = it;
                             break;
                         }
                     }
                 }
             }
 
+            if (cachedIt != range.second)
+            {
+                // only now unserialize the rest of the cached transfer
+                unique_ptr<CachedTransfer> cachedTransfer(cachedIt->second);
+                multi_cachedtransfers[d].erase(cachedIt);
+
+                if (!(t = cachedTransfer->materialize(this)))
+                {
+                    LOG_err << "Failed - transfer record read error";
+                    transfercachedel(cachedTransfer->dbid);
+                }
+            }
+
             if (t)
             {
                 bool hadAnyData = t->pos > 0;
@@ -1214,7 +1214,7 @@ bool Node::applykey()
                             continue;
                         }
 
-                        sc = n->sharekey.get();
+                        sc = n->sharekey->cipher();
                     }
                     else
                     {
@@ -155,6 +155,9 @@ void NodeManager::notifyNode_internal(std::shared_ptr<Node> n, sharedNode_vector
 
     }
 
+    // any seed of the versioned view that read this node before the change is stale now
+    mVersions.invalidate();
+
     if (!n->notified)
     {
         n->notified = true;
@@ -1324,6 +1327,7 @@ void NodeManager::cleanNodes_internal()
     mNodesInRam = 0;
     mNodeToWriteInDb.reset();
     mNodeNotify.clear();
+    mVersions.clear();
 
     rootnodes.clear();
 
@@ -1406,9 +1410,11 @@ void NodeManager::notifyPurge()
 {
     // only lock to get the nodes to report
     sharedNode_vector nodesToReport;
+    uint64_t batchEpoch;
     {
         LockGuard g(mMutex);
         nodesToReport.swap(mNodeNotify);
+        batchEpoch = mVersions.writeEpoch();
     }
 
     // we do our reporting outside the lock, as it involves callbacks to the client
@@ -1434,6 +1440,15 @@ void NodeManager::notifyPurge()
         {
             std::shared_ptr<Node> n = nodesToReport[i];
 
+            if (n->changed.removed)
+            {
+                mVersions.stageRemoval(n->nodeHandle());
+            }
+            else
+            {
+                mVersions.stage(*n);
+            }
+
             if (n->attrstring)
             {
                 // make this just a warning to avoid auto test failure
@@ -1507,6 +1522,9 @@ void NodeManager::notifyPurge()
             }
         }
 
+        // end of this batch of changes: make them visible to the readers at once
+        mVersions.publish(batchEpoch);
+
         if (removed)
         {
             LOG_verbose << mClient.clientname << "Removed " << removed << " nodes from database";
@@ -1780,6 +1798,27 @@ bool NodeManager::ready()
     return mInitialized;
 }
 
+NodeVersions::SnapshotPtr NodeManager::pinSnapshot() const
+{
+    return mVersions.pin();
+}
+
+bool NodeManager::seedSnapshot(const Node& n, uint64_t readEpoch)
+{
+    vector<NodeVersions::Version> versions;
+    for (const Node* ancestor = &n; ancestor; ancestor = ancestor->parent.get())
+    {
+        versions.emplace_back(*ancestor);
+    }
+
+    return mVersions.seed(std::move(versions), readEpoch);
+}
+
+uint64_t NodeManager::snapshotWriteEpoch() const
+{
+    return mVersions.writeEpoch();
+}
+
 void NodeManager::insertNodeCacheLRU_internal(std::shared_ptr<Node> node)
 {
     assert(mMutex.owns_lock() && "Mutex should be locked by this thread");
@@ -2202,4 +2241,221 @@ void NodeManager::Rootnodes::clear()
     vault.setUndef();
 }
 
+NodeVersions::Version::Version(const Node& n)
+    : cloudNode(n)
+    , isInshare(n.inshare != nullptr)
+{
+    if (isInshare)
+    {
+        inshareOwner = n.inshare->user ? n.inshare->user->email : "UNKNOWN";
+        inshareOwner.append(":");
+    }
+}
+
+NodeVersions::VersionPtr NodeVersions::Snapshot::lookup(NodeHandle h) const
+{
+    const auto& shard = mShards[shardOf(h)];
+    if (!shard)
+    {
+        return nullptr;
+    }
+
+    auto it = shard->find(h);
+    return it != shard->end() ? it->second : nullptr;
+}
+
+bool NodeVersions::Snapshot::displayPath(NodeHandle h, string& path, unsigned* depth, nodetype_t* firstAncestorType) const
+{
+    // same logic as Node::displaypath(), on the versions of this snapshot
+    path.clear();
+    unsigned levels = 0;
+    bool pathComplete = false;
+
+    for (VersionPtr v = lookup(h); v; v = lookup(v->cloudNode.parentHandle))
+    {
+        const CloudNode& cn = v->cloudNode;
+
+        if (!pathComplete)
+        {
+            switch (cn.type)
+            {
+            case FOLDERNODE:
+                path.insert(0, cn.name);
+                if (v->isInshare)
+                {
+                    path.insert(0, v->inshareOwner);
+                    pathComplete = true;
+                }
+                break;
+
+            case VAULTNODE:
+                path.insert(0, "//in");
+                pathComplete = true;
+                break;
+
+            case ROOTNODE:
+                if (path.empty()) path = "/";
+                pathComplete = true;
+                break;
+
+            case RUBBISHNODE:
+                path.insert(0, "//bin");
+                pathComplete = true;
+                break;
+
+            case TYPE_DONOTSYNC:
+            case TYPE_NESTED_MOUNT:
+            case TYPE_SPECIAL:
+            case TYPE_SYMLINK:
+            case TYPE_UNKNOWN:
+            case FILENODE:
+                path.insert(0, cn.name);
+            }
+
+            if (!pathComplete)
+            {
+                path.insert(0, "/");
+            }
+        }
+
+        if (cn.parentHandle.isUndef())
+        {
+            // reached the top of the tree with all the ancestors available
+            if (depth) *depth = levels;
+            if (firstAncestorType) *firstAncestorType = cn.type;
+            return true;
+        }
+
+        ++levels;
+    }
+
+    // the node or one of its ancestors is not tracked
+    return false;
+}
+
+NodeVersions::NodeVersions()
+    : mCurrent(std::make_shared<Snapshot>())
+{
+}
+
+NodeVersions::SnapshotPtr NodeVersions::pin() const
+{
+    return std::atomic_load(&mCurrent);
+}
+
+bool NodeVersions::isTracked(NodeHandle h) const
+{
+    return mStaged.count(h) || mCurrent->lookup(h);
+}
+
+bool NodeVersions::seed(vector<Version>&& versions, uint64_t readEpoch)
+{
+    std::lock_guard<std::mutex> g(mWriterMutex);
+
+    if (mWriteEpoch.load() != readEpoch || readEpoch != mPublishedWriteEpoch)
+    {
+        // something changed meanwhile, or there are changes not published yet: the reader
+        // may have seen a newer state than the published one. It can seed on a later lookup.
+        return false;
+    }
+
+    for (auto& v : versions)
+    {
+        NodeHandle h = v.cloudNode.handle;
+        mStaged[h] = std::make_shared<const Version>(std::move(v));
+    }
+
+    publish_locked(readEpoch);
+    return true;
+}
+
+void NodeVersions::stage(const Node& n)
+{
+    std::lock_guard<std::mutex> g(mWriterMutex);
+
+    // untracked nodes are only added by readers (see seed())
+    if (isTracked(n.nodeHandle()))
+    {
+        mStaged[n.nodeHandle()] = std::make_shared<const Version>(n);
+    }
+}
+
+void NodeVersions::stageRemoval(NodeHandle h)
+{
+    std::lock_guard<std::mutex> g(mWriterMutex);
+
+    if (isTracked(h))
+    {
+        mStaged[h] = nullptr;
+    }
+}
+
+void NodeVersions::publish(uint64_t batchEpoch)
+{
+    std::lock_guard<std::mutex> g(mWriterMutex);
+    publish_locked(batchEpoch);
+}
+
+void NodeVersions::publish_locked(uint64_t batchEpoch)
+{
+    mPublishedWriteEpoch = batchEpoch;
+
+    if (mStaged.empty())
+    {
+        return;
+    }
+
+    // copy-on-write: only the shards with changes are copied
+    auto next = std::make_shared<Snapshot>(*mCurrent);
+    next->mEpoch = mCurrent->mEpoch + 1;
+
+    std::array<std::shared_ptr<Snapshot::Shard>, Snapshot::SHARDS> copied;
+    for (auto& staged : mStaged)
+    {
+        size_t i = Snapshot::shardOf(staged.first);
+        if (!copied[i])
+        {
+            copied[i] = mCurrent->mShards[i] ? std::make_shared<Snapshot::Shard>(*mCurrent->mShards[i])
+                                             : std::make_shared<Snapshot::Shard>();
+            next->mShards[i] = copied[i];
+        }
+
+        if (staged.second)
+        {
+            (*copied[i])[staged.first] = staged.second;
+        }
+        else
+        {
+            copied[i]->erase(staged.first);
+        }
+    }
+    mStaged.clear();
+
+    std::atomic_store(&mCurrent, SnapshotPtr(std::move(next)));
+}
+
+void NodeVersions::clear()
+{
+    std::lock_guard<std::mutex> g(mWriterMutex);
+
+    mPublishedWriteEpoch = ++mWriteEpoch;
+    mStaged.clear();
+
+    auto empty = std::make_shared<Snapshot>();
+    empty->mEpoch = mCurrent->mEpoch + 1;
+    std::atomic_store(&mCurrent, SnapshotPtr(std::move(empty)));
+}
+
+size_t NodeVersions::size() const
+{
+    SnapshotPtr snapshot = pin();
+
+    size_t total = 0;
+    for (auto& shard : snapshot->mShards)
+    {
+        if (shard) total += shard->size();
+    }
+    return total;
+}
+
 } // namespace
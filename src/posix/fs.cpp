@@ -51,9 +51,15 @@ extern JavaVM *MEGAjvm;
 #include <linux/magic.h>
 #endif /* ! __ANDROID__ */
 
+#include <sys/syscall.h>
 #include <sys/sysmacros.h>
 #include <sys/vfs.h>
 
+// from <linux/fs.h>, which conflicts with the libc headers
+#ifndef FICLONE
+#define FICLONE _IOW(0x94, 9, int)
+#endif /* ! FICLONE */
+
 #ifndef FUSEBLK_SUPER_MAGIC
 #define FUSEBLK_SUPER_MAGIC 0x65735546ul
 #endif /* ! FUSEBLK_SUPER_MAGIC */
@@ -510,6 +516,38 @@ void PosixFileAccess::updatelocalname(const LocalPath& name, bool force)
     }
 }
 
+// Ask the kernel to start reading the ranges of the file at fd.
+//
+// The reads are queued asynchronously so that scattered ranges are fetched
+// concurrently rather than one seek at a time.
+static void prefetchRanges(int fd, const vector<m_off_t>& offsets, unsigned length)
+{
+    if (fd < 0)
+        return;
+
+    for (auto offset : offsets)
+    {
+#if defined(POSIX_FADV_WILLNEED)
+        posix_fadvise(fd, offset, length, POSIX_FADV_WILLNEED);
+#elif defined(F_RDADVISE)
+        struct radvisory advice;
+
+        advice.ra_offset = offset;
+        advice.ra_count = static_cast<int>(length);
+
+        fcntl(fd, F_RDADVISE, &advice);
+#else
+        static_cast<void>(offset);
+        static_cast<void>(length);
+#endif
+    }
+}
+
+void PosixFileAccess::prefetch(const vector<m_off_t>& offsets, unsigned length)
+{
+    prefetchRanges(fd, offsets, length);
+}
+
 bool PosixFileAccess::sysread(byte* dst, unsigned len, m_off_t pos)
 {
     retry = false;
@@ -907,6 +945,20 @@ int LinuxFileSystemAccess::checkevents(Waiter* waiter)
             }
 
             auto localName = LocalPath::fromPlatformEncodedRelative(name);
+
+            if ((in->mask & IN_CLOSE_WRITE) && !localName.empty())
+            {
+                // lets the sync take the file as soon as it's been written, see fileSettled()
+                auto fullPath = node.getLocalPath();
+                fullPath.appendWithSeparator(localName, true);
+
+                struct stat metadata;
+                if (!stat(adjustBasePath(fullPath).c_str(), &metadata) && S_ISREG(metadata.st_mode))
+                {
+                    notifier.notifyClosedAfterWrite(fullPath, m_time(), metadata.st_size, metadata.st_mtime);
+                }
+            }
+
             notifier.notify(notifier.fsEventq, &node, Notification::NEEDS_PARENT_SCAN, move(localName));
 
             // We need to rescan the directory if it's changed permissions.
@@ -997,6 +1049,57 @@ bool PosixFileSystemAccess::renamelocal(const LocalPath& oldname, const LocalPat
     return false;
 }
 
+// try the copy methods that don't move the data through user space, fastest first.
+// Returns true if the file was copied entirely, otherwise the caller falls back to
+// copying what's left (from the current file offsets) in the traditional way
+static bool copyWithinKernel(int sfd, int tfd, FileSystemAccess::CopyMethod& method, ssize_t& t)
+{
+#ifdef __linux__
+#ifdef FICLONE
+    // reflink (btrfs, xfs...): no data is copied at all
+    if (!ioctl(tfd, FICLONE, sfd))
+    {
+        LOG_verbose << "Copied via reflink";
+        method = FileSystemAccess::COPY_METHOD_CLONE;
+        t = 0;
+        return true;
+    }
+#endif
+
+#ifdef SYS_copy_file_range
+    // the kernel copies the data (or offloads it to the filesystem/device)
+    off_t copied = 0;
+    while ((t = syscall(SYS_copy_file_range, sfd, nullptr, tfd, nullptr, size_t(1024 * 1024 * 1024), 0u)) > 0)
+    {
+        copied += t;
+    }
+
+    if (!t)
+    {
+        LOG_verbose << "Copied via copy_file_range";
+        method = FileSystemAccess::COPY_METHOD_FILE_RANGE;
+        return true;
+    }
+
+    // not supported for this pair of files (old kernel, cross-filesystem...):
+    // nothing was copied yet, so let the caller do it
+    if (!copied && (errno == ENOSYS || errno == EXDEV || errno == EINVAL || errno == EOPNOTSUPP))
+    {
+        return false;
+    }
+
+    // the copy failed halfway, report it
+    return true;
+#endif
+#endif
+
+    static_cast<void>(sfd);
+    static_cast<void>(tfd);
+    static_cast<void>(method);
+    static_cast<void>(t);
+    return false;
+}
+
 bool PosixFileSystemAccess::copylocal(const LocalPath& oldname, const LocalPath& newname, m_time_t mtime)
 {
     AdjustBasePathResult oldnamestr = adjustBasePath(oldname);
@@ -1005,27 +1108,37 @@ bool PosixFileSystemAccess::copylocal(const LocalPath& oldname, const LocalPath&
     int sfd, tfd;
     ssize_t t = -1;
 
+    last_copy_method = COPY_METHOD_NONE;
+
 #ifdef HAVE_SENDFILE
     // Linux-specific - kernel 2.6.33+ required
     if ((sfd = open(oldnamestr.c_str(), O_RDONLY | O_DIRECT)) >= 0)
     {
-        LOG_verbose << "Copying via sendfile";
         mode_t mode = umask(0);
         if ((tfd = open(newnamestr.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_DIRECT, defaultfilepermissions)) >= 0)
         {
             umask(mode);
-            while ((t = sendfile(tfd, sfd, NULL, 1024 * 1024 * 1024)) > 0);
+            if (!copyWithinKernel(sfd, tfd, last_copy_method, t))
+            {
+                LOG_verbose << "Copying via sendfile";
+                last_copy_method = COPY_METHOD_SENDFILE;
+                while ((t = sendfile(tfd, sfd, NULL, 1024 * 1024 * 1024)) > 0);
+            }
 #else
     char buf[16384];
 
     if ((sfd = open(oldnamestr.c_str(), O_RDONLY)) >= 0)
     {
-        LOG_verbose << "Copying via read/write";
         mode_t mode = umask(0);
         if ((tfd = open(newnamestr.c_str(), O_WRONLY | O_CREAT | O_TRUNC, defaultfilepermissions)) >= 0)
         {
             umask(mode);
-            while (((t = read(sfd, buf, sizeof buf)) > 0) && write(tfd, buf, t) == t);
+            if (!copyWithinKernel(sfd, tfd, last_copy_method, t))
+            {
+                LOG_verbose << "Copying via read/write";
+                last_copy_method = COPY_METHOD_READ_WRITE;
+                while (((t = read(sfd, buf, sizeof buf)) > 0) && write(tfd, buf, t) == t);
+            }
 #endif
             close(tfd);
         }
@@ -1056,6 +1169,7 @@ bool PosixFileSystemAccess::copylocal(const LocalPath& oldname, const LocalPath&
     {
         int e = errno;
         LOG_debug << "Unable to copy file: " << oldnamestr << " to " << newnamestr << ". Error code: " << e;
+        last_copy_method = COPY_METHOD_NONE;
     }
 
     return !t;
@@ -1725,6 +1839,7 @@ void LinuxDirNotify::removeWatch(WatchMapIterator entry)
 }
 
 #endif // USE_INOTIFY
+
 #endif // __linux__
 
 #endif //ENABLE_SYNC
@@ -1734,7 +1849,13 @@ class UnixStreamAccess
 {
 public:
     UnixStreamAccess(const char* path, m_off_t size)
-      : mDescriptor(open(path))
+      : UnixStreamAccess(AT_FDCWD, path, size)
+    {
+    }
+
+    // Opens name relative to the directory descriptor.
+    UnixStreamAccess(int directory, const char* name, m_off_t size)
+      : mDescriptor(open(directory, name))
       , mOffset(0)
       , mSize(size)
     {
@@ -1776,24 +1897,29 @@ public:
         return mDescriptor >= 0 ? mSize : -1;
     }
 
+    void prefetch(const vector<m_off_t>& offsets, unsigned length) override
+    {
+        prefetchRanges(mDescriptor, offsets, length);
+    }
+
 private:
 
     // open with O_NOATIME if possible
-    int open(const char *path)
+    int open(int directory, const char *path)
     {
 #ifdef TARGET_OS_IPHONE
         // building for iOS, there is no O_NOATIME flag
-        int fd = ::open(path, O_RDONLY) ;
+        int fd = ::openat(directory, path, O_RDONLY) ;
 #else
         // for sync in particular, try to open without setting access-time
         // we don't want to update that every time we get a fingerprint to see if it's changed
         // and we don't want to be processing the filesystem notifications that would cause either
-        int fd = ::open(path, O_NOATIME | O_RDONLY);
+        int fd = ::openat(directory, path, O_NOATIME | O_RDONLY);
 
         if (fd < 0 && errno == EPERM)
         {
             // But then, on some systems (Android) sometimes (for external storage, but not for internal), the call fails if we try to set O_NOATIME
-            fd = ::open(path, O_RDONLY);
+            fd = ::openat(directory, path, O_RDONLY);
         }
 #endif
         return fd;
@@ -1804,6 +1930,172 @@ private:
     m_off_t mSize;
 }; // UnixStreamAccess
 
+// Reads a directory's entries in large batches.
+//
+// On Linux, entries are read straight from the kernel with getdents64(...)
+// so that a huge directory costs one system call per few thousand entries.
+// Elsewhere, this is a thin wrapper around readdir(...).
+class DirectoryReader
+{
+public:
+    // Takes ownership of the descriptor.
+    explicit DirectoryReader(int descriptor)
+      : mDescriptor(descriptor)
+    {
+#ifndef __linux__
+        mDirectory = fdopendir(descriptor);
+
+        if (!mDirectory)
+            ::close(descriptor);
+#endif // ! __linux__
+    }
+
+    MEGA_DISABLE_COPY_MOVE(DirectoryReader);
+
+    ~DirectoryReader()
+    {
+#ifdef __linux__
+        ::close(mDescriptor);
+#else // __linux__
+        if (mDirectory)
+            closedir(mDirectory);
+#endif // ! __linux__
+    }
+
+    operator bool() const
+    {
+#ifdef __linux__
+        return true;
+#else // __linux__
+        return mDirectory != nullptr;
+#endif // ! __linux__
+    }
+
+    // Retrieve the next entry in the directory.
+    //
+    // Returns false when there are no more entries or an error occurred.
+    bool next(const char*& name, ino_t& inode, unsigned char& type)
+    {
+#ifdef __linux__
+        // Refill the buffer if we've consumed all the entries it contains.
+        if (mOffset >= mLength)
+        {
+            auto result = syscall(SYS_getdents64,
+                                  mDescriptor,
+                                  mBuffer.data(),
+                                  mBuffer.size());
+
+            if (result <= 0)
+                return false;
+
+            mLength = static_cast<size_t>(result);
+            mOffset = 0;
+        }
+
+        // Layout of the records returned by getdents64(...).
+        struct Entry
+        {
+            uint64_t d_ino;
+            int64_t d_off;
+            unsigned short d_reclen;
+            unsigned char d_type;
+            char d_name[1];
+        }; // Entry
+
+        auto* entry = reinterpret_cast<Entry*>(&mBuffer[mOffset]);
+
+        mOffset += entry->d_reclen;
+
+        name = entry->d_name;
+        inode = static_cast<ino_t>(entry->d_ino);
+        type = entry->d_type;
+
+        return true;
+#else // __linux__
+        auto* entry = readdir(mDirectory);
+
+        if (!entry)
+            return false;
+
+        name = entry->d_name;
+        inode = entry->d_ino;
+        type = entry->d_type;
+
+        return true;
+#endif // ! __linux__
+    }
+
+    // The directory's descriptor, for use with the *at(...) functions.
+    int descriptor() const
+    {
+        return mDescriptor;
+    }
+
+private:
+    int mDescriptor;
+
+#ifdef __linux__
+    // Large enough for several thousand entries.
+    std::vector<char> mBuffer = std::vector<char>(256 * 1024);
+    size_t mLength = 0;
+    size_t mOffset = 0;
+#else // __linux__
+    DIR* mDirectory = nullptr;
+#endif // ! __linux__
+}; // DirectoryReader
+
+// Retrieve information about name relative to the specified directory.
+//
+// Where statx(...) is available, only the fields directoryScan(...) needs
+// are requested and the filesystem is free to serve them from its cache.
+// The type hint, if known, lets us ask for even less.
+static bool statAt(int directory,
+                   const char* name,
+                   unsigned char typeHint,
+                   bool followSymLink,
+                   struct stat& metadata)
+{
+    auto flags = followSymLink ? 0 : AT_SYMLINK_NOFOLLOW;
+
+#if defined(__linux__) && defined(STATX_TYPE)
+    // Whether statx(...) is supported by the running kernel.
+    static std::atomic<bool> haveStatx{true};
+
+    if (haveStatx)
+    {
+        unsigned int mask = STATX_TYPE | STATX_MODE | STATX_INO | STATX_MTIME;
+
+        // Directories don't need a size.
+        if (typeHint != DT_DIR)
+            mask |= STATX_SIZE;
+
+        struct statx extended;
+
+        if (!statx(directory, name, flags | AT_STATX_SYNC_AS_STAT, mask, &extended))
+        {
+            metadata = {};
+            metadata.st_dev = makedev(extended.stx_dev_major, extended.stx_dev_minor);
+            metadata.st_ino = static_cast<ino_t>(extended.stx_ino);
+            metadata.st_mode = extended.stx_mode;
+            metadata.st_size = static_cast<off_t>(extended.stx_size);
+            metadata.st_mtime = static_cast<time_t>(extended.stx_mtime.tv_sec);
+            return true;
+        }
+
+        if (errno != ENOSYS)
+            return false;
+
+        LOG_debug << "statx(...) isn't supported: falling back to fstatat(...)";
+
+        haveStatx = false;
+    }
+#endif // __linux__ && STATX_TYPE
+
+    static_cast<void>(typeHint);
+
+    return !fstatat(directory, name, &metadata, flags);
+}
+
 ScanResult PosixFileSystemAccess::directoryScan(const LocalPath& targetPath,
                                                 handle expectedFsid,
                                                 map<LocalPath, FSNode>& known,
@@ -1823,25 +2115,43 @@ ScanResult PosixFileSystemAccess::directoryScan(const LocalPath& targetPath,
                && lhs.fingerprint.size == rhs.fingerprint.size;
     };
 
-    // So we don't duplicate link chasing logic.
-    auto stat = [&](const char* path, struct stat& metadata, bool* followSymLinkHere = nullptr) {
-        auto result = !lstat(path, &metadata);
+    // Try and open the scan target.
+    //
+    // Symlinks are followed for the scan target itself so that we iterate
+    // over the directory that the link points to.
+    auto descriptor = open(targetPath.localpath.c_str(),
+                           O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+
+    if (descriptor < 0)
+    {
+        LOG_warn << "Failed to directoryScan: "
+                 << "Unable to open scan target for iteration: "
+                 << targetPath
+                 << ". Error code was: "
+                 << errno;
 
-        if (!result) return false;
+        return SCAN_INACCESSIBLE;
+    }
 
-        bool followSymLink = followSymLinkHere ? *followSymLinkHere : followSymLinks;
-        if (!followSymLink || !S_ISLNK(metadata.st_mode))
-            return result;
+    // Iterates over the directory's entries and closes the descriptor.
+    DirectoryReader directory(descriptor);
 
-        return !::stat(path, &metadata);
-    };
+    if (!directory)
+    {
+        LOG_warn << "Failed to directoryScan: "
+                 << "Unable to open scan target for iteration: "
+                 << targetPath
+                 << ". Error code was: "
+                 << errno;
+
+        return SCAN_INACCESSIBLE;
+    }
 
     // Where we store file information.
     struct stat metadata;
 
     // Try and get information about the scan target.
-    bool scanTarget_followSymLink = true; // Follow symlink for the parent directory, so we retrieve the stats of the path that the symlinks points to
-    if (!stat(targetPath.localpath.c_str(), metadata, &scanTarget_followSymLink))
+    if (fstat(descriptor, &metadata))
     {
         LOG_warn << "Failed to directoryScan: "
                  << "Unable to stat(...) scan target: "
@@ -1852,6 +2162,23 @@ ScanResult PosixFileSystemAccess::directoryScan(const LocalPath& targetPath,
         return SCAN_INACCESSIBLE;
     }
 
+    // So we don't duplicate link chasing logic.
+    //
+    // Entries are resolved relative to the scan target's descriptor so
+    // that the kernel doesn't have to walk the target's path every time.
+    auto stat = [&](const char* name, unsigned char type, struct stat& metadata) {
+        // Only symlinks (or entries of unknown type) need a second look.
+        bool mayBeLink = type == DT_LNK || type == DT_UNKNOWN;
+
+        if (!statAt(descriptor, name, type, false, metadata))
+            return false;
+
+        if (!followSymLinks || !mayBeLink || !S_ISLNK(metadata.st_mode))
+            return true;
+
+        return statAt(descriptor, name, DT_UNKNOWN, true, metadata);
+    };
+
     // Is the scan target a directory?
     if (!S_ISDIR(metadata.st_mode))
     {
@@ -1874,41 +2201,29 @@ ScanResult PosixFileSystemAccess::directoryScan(const LocalPath& targetPath,
         return SCAN_FSID_MISMATCH;
     }
 
-    // Try and open the directory for iteration.
-    auto directory = opendir(targetPath.localpath.c_str());
-
-    if (!directory)
-    {
-        LOG_warn << "Failed to directoryScan: "
-                 << "Unable to open scan target for iteration: "
-                 << targetPath
-                 << ". Error code was: "
-                 << errno;
-
-        return SCAN_INACCESSIBLE;
-    }
-
     // What device is this directory on?
     auto device = metadata.st_dev;
 
     // Iterate over the directory's children.
-    auto entry = readdir(directory);
+    const char* name;
+    ino_t inode;
+    unsigned char type;
     auto path = targetPath;
 
-    for ( ; entry; entry = readdir(directory))
+    while (directory.next(name, inode, type))
     {
         // Skip special hardlinks.
-        if (!strcmp(entry->d_name, "."))
+        if (!strcmp(name, "."))
             continue;
 
-        if (!strcmp(entry->d_name, ".."))
+        if (!strcmp(name, ".."))
             continue;
 
         // Push a new scan record.
         auto& result = (results.emplace_back(), results.back());
 
-        result.fsid = (handle)entry->d_ino;
-        result.localname = LocalPath::fromPlatformEncodedRelative(entry->d_name);
+        result.fsid = (handle)inode;
+        result.localname = LocalPath::fromPlatformEncodedRelative(name);
 
         // Compute this entry's absolute name.
         ScopedLengthRestore restorer(path);
@@ -1916,7 +2231,7 @@ ScanResult PosixFileSystemAccess::directoryScan(const LocalPath& targetPath,
         path.appendWithSeparator(result.localname, false);
 
         // Try and get information about this entry.
-        if (!stat(path.localpath.c_str(), metadata))
+        if (!stat(name, type, metadata))
         {
             LOG_warn << "directoryScan: "
                      << "Unable to stat(...) file: "
@@ -2018,7 +2333,8 @@ ScanResult PosixFileSystemAccess::directoryScan(const LocalPath& targetPath,
         }
 
         // Try and open the file for reading.
-        UnixStreamAccess isAccess(path.localpath.c_str(),
+        UnixStreamAccess isAccess(descriptor,
+                                  name,
                                   result.fingerprint.size);
 
         // Only fingerprint the file if we could actually open it.
@@ -2039,9 +2355,6 @@ ScanResult PosixFileSystemAccess::directoryScan(const LocalPath& targetPath,
         ++nFingerprinted;
     }
 
-    // We're done iterating the directory.
-    closedir(directory);
-
     return SCAN_SUCCESS;
 }
 
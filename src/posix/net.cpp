@@ -1540,7 +1540,9 @@ void CurlHttpIO::send_request(CurlHttpContext* httpctx)
         curl_easy_setopt(curl, CURLOPT_SEEKDATA, (void*)req);
         curl_easy_setopt(curl, CURLOPT_USERAGENT, httpio->useragent.c_str());
         curl_easy_setopt(curl, CURLOPT_HTTPHEADER, httpctx->headers);
-        curl_easy_setopt(curl, CURLOPT_ENCODING, "");
+        // API responses are large, repetitive JSON: let cURL negotiate any encoding it supports
+        // and decode it as it arrives. File data is encrypted, so asking for compression is pointless.
+        curl_easy_setopt(curl, CURLOPT_ENCODING, (req->type == REQ_JSON && httpio->acceptencoding) ? "" : nullptr);
         curl_easy_setopt(curl, CURLOPT_SHARE, httpio->curlsh);
         curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_data);
         curl_easy_setopt(curl, CURLOPT_WRITEDATA, (void*)req);
@@ -2297,6 +2299,17 @@ bool CurlHttpIO::multidoio(CURLM *curlmhandle)
                 curl_easy_getinfo(msg->easy_handle, CURLINFO_RESPONSE_CODE, &httpstatus);
                 req->httpstatus = int(httpstatus);
 
+                // without a request body, the first byte of the response arrives one round trip after the request
+                // is sent. requests with a body (uploads) send it first, so only a new connection's TCP handshake tells
+                double uploaded = 0, namelookup = 0, connect = 0, pretransfer = 0, starttransfer = 0;
+                curl_easy_getinfo(msg->easy_handle, CURLINFO_SIZE_UPLOAD, &uploaded);
+                curl_easy_getinfo(msg->easy_handle, CURLINFO_NAMELOOKUP_TIME, &namelookup);
+                curl_easy_getinfo(msg->easy_handle, CURLINFO_CONNECT_TIME, &connect);
+                curl_easy_getinfo(msg->easy_handle, CURLINFO_PRETRANSFER_TIME, &pretransfer);
+                curl_easy_getinfo(msg->easy_handle, CURLINFO_STARTTRANSFER_TIME, &starttransfer);
+                double roundtrip = uploaded > 0 ? connect - namelookup : starttransfer - pretransfer;
+                req->roundtripms = roundtrip > 0 ? int(roundtrip * 1000) : -1;
+
                 LOG_debug << req->logname << "CURLMSG_DONE with HTTP status: " << req->httpstatus << " from "
                           << (req->httpiohandle ? (((CurlHttpContext*)req->httpiohandle)->hostname + " - " + ((CurlHttpContext*)req->httpiohandle)->hostip) : "(unknown) ");
                 if (req->httpstatus)
@@ -2657,19 +2670,41 @@ size_t CurlHttpIO::check_header(void* ptr, size_t size, size_t nmemb, void* targ
             req->contentlength = -1;
         }
 
+        req->mContentEncoded = false;
+        req->mOriginalContentLength = false;
+
         return size * nmemb;
     }
     else if (len > 15 && !memcmp(ptr, "Content-Length:", 15))
     {
-        if (req->contentlength < 0)
+        if (req->contentlength < 0 && !req->mContentEncoded)
         {
             req->setcontentlength(atoll((char*)ptr + 15));
         }
     }
     else if (len > 24 && !memcmp(ptr, "Original-Content-Length:", 24))
     {
+        req->mOriginalContentLength = true;
         req->setcontentlength(atoll((char*)ptr + 24));
     }
+    else if (len > 17 && !memcmp(ptr, "Content-Encoding:", 17))
+    {
+        string encoding((char*)ptr + 17, len - 17);
+        encoding.erase(0, encoding.find_first_not_of(" \t"));
+        encoding.erase(encoding.find_last_not_of(" \t\r\n") + 1);
+
+        if (!encoding.empty() && strcasecmp(encoding.c_str(), "identity"))
+        {
+            NET_debug << req->logname << "Response body is " << encoding << " encoded";
+            req->mContentEncoded = true;
+
+            if (!req->mOriginalContentLength)
+            {
+                // the Content-Length seen so far (if any) is the encoded size
+                req->contentlength = -1;
+            }
+        }
+    }
     else if (len > 17 && !memcmp(ptr, "X-MEGA-Time-Left:", 17))
     {
         req->timeleft = atol((char*)ptr + 17);
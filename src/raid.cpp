@@ -927,6 +927,11 @@ std::pair<m_off_t, m_off_t> TransferBufferManager::nextNPosForConnection(unsigne
             m_off_t speedsize = std::min<m_off_t>(maxsize, uploadSpeed * 2 / 3);        // two seconds of data over 3 connections
             m_off_t sizesize = transfer->size > largeSize ? 8 * 1024 * 1024 : 0; // start with large-ish portions for large files.
             m_off_t targetsize = std::max<m_off_t>(sizesize, speedsize);
+            if (maxRequestSize < TransferSlot::MAX_REQ_SIZE)
+            {
+                // the memory budget is tight, keep the in-flight chunks small
+                targetsize = std::min<m_off_t>(targetsize, maxRequestSize);
+            }
             maxReqSize = targetsize;
         }
         else if (transfer->type == GET)
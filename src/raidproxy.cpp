@@ -34,7 +34,7 @@ PartFetcher::~PartFetcher()
 
         while (!mReadahead.empty())
         {
-            free(mReadahead.begin()->second.first);
+            TransferMemoryBudget::global().releaseBuffer(mReadahead.begin()->second.first, mReadahead.begin()->second.second);
             mReadahead.erase(mReadahead.begin());
         }
     }
@@ -582,7 +582,7 @@ bool PartFetcher::feedreadahead()
         mReadahead.erase(it);
 
         rr->procdata(part, d, p, l);
-        free(d);
+        TransferMemoryBudget::global().releaseBuffer(d, l);
 
         remaining--;
     }
@@ -987,9 +987,24 @@ void RaidReq::procdata(uint8_t part, byte* ptr, m_off_t pos, m_off_t len)
         auto itReadAhead = mFetcher[part].mReadahead.find(ahead_pos);
         if (itReadAhead == mFetcher[part].mReadahead.end() || itReadAhead->second.second < ahead_len)
         {
-            byte* p = itReadAhead != mFetcher[part].mReadahead.end() ?
-                            static_cast<byte*>(std::realloc(itReadAhead->second.first, ahead_len)) :
-                            static_cast<byte*>(malloc(ahead_len));
+            // readahead buffers come from the transfer memory pool, which hands out whole size classes
+            auto& budget = TransferMemoryBudget::global();
+            byte* p = nullptr;
+            if (itReadAhead != mFetcher[part].mReadahead.end())
+            {
+                if (TransferMemoryBudget::bufferCapacity(itReadAhead->second.second) == TransferMemoryBudget::bufferCapacity(static_cast<size_t>(ahead_len)))
+                {
+                    p = itReadAhead->second.first;
+                }
+                else
+                {
+                    budget.releaseBuffer(itReadAhead->second.first, itReadAhead->second.second);
+                }
+            }
+            if (!p)
+            {
+                p = budget.acquireBuffer(static_cast<size_t>(ahead_len));
+            }
             std::copy(ahead_ptr, ahead_ptr + ahead_len, p);
             mFetcher[part].mReadahead[ahead_pos] = pair<byte*, unsigned>(p, static_cast<unsigned>(ahead_len));
         }
@@ -3995,6 +3995,31 @@ void Syncs::queueClient(std::function<void(MegaClient&, TransferDbCommitter&)>&&
     mClient.waiter->notify();
 }
 
+bool Syncs::nextClientAction(QueuedClientFunc& f)
+{
+    assert(!onSyncThread());
+
+    if (clientThreadBatch.empty() &&
+        !clientThreadActions.popFrontBatch(clientThreadBatch))
+    {
+        return false;
+    }
+
+    f = std::move(clientThreadBatch.front());
+    clientThreadBatch.pop_front();
+    return true;
+}
+
+bool Syncs::clientActionsPending()
+{
+    return !clientThreadBatch.empty() || !clientThreadActions.empty();
+}
+
+size_t Syncs::clientActionsCount()
+{
+    return clientThreadBatch.size() + clientThreadActions.size();
+}
+
 void Syncs::getSyncProblems(std::function<void(unique_ptr<SyncProblems>)> completion,
                             bool completionInClient)
 {
@@ -4018,6 +4043,237 @@ void Syncs::getSyncProblems(std::function<void(unique_ptr<SyncProblems>)> comple
     }, "getSyncProblems");
 }
 
+void Syncs::getSyncStallChanges(uint64_t sinceVersion,
+                                size_t maxChanges,
+                                std::function<void(unique_ptr<SyncStallChanges>)> completion,
+                                bool completionInClient)
+{
+    using MC = MegaClient;
+    using DBTC = TransferDbCommitter;
+
+    if (completionInClient)
+    {
+        completion = [this, completion](unique_ptr<SyncStallChanges> changes) {
+            SyncStallChanges* rawPtr = changes.release();
+            queueClient([completion, rawPtr](MC&, DBTC&) mutable {
+                completion(unique_ptr<SyncStallChanges>(rawPtr));
+            });
+        };
+    }
+
+    queueSync([this, sinceVersion, maxChanges, completion]() mutable {
+        unique_ptr<SyncStallChanges> changes(new SyncStallChanges);
+        mStallLog.changesSince(sinceVersion, maxChanges, *changes);
+        completion(move(changes));
+    }, "getSyncStallChanges");
+}
+
+void Syncs::updateStallLog()
+{
+    assert(onSyncThread());
+
+    // the same stalls as getSyncProblems() reports
+    SyncStallInfo stalls;
+    for (auto& r: stallReport.cloud)
+    {
+        if (syncStallState || r.second.alertUserImmediately)
+        {
+            stalls.cloud.insert(r);
+        }
+    }
+    for (auto& r: stallReport.local)
+    {
+        if (syncStallState || r.second.alertUserImmediately)
+        {
+            stalls.local.insert(r);
+        }
+    }
+    combineMoveStalls(stalls);
+
+    mStallLog.update(stalls);
+}
+
+bool SyncStallLog::sameStalls(const SyncStallInfo& a, const SyncStallInfo& b)
+{
+    auto same = [](const auto& x, const auto& y)
+    {
+        return x.size() == y.size()
+            && std::equal(x.begin(), x.end(), y.begin(), [](const auto& i, const auto& j)
+               {
+                   return i.first == j.first && sameEntry(i.second, j.second);
+               });
+    };
+
+    return same(a.cloud, b.cloud) && same(a.local, b.local);
+}
+
+bool SyncStallLog::sameEntry(const SyncStallEntry& a, const SyncStallEntry& b)
+{
+    auto sameCloud = [](const SyncStallEntry::StallCloudPath& x, const SyncStallEntry::StallCloudPath& y)
+    {
+        return x.problem == y.problem && x.cloudPath == y.cloudPath && x.cloudHandle == y.cloudHandle;
+    };
+    auto sameLocal = [](const SyncStallEntry::StallLocalPath& x, const SyncStallEntry::StallLocalPath& y)
+    {
+        return x.problem == y.problem && x.localPath == y.localPath;
+    };
+
+    return a.reason == b.reason
+        && a.alertUserImmediately == b.alertUserImmediately
+        && a.detectionSideIsMEGA == b.detectionSideIsMEGA
+        && sameCloud(a.cloudPath1, b.cloudPath1)
+        && sameCloud(a.cloudPath2, b.cloudPath2)
+        && sameLocal(a.localPath1, b.localPath1)
+        && sameLocal(a.localPath2, b.localPath2);
+}
+
+void SyncStallLog::stamp(Record& record)
+{
+    if (record.version)
+    {
+        mByVersion.erase(record.version);
+    }
+    record.version = ++mVersion;
+    mByVersion.emplace(record.version, &record);
+}
+
+template<typename Key>
+void SyncStallLog::updateSide(map<Key, Record>& records, const map<Key, SyncStallEntry>& stalls)
+{
+    // both are sorted, so walk them together
+    auto r = records.begin();
+    auto s = stalls.begin();
+
+    while (r != records.end() || s != stalls.end())
+    {
+        if (s == stalls.end() || (r != records.end() && r->first < s->first))
+        {
+            // no longer stalled
+            if (!r->second.removed)
+            {
+                r->second.removed = true;
+                ++mRemoved;
+                stamp(r->second);
+            }
+            ++r;
+        }
+        else if (r == records.end() || s->first < r->first)
+        {
+            // newly stalled
+            auto it = records.emplace_hint(r, s->first, Record());
+            it->second.entry = s->second;
+            it->second.setKey(it->first);
+            stamp(it->second);
+            ++s;
+        }
+        else
+        {
+            // still stalled, maybe for other reasons
+            if (r->second.removed || !sameEntry(r->second.entry, s->second))
+            {
+                if (r->second.removed)
+                {
+                    r->second.removed = false;
+                    --mRemoved;
+                }
+                r->second.entry = s->second;
+                stamp(r->second);
+            }
+            ++r;
+            ++s;
+        }
+    }
+}
+
+void SyncStallLog::forgetRemoved()
+{
+    // oldest removals first
+    for (auto it = mByVersion.begin(); mRemoved > MAX_REMOVED && it != mByVersion.end(); )
+    {
+        Record* record = it->second;
+        if (!record->removed)
+        {
+            ++it;
+            continue;
+        }
+
+        mForgottenBefore = it->first + 1;
+        it = mByVersion.erase(it);
+        --mRemoved;
+
+        if (record->cloudKey)
+        {
+            mCloud.erase(*record->cloudKey);
+        }
+        else
+        {
+            mLocal.erase(*record->localKey);
+        }
+    }
+}
+
+void SyncStallLog::update(const SyncStallInfo& stalls)
+{
+    updateSide(mCloud, stalls.cloud);
+    updateSide(mLocal, stalls.local);
+    forgetRemoved();
+}
+
+void SyncStallLog::changesSince(uint64_t sinceVersion, size_t maxChanges, SyncStallChanges& changes) const
+{
+    changes.mChanges.clear();
+    changes.mMore = false;
+
+    // the caller missed removals we no longer know about (or has a version we never gave out)
+    changes.mReset = sinceVersion > mVersion || (sinceVersion && sinceVersion + 1 < mForgottenBefore);
+    if (changes.mReset)
+    {
+        sinceVersion = 0;
+    }
+
+    changes.mVersion = sinceVersion;
+
+    for (auto it = mByVersion.upper_bound(sinceVersion); it != mByVersion.end(); ++it)
+    {
+        const Record& record = *it->second;
+
+        // starting from scratch, removals mean nothing
+        if (!sinceVersion && record.removed)
+        {
+            continue;
+        }
+
+        if (changes.mChanges.size() >= maxChanges)
+        {
+            changes.mMore = true;
+            break;
+        }
+
+        SyncStallChanges::Change change;
+        change.removed = record.removed;
+        change.cloud = record.cloudKey != nullptr;
+        if (record.cloudKey)
+        {
+            change.cloudKey = *record.cloudKey;
+        }
+        else
+        {
+            change.localKey = *record.localKey;
+        }
+        if (!record.removed)
+        {
+            change.entry = record.entry;
+        }
+        changes.mChanges.push_back(std::move(change));
+        changes.mVersion = it->first;
+    }
+
+    if (!changes.mMore)
+    {
+        changes.mVersion = mVersion;
+    }
+}
+
 void Syncs::getSyncProblems_inThread(SyncProblems& problems)
 {
     assert(onSyncThread());
@@ -4025,6 +4281,11 @@ void Syncs::getSyncProblems_inThread(SyncProblems& problems)
     problems.mStallsDetected = stallsDetected(problems.mStalls);
     problems.mConflictsDetected = conflictsDetected(problems.mConflicts);
 
+    combineMoveStalls(problems.mStalls);
+}
+
+void Syncs::combineMoveStalls(SyncStallInfo& stalls)
+{
     // Try to present just one item for a move/rename, instead of two.
     // We may have generated two items, one for the source node
     // and one for the target node.   Most paths will match between the two.
@@ -4056,14 +4317,14 @@ void Syncs::getSyncProblems_inThread(SyncProblems& problems)
         }
     };
 
-    for (auto si = problems.mStalls.local.begin();
-              si != problems.mStalls.local.end();
+    for (auto si = stalls.local.begin();
+              si != stalls.local.end();
               ++si)
     {
         if (si->second.reason == SyncWaitReason::MoveOrRenameCannotOccur)
         {
-            auto so = problems.mStalls.local.find(si->second.localPath2.localPath);
-            if (so != problems.mStalls.local.end())
+            auto so = stalls.local.find(si->second.localPath2.localPath);
+            if (so != stalls.local.end())
             {
                 if (so != si &&
                     so->second.reason == SyncWaitReason::MoveOrRenameCannotOccur &&
@@ -4078,20 +4339,20 @@ void Syncs::getSyncProblems_inThread(SyncProblems& problems)
                         si->second.cloudPath2.cloudPath = so->second.cloudPath2.cloudPath;
                     }
                     // other iterators are not invalidated in std::map
-                    problems.mStalls.local.erase(so);
+                    stalls.local.erase(so);
                 }
             }
         }
     }
 
-    for (auto si = problems.mStalls.cloud.begin();
-        si != problems.mStalls.cloud.end();
+    for (auto si = stalls.cloud.begin();
+        si != stalls.cloud.end();
         ++si)
     {
         if (si->second.reason == SyncWaitReason::MoveOrRenameCannotOccur)
         {
-            auto so = problems.mStalls.cloud.find(si->second.cloudPath2.cloudPath);
-            if (so != problems.mStalls.cloud.end())
+            auto so = stalls.cloud.find(si->second.cloudPath2.cloudPath);
+            if (so != stalls.cloud.end())
             {
                 if (so != si &&
                     so->second.reason == SyncWaitReason::MoveOrRenameCannotOccur &&
@@ -4106,7 +4367,7 @@ void Syncs::getSyncProblems_inThread(SyncProblems& problems)
                         si->second.localPath2.localPath = so->second.localPath2.localPath;
                     }
                     // other iterators are not invalidated in std::map
-                    problems.mStalls.cloud.erase(so);
+                    stalls.cloud.erase(so);
                 }
             }
         }
@@ -5650,6 +5911,7 @@ void Syncs::clear_inThread()
     mSyncVecIsEmpty = true;
     syncKey.setkey((byte*)"\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0");
     stallReport = SyncStallInfo();
+    mStallReportChanged = true;
     triggerHandles.clear();
     localnodeByScannedFsid.clear();
     localnodeBySyncedFsid.clear();
@@ -8074,6 +8336,14 @@ bool Sync::syncItem_checkDownloadCompletion(SyncRow& row, SyncRow& parentRow, Sy
             // Download was moved into place.
             downloadPtr->wasDistributed = true;
 
+            // Further downloads of the same contents can be copied from here.
+            syncs.queueClient([fingerprint = FileFingerprint(*downloadPtr),
+                               metaMac = MemAccess::get<int64_t>((const char*)downloadPtr->filekey + SymmCipher::KEYLENGTH + sizeof(int64_t)),
+                               targetPath](MegaClient& mc, TransferDbCommitter&)
+            {
+                mc.mLocalFileIndex.add(fingerprint, metaMac, targetPath);
+            });
+
             // No longer necessary as the transfer's complete.
             row.syncNode->resetTransfer(nullptr);
 
@@ -10178,7 +10448,14 @@ bool Sync::checkIfFileIsChanging(FSNode& fsNode, const LocalPath& fullPath)
             {
                 LOG_debug << syncname << "File detected in the origin of a move";
 
-                if (currentsecs >= state.updatedfilets)
+                // no need to watch the file for a while if its writer already told us it's done
+                bool settled = dirnotify && dirnotify->fileSettled(fullPath, prevfa->size, prevfa->mtime);
+
+                if (settled)
+                {
+                    LOG_debug << syncname << "The file was closed after its last write";
+                }
+                else if (currentsecs >= state.updatedfilets)
                 {
                     if ((currentsecs - state.updatedfilets) < (Sync::FILE_UPDATE_DELAY_DS / 10))
                     {
@@ -10206,7 +10483,7 @@ bool Sync::checkIfFileIsChanging(FSNode& fsNode, const LocalPath& fullPath)
                     LOG_warn << syncname << "File checked in the future";
                 }
 
-                if (!waitforupdate)
+                if (!waitforupdate && !settled)
                 {
                     if (currentsecs >= prevfa->mtime)
                     {
@@ -11687,23 +11964,28 @@ void Syncs::syncLoop()
 
         // execute any requests from the MegaClient
         waiter->bumpds();
-        QueuedSyncFunc f;
-        while (syncThreadActions.popFront(f))
+        std::deque<QueuedSyncFunc> batch;
+        while (syncThreadActions.popFrontBatch(batch))
         {
-            if (!f.first)
+            for (; !batch.empty(); batch.pop_front())
             {
-                // null function is the signal to end the thread
-                // Be sure to flush changes made to internal configs.
-                syncConfigStoreFlush();
-                return;
-            }
+                auto& f = batch.front();
 
-            if (!f.second.empty())
-            {
-                LOG_debug << "Sync thread executing request: " << f.second;
-            }
+                if (!f.first)
+                {
+                    // null function is the signal to end the thread
+                    // Be sure to flush changes made to internal configs.
+                    syncConfigStoreFlush();
+                    return;
+                }
+
+                if (!f.second.empty())
+                {
+                    LOG_debug << "Sync thread executing request: " << f.second;
+                }
 
-            f.first();
+                f.first();
+            }
         }
 
         waiter->bumpds();
@@ -12523,9 +12805,6 @@ void Syncs::processSyncStalls()
         stallReport.cloud.swap(mSyncFlags->stall.cloud);
         stallReport.local.swap(mSyncFlags->stall.local);
         stallReport.stalledSyncs.swap(mSyncFlags->stall.stalledSyncs);
-        mSyncFlags->stall.cloud.clear();
-        mSyncFlags->stall.local.clear();
-        mSyncFlags->stall.stalledSyncs.clear();
 
         bool immediateStall = hasImmediateStall(stallReport);
         bool progressLackStall = mSyncFlags->noProgressCount > 10
@@ -12555,12 +12834,22 @@ void Syncs::processSyncStalls()
             for (auto& p : stallReport.cloud) LOG_warn << "stalled node path (" << syncWaitReasonDebugString(p.second.reason) << "): " << p.first;
             for (auto& p : stallReport.local) LOG_warn << "stalled local path (" << syncWaitReasonDebugString(p.second.reason) << "): " << p.first;
         }
+
+        // mSyncFlags->stall holds last pass's report now
+        if (!SyncStallLog::sameStalls(stallReport, mSyncFlags->stall))
+        {
+            mStallReportChanged = true;
+        }
+        mSyncFlags->stall.cloud.clear();
+        mSyncFlags->stall.local.clear();
+        mSyncFlags->stall.stalledSyncs.clear();
     }
 
     if (stalled != syncStallState)
     {
         assert(onSyncThread());
         syncStallState = stalled;
+        mStallReportChanged = true;  // decides which stalls are reported
         mClient.app->syncupdate_totalstalls(false);
         mClient.app->syncupdate_stalled(stalled);
         if (stalled)
@@ -12588,6 +12877,12 @@ void Syncs::processSyncStalls()
         }
         lastSyncStallsCount = std::chrono::steady_clock::now();
     }
+
+    if (mStallReportChanged)
+    {
+        mStallReportChanged = false;
+        updateStallLog();
+    }
 }
 
 void Syncs::proclocaltree(LocalNode* n, LocalTreeProc* tp)
@@ -12623,6 +12918,38 @@ bool Syncs::lookupCloudNode(NodeHandle h, CloudNode& cn, string* cloudPath, bool
 
     if (h.isUndef()) return false;
 
+    // simple queries can be answered from the latest snapshot of the node tree, without waiting
+    // for actionpacket processing to release the tree (see NodeVersions)
+    bool snapshotQuery = !nodeIsInActiveSyncQuery && !owningUser && !sdsBackups
+                         && (whichVersion == EXACT_VERSION || whichVersion == FOLDER_ONLY);
+
+    if (snapshotQuery)
+    {
+        auto snapshot = mClient.mNodeManager.pinSnapshot();
+        if (auto version = snapshot->lookup(h))
+        {
+            string path;
+            unsigned levels = 0;
+            nodetype_t firstAncestorType = TYPE_UNKNOWN;
+
+            // file versions count their depth from the latest version, leave those to the full lookup
+            if (version->cloudNode.parentType != FILENODE
+                && snapshot->displayPath(h, path, &levels, &firstAncestorType))
+            {
+                assert(whichVersion != FOLDER_ONLY || version->cloudNode.type > FILENODE);
+
+                if (isInTrash) *isInTrash = firstAncestorType == RUBBISHNODE;
+                if (cloudPath) *cloudPath = std::move(path);
+                if (depth) *depth = levels;
+
+                cn = version->cloudNode;
+                return true;
+            }
+        }
+    }
+
+    uint64_t snapshotEpoch = mClient.mNodeManager.snapshotWriteEpoch();
+
     vector<pair<NodeHandle, Sync*>> activeSyncHandles;
     vector<pair<std::shared_ptr<Node>, Sync*>> activeSyncRoots;
 
@@ -12698,6 +13025,12 @@ bool Syncs::lookupCloudNode(NodeHandle h, CloudNode& cn, string* cloudPath, bool
 
         cn = CloudNode(*n);
 
+        if (snapshotQuery)
+        {
+            // answer the next lookups of this node from the snapshot
+            mClient.mNodeManager.seedSnapshot(*n, snapshotEpoch);
+        }
+
         if (nodeIsInActiveSyncQuery)
         {
             auto it = std::find_if(activeSyncRoots.begin(), activeSyncRoots.end(),
@@ -158,6 +158,12 @@ Transfer::~Transfer()
         client->asyncfopens--;
     }
 
+    if (localFileCopy && localFileCopy->cancel() && !finished)
+    {
+        // the copy was made but it won't be used
+        client->fsaccess->unlinklocal(localfilename);
+    }
+
     if (finished)
     {
         if (type == GET && !localfilename.empty())
@@ -344,10 +350,103 @@ Transfer *Transfer::unserialize(MegaClient *client, string *d, transfer_multimap
 
     t->chunkmacs.calcprogress(t->size, t->pos, t->progresscompleted);
 
-    multi_transfers[type].insert(pair<FileFingerprint*, Transfer*>(t.get(), t.get()));
+    if (multi_transfers)
+    {
+        multi_transfers[type].insert(pair<FileFingerprint*, Transfer*>(t.get(), t.get()));
+    }
     return t.release();
 }
 
+CachedTransfer::CachedTransfer(const Transfer& transfer)
+    : FileFingerprint(transfer)
+    , type(transfer.type)
+    , localfilename(transfer.localfilename)
+    , downloadFileHandle(transfer.downloadFileHandle)
+    , lastaccesstime(transfer.lastaccesstime)
+    , priority(transfer.priority)
+{
+    dbid = transfer.dbid;
+}
+
+bool CachedTransfer::serialize(string* d) const
+{
+    CacheableWriter w(*d);
+    w.serializeu8(static_cast<uint8_t>(type));
+    w.serializestring(localfilename.platformEncoded());
+
+    if (!FileFingerprint::serialize(d))
+    {
+        LOG_err << "Error serializing cached transfer: Unable to serialize FileFingerprint";
+        return false;
+    }
+
+    w.serializei64(lastaccesstime);
+    w.serializeu64(priority);
+    w.serializeNodeHandle(downloadFileHandle);
+    w.serializeexpansionflags();
+    return true;
+}
+
+CachedTransfer* CachedTransfer::unserialize(const string& d)
+{
+    CacheableReader r(d);
+
+    unique_ptr<CachedTransfer> t(new CachedTransfer);
+    uint8_t type;
+    string filepath;
+    unsigned char expansionflags[8] = { 0 };
+
+    if (!r.unserializeu8(type) ||
+        (type != GET && type != PUT) ||
+        !r.unserializestring(filepath) ||
+        !r.unserializefingerprint(*t) ||
+        !r.unserializei64(t->lastaccesstime) ||
+        !r.unserializeu64(t->priority) ||
+        !r.unserializeNodeHandle(t->downloadFileHandle) ||
+        !r.unserializeexpansionflags(expansionflags, 0))
+    {
+        LOG_err << "Cached transfer unserialization failed at field " << r.fieldnum;
+        return nullptr;
+    }
+
+    t->type = static_cast<direction_t>(type);
+    if (!filepath.empty())
+    {
+        t->localfilename = LocalPath::fromPlatformEncodedAbsolute(filepath);
+    }
+    return t.release();
+}
+
+uint32_t CachedTransfer::indexId(uint32_t transferDbid)
+{
+    // DbTable leaves IDSPACING ids for each record, so the index goes in the transfer's spare ones
+    return (transferDbid & -DbTable::IDSPACING) | MegaClient::CACHEDTRANSFERINDEX;
+}
+
+uint32_t CachedTransfer::transferId(uint32_t indexDbid)
+{
+    return (indexDbid & -DbTable::IDSPACING) | MegaClient::CACHEDTRANSFER;
+}
+
+Transfer* CachedTransfer::materialize(MegaClient* client) const
+{
+    string d;
+    if (!client->tctable ||
+        !client->tctable->get(dbid, &d) ||
+        !PaddedCBC::decrypt(&d, &client->tckey))
+    {
+        LOG_err << "Cached transfer record not found: " << dbid;
+        return nullptr;
+    }
+
+    Transfer* t = Transfer::unserialize(client, &d, nullptr);
+    if (t)
+    {
+        t->dbid = dbid;
+    }
+    return t;
+}
+
 SymmCipher *Transfer::transfercipher()
 {
     return client->getRecycledTemporaryTransferCipher(transferkey.data());
@@ -587,8 +686,18 @@ void Transfer::addAnyMissingMediaFileAttributes(Node* node, /*const*/ LocalPath&
             client->mediaFileInfo.requestCodecMappingsOneTime(client, LocalPath());
 
             // always get the attribute string; it may indicate this version of the mediaInfo library was unable to interpret the file
+            // the same contents may have been parsed already, or (uploads) be parsed on a worker thread while the data was sent
+            const FileFingerprint& fp = (type == PUT) ? static_cast<const FileFingerprint&>(*this) : *node;
             MediaProperties vp;
-            vp.extractMediaPropertyFileAttributes(localpath, client->fsaccess.get());
+            if (!client->mediaFileInfo.getCachedProperties(fp, vp))
+            {
+                if (!(type == PUT && mediaExtraction && mediaExtraction->result(vp)))
+                {
+                    vp.extractMediaPropertyFileAttributes(localpath, client->fsaccess.get());
+                }
+                client->mediaFileInfo.cacheProperties(fp, vp);
+            }
+            mediaExtraction.reset();
 
             if (type == PUT)
             {
@@ -819,6 +928,7 @@ void Transfer::complete(TransferDbCommitter& committer)
                 if (success)
                 {
                     (*it)->setLocalname(finalpath);  // so the app may report an accurate final name
+                    client->mLocalFileIndex.add(*this, metamac, finalpath);
                 }
                 else if (transient_error)
                 {
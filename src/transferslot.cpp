@@ -31,6 +31,12 @@
 #include "mega/raid.h"
 #include "mega/testhooks.h"
 
+#include <fstream>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
 namespace mega {
 
 TransferSlotFileAccess::TransferSlotFileAccess(std::unique_ptr<FileAccess>&& p, Transfer* t)
@@ -101,7 +107,57 @@ TransferSlot::TransferSlot(Transfer* ctransfer)
 
     slots_it = transfer->client->tslots.end();
 
-    maxRequestSize = MAX_REQ_SIZE;
+    // share the process-wide transfer memory with the other slots
+    TransferMemoryBudget::global().addSlot();
+    maxRequestSize = TransferMemoryBudget::global().requestSize(MAX_REQ_SIZE, std::max<unsigned>(1, transfer->client->connections[transfer->type]));
+}
+
+const m_off_t TransferMemoryBudget::MAX_POOLED_BYTES = 32 * 1024 * 1024;
+
+TransferMemoryBudget::TransferMemoryBudget(m_off_t budget)
+    : mBudget(budget)
+{
+}
+
+TransferMemoryBudget::~TransferMemoryBudget()
+{
+    freePool();
+}
+
+void TransferMemoryBudget::freePool()
+{
+    lock_guard<mutex> g(mMutex);
+    for (auto& sizeClass : mPool)
+    {
+        for (auto buffer : sizeClass.second)
+        {
+            delete[] buffer;
+        }
+    }
+    mPool.clear();
+    mPooledBytes = 0;
+}
+
+TransferMemoryBudget& TransferMemoryBudget::global()
+{
+    // never destroyed, so slots of clients torn down late can still give their memory back
+    static TransferMemoryBudget* budget = []()
+    {
+        const m_off_t DEFAULT_BUDGET = 1024ll * 1024 * 1024;   // if the memory limit is unknown
+        const m_off_t MIN_BUDGET = 16 * 1024 * 1024;
+
+        m_off_t limit = detectMemoryLimit();
+        m_off_t b = limit ? std::max(limit / 8, MIN_BUDGET) : DEFAULT_BUDGET;
+        LOG_debug << "Transfer memory budget: " << b << " bytes (memory limit: " << limit << ")";
+        return new TransferMemoryBudget(b);
+    }();
+    return *budget;
+}
+
+m_off_t TransferMemoryBudget::detectMemoryLimit()
+{
+    m_off_t limit = 0;
+
 #if defined(_WIN32)
     MEMORYSTATUSEX statex;
     memset(&statex, 0, sizeof (statex));
@@ -109,33 +165,191 @@ TransferSlot::TransferSlot(Transfer* ctransfer)
     if (GlobalMemoryStatusEx(&statex))
     {
         LOG_debug << "[Windows] RAM stats. Free physical: " << statex.ullAvailPhys << "   Free virtual: " << statex.ullAvailVirtual;
-        if (statex.ullAvailPhys < 1073741824 // 1024 MB
-                || statex.ullAvailVirtual < 1073741824)
-        {
-            if (statex.ullAvailPhys < 536870912 // 512 MB
-                    || statex.ullAvailVirtual < 536870912)
-            {
-                if (statex.ullAvailPhys < 268435456 // 256 MB
-                        || statex.ullAvailVirtual < 268435456)
-                {
-                    maxRequestSize = 2097152; // 2 MB
-                }
-                else
-                {
-                    maxRequestSize = 4194304; // 4 MB
-                }
-            }
-            else
-            {
-                maxRequestSize = 8388608; // 8 MB
-            }
-        }
+        limit = static_cast<m_off_t>(std::min(statex.ullAvailPhys, statex.ullAvailVirtual));
     }
     else
     {
         LOG_warn << "[Windows] Error getting RAM usage info";
     }
+#else
+#if defined(_SC_PHYS_PAGES) && defined(_SC_PAGESIZE)
+    long pages = sysconf(_SC_PHYS_PAGES);
+    long pageSize = sysconf(_SC_PAGESIZE);
+    if (pages > 0 && pageSize > 0)
+    {
+        limit = static_cast<m_off_t>(pages) * pageSize;
+    }
 #endif
+
+#if defined(__linux__)
+    // containers are usually limited by their cgroup (v2) rather than by the machine's memory
+    string cgroup;
+    std::ifstream cgroups("/proc/self/cgroup");
+    for (string line; std::getline(cgroups, line); )
+    {
+        if (line.compare(0, 3, "0::") == 0)
+        {
+            cgroup = line.substr(3);
+            break;
+        }
+    }
+
+    std::ifstream memoryMax("/sys/fs/cgroup" + (cgroup == "/" ? string() : cgroup) + "/memory.max");
+    string value;
+    if (memoryMax >> value && value != "max")
+    {
+        m_off_t cgroupLimit = atoll(value.c_str());
+        if (cgroupLimit > 0 && (!limit || cgroupLimit < limit))
+        {
+            LOG_debug << "Memory limited by cgroup to " << cgroupLimit << " bytes";
+            limit = cgroupLimit;
+        }
+    }
+#endif
+#endif
+
+    return limit;
+}
+
+void TransferMemoryBudget::addSlot()
+{
+    ++mSlots;
+}
+
+void TransferMemoryBudget::removeSlot()
+{
+    assert(mSlots);
+    if (!--mSlots)
+    {
+        // nothing is transferring, don't hold on to memory until the next transfer
+        freePool();
+    }
+}
+
+m_off_t TransferMemoryBudget::requestSize(m_off_t maxRequestSize, unsigned connections) const
+{
+    const m_off_t MB = 1024 * 1024;
+
+    // pooled buffers are allocated memory too
+    m_off_t available = std::max<m_off_t>(0, mBudget - mInUseBytes.load() - mPooledBytes.load());
+    m_off_t share = available / std::max(1u, mSlots.load()) / std::max(1u, connections);
+
+    if (share >= maxRequestSize)
+    {
+        return maxRequestSize;
+    }
+
+    // whole MBs, and never less than one (or than maxRequestSize if that's smaller)
+    return std::max(share / MB * MB, std::min(maxRequestSize, MB));
+}
+
+size_t TransferMemoryBudget::bufferCapacity(size_t len)
+{
+    if (len > MAX_POOLED_BUFFER_SIZE)
+    {
+        return len;
+    }
+
+    size_t capacity = MIN_BUFFER_SIZE;
+    while (capacity < len)
+    {
+        capacity <<= 1;
+    }
+    return capacity;
+}
+
+byte* TransferMemoryBudget::acquireBuffer(size_t len)
+{
+    size_t capacity = bufferCapacity(len);
+    mInUseBytes += static_cast<m_off_t>(capacity);
+
+    if (capacity <= MAX_POOLED_BUFFER_SIZE)
+    {
+        lock_guard<mutex> g(mMutex);
+        auto& pooled = mPool[capacity];
+        if (!pooled.empty())
+        {
+            byte* buffer = pooled.back();
+            pooled.pop_back();
+            mPooledBytes -= static_cast<m_off_t>(capacity);
+            return buffer;
+        }
+    }
+
+    return new byte[capacity];
+}
+
+void TransferMemoryBudget::releaseBuffer(byte* buffer, size_t len)
+{
+    if (!buffer)
+    {
+        return;
+    }
+
+    size_t capacity = bufferCapacity(len);
+    mInUseBytes -= static_cast<m_off_t>(capacity);
+
+    if (capacity <= MAX_POOLED_BUFFER_SIZE)
+    {
+        // keep buffers for reuse, up to a quarter of the budget or MAX_POOLED_BYTES
+        lock_guard<mutex> g(mMutex);
+        if (mPooledBytes + static_cast<m_off_t>(capacity) <= std::min(mBudget / 4, MAX_POOLED_BYTES))
+        {
+            mPool[capacity].push_back(buffer);
+            mPooledBytes += static_cast<m_off_t>(capacity);
+            return;
+        }
+    }
+
+    delete[] buffer;
+}
+
+m_off_t TransferMemoryBudget::buffersInUse() const
+{
+    return mInUseBytes.load();
+}
+
+m_off_t TransferMemoryBudget::buffersPooled() const
+{
+    return mPooledBytes.load();
+}
+
+const m_off_t ConnectionRequestSizer::MIN_REQUEST_SIZE = 256 * 1024;
+
+void ConnectionRequestSizer::requestFinished(m_off_t bytes, dstime elapsedDs, int roundtripMs)
+{
+    if (!mMeasuring)
+    {
+        return;
+    }
+    mMeasuring = false;
+
+    if (roundtripMs >= 0)
+    {
+        mRoundtripMs = mRoundtripMs < 0 ? roundtripMs : (mRoundtripMs * 7 + roundtripMs) / 8;
+    }
+
+    if (bytes <= 0)
+    {
+        return;
+    }
+
+    // the first round trip of the request carried no data. ds resolution, so at least 100 ms
+    m_off_t transferMs = std::max<m_off_t>(static_cast<m_off_t>(elapsedDs) * 100 - std::max(mRoundtripMs, 0), 100);
+    m_off_t bandwidth = bytes * 1000 / transferMs;
+    mBandwidth = mBandwidth ? (mBandwidth * 3 + bandwidth) / 4 : bandwidth;
+}
+
+m_off_t ConnectionRequestSizer::requestSize(m_off_t maxSize) const
+{
+    if (!mBandwidth)
+    {
+        return maxSize;
+    }
+
+    m_off_t bdp = mBandwidth * std::max(mRoundtripMs, 0) / 1000;
+    m_off_t size = std::max(bdp * ROUNDTRIPS_PER_REQUEST, mBandwidth * MIN_REQUEST_MS / 1000);
+    return std::max(std::min(size, maxSize), std::min(MIN_REQUEST_SIZE, maxSize));
 }
 
 bool TransferSlot::createconnectionsonce()
@@ -158,6 +372,7 @@ bool TransferSlot::createconnectionsonce()
         LOG_debug << "Populating transfer slot with " << connections << " connections, max request size of " << maxRequestSize << " bytes [transferbuf.isNewRaid() = " << transferbuf.isNewRaid() << "] [isDownload = " << (transfer->type == GET) << "]";
         reqs.resize(connections);
         mReqSpeeds.resize(connections);
+        mReqSizers.resize(connections);
         asyncIO = new AsyncIOContext*[connections]();
 
         if (transferbuf.isNewRaid())
@@ -322,6 +537,8 @@ TransferSlot::~TransferSlot()
     }
 
     delete[] asyncIO;
+
+    TransferMemoryBudget::global().removeSlot();
     LOG_verbose << "[TransferSlot::~TransferSlot] END [cloudRaid = " << (void*)(cloudRaid.get()) << "]";
 }
 
@@ -585,6 +802,17 @@ void TransferSlot::doio(MegaClient* client, TransferDbCommitter& committer)
         return transfer->failed(lasterror, committer);
     }
 
+    // follow the memory left by the other slots, so the total stays within the budget
+    m_off_t budgetedRequestSize = TransferMemoryBudget::global().requestSize(MAX_REQ_SIZE, static_cast<unsigned>(connections));
+    if (budgetedRequestSize != maxRequestSize)
+    {
+        LOG_debug << "Max request size changed from " << maxRequestSize << " to " << budgetedRequestSize << " bytes";
+        maxRequestSize = budgetedRequestSize;
+    }
+
+    // encryption/decryption started for the connections below is handed to the workers in one go
+    MegaClientAsyncQueue::Batch asyncJobs(client->mAsyncQueue);
+
     // main loop over connections
     for (int i = connections; i--; )
     {
@@ -647,6 +875,7 @@ void TransferSlot::doio(MegaClient* client, TransferDbCommitter& committer)
                 case REQ_SUCCESS:
                 {
                     mReqSpeeds[i].requestProgressed(reqs[i]->size);
+                    mReqSizers[i].requestFinished(reqs[i]->size, mReqSpeeds[i].requestElapsedDs(), reqs[i]->roundtripms);
 
                     if (client->orderdownloadedchunks && transfer->type == GET && !transferbuf.isRaid() && transfer->progresscompleted != static_cast<HttpReqDL*>(reqs[i].get())->dlpos)
                     {
@@ -685,6 +914,8 @@ void TransferSlot::doio(MegaClient* client, TransferDbCommitter& committer)
                             // and we have uploaded a small chunk and received the result before even finishing (re-)encrypting
                             // chunk A.  But we do need to include its chunkmacs in the mac-of-macs or we'll assign a wrong mac
                             // to the Node, and think the file is corrupt on download.
+                            // connections walked before this one may have batched their encryption: submit it, or we'd wait forever
+                            asyncJobs.flush();
                             for (int j = connections; j--; )
                             {
                                 if (j != i && reqs[j] &&
@@ -851,7 +1082,7 @@ void TransferSlot::doio(MegaClient* client, TransferDbCommitter& committer)
                                     auto filesize = transfer->size;
                                     req->status = REQ_DECRYPTING;
 
-                                    client->mAsyncQueue.push([req, i, outputPiece, transferkey, ctriv, filesize](SymmCipher& sc)
+                                    asyncJobs.push([req, i, outputPiece, transferkey, ctriv, filesize](SymmCipher& sc)
                                     {
                                         sc.setkey(transferkey.data());
                                         outputPiece->finalize(true, filesize, ctriv, &sc, nullptr);
@@ -997,7 +1228,7 @@ void TransferSlot::doio(MegaClient* client, TransferDbCommitter& committer)
                                 req->pos = pos;
                                 req->status = REQ_ENCRYPTING;
 
-                                client->mAsyncQueue.push([req, transferkey, ctriv, finaltempurl, pos, npos](SymmCipher& sc)
+                                asyncJobs.push([req, transferkey, ctriv, finaltempurl, pos, npos](SymmCipher& sc)
                                     {
                                         sc.setkey(transferkey.data());
                                         req->prepare(finaltempurl.c_str(), &sc, ctriv, pos, npos);
@@ -1087,7 +1318,7 @@ void TransferSlot::doio(MegaClient* client, TransferDbCommitter& committer)
             {
                 bool newInputBufferSupplied = false;
                 bool pauseConnectionInputForRaid = false;
-                std::pair<m_off_t, m_off_t> posrange = transferbuf.nextNPosForConnection(i, maxRequestSize, connections, newInputBufferSupplied, pauseConnectionInputForRaid, client->httpio->uploadSpeed);
+                std::pair<m_off_t, m_off_t> posrange = transferbuf.nextNPosForConnection(i, mReqSizers[i].requestSize(maxRequestSize), connections, newInputBufferSupplied, pauseConnectionInputForRaid, client->httpio->uploadSpeed);
 
                 // we might have a raid-reassembled block to write, or a previously loaded block, or a skip block to process.
                 bool newOutputBufferSupplied = false;
@@ -1243,6 +1474,7 @@ void TransferSlot::doio(MegaClient* client, TransferDbCommitter& committer)
                 if (reqs[i]->status == REQ_PREPARED)
                 {
                     mReqSpeeds[i].requestStarted();
+                    mReqSizers[i].requestStarted();
                     reqs[i]->minspeed = true;
 
                     if (transferbuf.isNewRaid())
@@ -1657,7 +1657,7 @@ string  Utils::toUpperUtf8(const string& text)
         d += nn;
         n -= nn;
 
-        c = utf8proc_toupper(c);
+        c = toUpper(c);
 
         char buff[8];
         auto charLen = utf8proc_encode_char(c, (utf8proc_uint8_t *)buff);
@@ -1685,7 +1685,7 @@ string  Utils::toLowerUtf8(const string& text)
         d += nn;
         n -= nn;
 
-        c = utf8proc_tolower(c);
+        c = toLower(c);
 
         char buff[8];
         auto charLen = utf8proc_encode_char(c, (utf8proc_uint8_t *)buff);
@@ -2641,7 +2641,7 @@ bool CompareLocalFileMetaMacWithNode(FileAccess* fa, Node* node)
     return CompareLocalFileMetaMacWithNodeKey(fa, node->nodekey(), node->type);
 }
 
-void MegaClientAsyncQueue::push(std::function<void(SymmCipher&)> f, bool discardable)
+void MegaClientAsyncQueue::push(Job f, bool discardable)
 {
     if (mThreads.empty())
     {
@@ -2649,27 +2649,97 @@ void MegaClientAsyncQueue::push(std::function<void(SymmCipher&)> f, bool discard
         {
             f(mZeroThreadsCipher);
         }
+        return;
     }
-    else
+
+    auto& queue = *mQueues[mNextQueue++ % mQueues.size()];
+    {
+        std::lock_guard<std::mutex> g(queue.mMutex);
+        queue.mEntries.emplace_back(discardable ? mDiscarded : nullptr, std::move(f));
+    }
+    mPending += 1;
+    wakeWorkers(1);
+}
+
+void MegaClientAsyncQueue::push(std::vector<Job>&& jobs, bool discardable)
+{
+    if (jobs.empty())
+    {
+        return;
+    }
+
+    if (mThreads.empty())
+    {
+        for (auto& f : jobs)
+        {
+            if (f)
+            {
+                f(mZeroThreadsCipher);
+            }
+        }
+        return;
+    }
+
+    // spread the jobs over the worker queues, locking each one once
+    size_t perQueue = (jobs.size() + mQueues.size() - 1) / mQueues.size();
+    for (size_t first = 0; first < jobs.size(); first += perQueue)
     {
+        auto& queue = *mQueues[mNextQueue++ % mQueues.size()];
+        std::lock_guard<std::mutex> g(queue.mMutex);
+        for (size_t i = first; i < jobs.size() && i < first + perQueue; ++i)
         {
-            std::lock_guard<std::mutex> g(mMutex);
-            mQueue.emplace_back(discardable, std::move(f));
+            queue.mEntries.emplace_back(discardable ? mDiscarded : nullptr, std::move(jobs[i]));
+        }
+    }
+    mPending += jobs.size();
+    wakeWorkers(jobs.size());
+}
+
+void MegaClientAsyncQueue::Batch::flush()
+{
+    mQueue.push(std::move(mDiscardable), true);
+    mQueue.push(std::move(mKept), false);
+    mDiscardable.clear();
+    mKept.clear();
+}
+
+void MegaClientAsyncQueue::wakeWorkers(size_t count)
+{
+    // a worker registers as sleeper before checking mPending, and we bump mPending before checking
+    // for sleepers, so either it sees the new jobs or we see it.  Taking the lock ensures it is waiting already.
+    if (mSleepers.load())
+    {
+        {
+            std::lock_guard<std::mutex> g(mSleepMutex);
+        }
+
+        if (count == 1)
+        {
+            mSleepCondition.notify_one();
+        }
+        else
+        {
+            mSleepCondition.notify_all();
         }
-        mConditionVariable.notify_one();
     }
 }
 
 MegaClientAsyncQueue::MegaClientAsyncQueue(Waiter& w, unsigned threadCount)
     : mWaiter(w)
+    , mDiscarded(std::make_shared<std::atomic<bool>>(false))
 {
-    for (int i = threadCount; i--; )
+    for (unsigned i = 0; i < threadCount; ++i)
+    {
+        mQueues.emplace_back(new WorkerQueue);
+    }
+
+    for (unsigned i = 0; i < threadCount; ++i)
     {
         try
         {
-            mThreads.emplace_back([this]()
+            mThreads.emplace_back([this, i]()
             {
-                asyncThreadLoop();
+                asyncThreadLoop(i);
             });
         }
         catch (std::system_error& e)
@@ -2678,14 +2748,18 @@ MegaClientAsyncQueue::MegaClientAsyncQueue(Waiter& w, unsigned threadCount)
             break;
         }
     }
+
     LOG_debug << "MegaClient Worker threads running: " << mThreads.size();
 }
 
 MegaClientAsyncQueue::~MegaClientAsyncQueue()
 {
     clearDiscardable();
-    push(nullptr, false);
-    mConditionVariable.notify_all();
+    {
+        std::lock_guard<std::mutex> g(mSleepMutex);
+        mExiting = true;
+    }
+    mSleepCondition.notify_all();
     LOG_warn << "~MegaClientAsyncQueue() joining threads";
     for (auto& t : mThreads)
     {
@@ -2696,27 +2770,63 @@ MegaClientAsyncQueue::~MegaClientAsyncQueue()
 
 void MegaClientAsyncQueue::clearDiscardable()
 {
-    std::lock_guard<std::mutex> g(mMutex);
-    auto newEnd = std::remove_if(mQueue.begin(), mQueue.end(), [](Entry& entry){ return entry.discardable; });
-    mQueue.erase(newEnd, mQueue.end());
+    // the workers skip those jobs when they get to them
+    mDiscarded->store(true);
+    mDiscarded = std::make_shared<std::atomic<bool>>(false);
 }
 
-void MegaClientAsyncQueue::asyncThreadLoop()
+bool MegaClientAsyncQueue::take(unsigned own, Entry& entry)
+{
+    // oldest from our own queue, otherwise the newest from another worker's
+    for (size_t k = 0; k < mQueues.size(); ++k)
+    {
+        auto& queue = *mQueues[(own + k) % mQueues.size()];
+        std::lock_guard<std::mutex> g(queue.mMutex);
+        if (!queue.mEntries.empty())
+        {
+            if (!k)
+            {
+                entry = std::move(queue.mEntries.front());
+                queue.mEntries.pop_front();
+            }
+            else
+            {
+                entry = std::move(queue.mEntries.back());
+                queue.mEntries.pop_back();
+            }
+            mPending -= 1;
+            return true;
+        }
+    }
+    return false;
+}
+
+void MegaClientAsyncQueue::asyncThreadLoop(unsigned own)
 {
     SymmCipher cipher;
+    Entry entry(nullptr, nullptr);
     for (;;)
     {
-        std::function<void(SymmCipher&)> f;
+        if (take(own, entry))
+        {
+            if (!entry.discarded || !entry.discarded->load())
+            {
+                entry.f(cipher);
+                mWaiter.notify();
+            }
+            entry.f = nullptr;
+            entry.discarded.reset();
+            continue;
+        }
+
+        std::unique_lock<std::mutex> g(mSleepMutex);
+        if (mExiting && !mPending.load())
         {
-            std::unique_lock<std::mutex> g(mMutex);
-            mConditionVariable.wait(g, [this]() { return !mQueue.empty(); });
-            assert(!mQueue.empty());
-            f = std::move(mQueue.front().f);
-            if (!f) return;   // nullptr is not popped, and causes all the threads to exit
-            mQueue.pop_front();
+            return;   // all queued jobs are done
         }
-        f(cipher);
-        mWaiter.notify();
+        ++mSleepers;
+        mSleepCondition.wait(g, [this]() { return mPending.load() || mExiting; });
+        --mSleepers;
     }
 }
 
@@ -912,6 +912,9 @@ bool WinFileSystemAccess::copylocal(const LocalPath& oldnamePath, const LocalPat
     assert(newnamePath.isAbsolute());
     bool r = !!CopyFileW(oldnamePath.localpath.c_str(), newnamePath.localpath.c_str(), FALSE);
 
+    // recent versions of CopyFileW clone the blocks by themselves on ReFS
+    last_copy_method = r ? COPY_METHOD_SYSTEM : COPY_METHOD_NONE;
+
     if (!r)
     {
         DWORD e = GetLastError();
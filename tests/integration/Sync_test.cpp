@@ -2106,13 +2106,9 @@ void StandardClient::copy(const CloudItem& source,
 
     TreeProcCopy proc;
 
-    // Figure out how many nodes we need to copy.
-    client.proctree(sourceNode, &proc, false, true);
-
-    // Allocate and populate nodes.
-    proc.allocnodes();
-
+    // Populate nodes.
     client.proctree(sourceNode, &proc, false, true);
+    proc.finish(&client);
 
     // We need the original node's handle if we're using versioning.
     std::shared_ptr<Node> victimNode;
@@ -10221,8 +10217,7 @@ struct TwoWaySyncSymmetryCase
 
         TreeProcCopy tc;
         changeClient().client.proctree(n1, &tc, false, true);
-        tc.allocnodes();
-        changeClient().client.proctree(n1, &tc, false, true);
+        tc.finish(&changeClient().client);
         tc.nn[0].parenthandle = UNDEF;
 
         SymmCipher key;
@@ -10254,8 +10249,7 @@ struct TwoWaySyncSymmetryCase
 
         TreeProcCopy tc;
         changeClient().client.proctree(n1, &tc, false, true);
-        tc.allocnodes();
-        changeClient().client.proctree(n1, &tc, false, true);
+        tc.finish(&changeClient().client);
         tc.nn[0].parenthandle = UNDEF;
 
         SymmCipher key;
@@ -60,4 +60,51 @@ TEST(AttrMap, unserialize_32bit)
 
     ASSERT_EQ(expMap.map, newMap.map);
 }
-#endif
\ No newline at end of file
+#endif
+
+TEST(AttrMap, compact_storage_keeps_map_semantics)
+{
+    const mega::nameid fav = mega::AttrMap::string2nameid("fav");
+
+    mega::attr_map attrs;
+    attrs['n'] = "name";
+    attrs[fav] = "1";
+    attrs['c'] = "fingerprint";
+    ASSERT_FALSE(attrs.emplace('n', "other").second);
+    ASSERT_TRUE(attrs.emplace('t', "12345").second);
+
+    // iterated in nameid order, as std::map
+    std::map<mega::nameid, std::string> expected{
+        {'n', "name"},
+        {fav, "1"},
+        {'c', "fingerprint"},
+        {'t', "12345"},
+    };
+    ASSERT_EQ(attrs.size(), expected.size());
+    auto expectedIt = expected.begin();
+    for (auto& attr : attrs)
+    {
+        ASSERT_EQ(attr.first, expectedIt->first);
+        ASSERT_EQ(attr.second, expectedIt->second);
+        ++expectedIt;
+    }
+    ASSERT_EQ(attrs, mega::attr_map(expected));
+
+    ASSERT_TRUE(attrs.contains('c'));
+    ASSERT_EQ(attrs.find('x'), attrs.end());
+    ASSERT_EQ(attrs.erase('c'), 1u);
+    ASSERT_EQ(attrs.erase('c'), 0u);
+    ASSERT_EQ(attrs.count('c'), 0u);
+
+    mega::AttrMap map;
+    map.map = attrs;
+    map.applyUpdates(mega::attr_map{{'n', ""}, {'t', "54321"}});
+    ASSERT_FALSE(map.map.contains('n'));
+    ASSERT_EQ(map.map['t'], "54321");
+
+    // short values live in the strings' inline buffers: a single allocation for the container
+    // (compared on a copy, as erasing leaves spare capacity behind)
+    mega::attr_map compacted = map.map;
+    ASSERT_EQ(compacted.heapSize(), compacted.size() * sizeof(mega::attr_map::value_type));
+    ASSERT_GE(map.map.heapSize(), compacted.heapSize());
+}
@@ -393,3 +393,50 @@ TEST(Crypto, SymmCipher_isZeroKey)
     key_test6.replace(SymmCipher::BLOCKSIZE, SymmCipher::BLOCKSIZE, "0123456789ABCDEF");
     ASSERT_EQ(SymmCipher::isZeroKey(reinterpret_cast<byte*>(key_test6.data()), FILENODEKEYLENGTH), true);
 }
+
+// SymmKey keeps only the raw key and reuses the expanded ciphers of the thread
+TEST(Crypto, SymmKey_cachedCiphers)
+{
+    byte keyBytes[SymmCipher::KEYLENGTH];
+    std::memset(keyBytes, 0x5a, sizeof keyBytes);
+
+    SymmKey key(keyBytes);
+    SymmCipher reference(keyBytes);
+
+    byte plain[2 * SymmCipher::BLOCKSIZE];
+    std::memset(plain, 0x17, sizeof plain);
+
+    byte expected[sizeof plain];
+    byte encrypted[sizeof plain];
+    reference.ecb_encrypt(plain, expected, sizeof plain);
+    key.ecb_encrypt(plain, encrypted, sizeof plain);
+    ASSERT_EQ(std::memcmp(expected, encrypted, sizeof plain), 0);
+
+    key.ecb_decrypt(encrypted, sizeof encrypted);
+    ASSERT_EQ(std::memcmp(plain, encrypted, sizeof plain), 0);
+
+    // the same key gets the same expanded cipher
+    SymmKey sameKey(keyBytes);
+    SymmCipher* cipher = key.cipher();
+    ASSERT_EQ(sameKey.cipher(), cipher);
+    ASSERT_EQ(std::memcmp(cipher->key, keyBytes, sizeof keyBytes), 0);
+
+    // other keys used meanwhile don't evict it while the cache has room...
+    for (unsigned i = 1; i < SymmKey::CIPHER_CACHE_SIZE; ++i)
+    {
+        byte otherBytes[SymmCipher::KEYLENGTH];
+        std::memset(otherBytes, static_cast<int>(i), sizeof otherBytes);
+        SymmKey(otherBytes).cipher();
+    }
+    ASSERT_EQ(key.cipher(), cipher);
+
+    // ...and it's re-expanded once evicted
+    for (unsigned i = 1; i <= SymmKey::CIPHER_CACHE_SIZE; ++i)
+    {
+        byte otherBytes[SymmCipher::KEYLENGTH];
+        std::memset(otherBytes, static_cast<int>(0x80 + i), sizeof otherBytes);
+        SymmKey(otherBytes).cipher();
+    }
+    key.ecb_encrypt(plain, encrypted, sizeof plain);
+    ASSERT_EQ(std::memcmp(expected, encrypted, sizeof plain), 0);
+}
@@ -17,12 +17,14 @@
  */
 
 #include <array>
+#include <cstring>
 #include <memory>
 #include <numeric>
 #include <string>
 
 #include <gtest/gtest.h>
 
+#include <mega.h>
 #include <mega/filefingerprint.h>
 
 #include "DefaultedFileAccess.h"
@@ -363,6 +365,85 @@ TEST(FileFingerprint, serializefingerprint_unserializefingerprint)
     ASSERT_EQ(ffp2.isvalid, ffp.isvalid);
 }
 
+class PrefetchingInputStreamAccess : public mega::InputStreamAccess
+{
+public:
+    explicit PrefetchingInputStreamAccess(const std::string& content)
+        : mContent(content)
+    {
+    }
+
+    m_off_t size() override
+    {
+        return static_cast<m_off_t>(mContent.size());
+    }
+
+    bool read(mega::byte* buffer, unsigned size) override
+    {
+        if (mOffset + size > mContent.size())
+        {
+            return false;
+        }
+
+        if (buffer)
+        {
+            std::memcpy(buffer, mContent.data() + mOffset, size);
+        }
+
+        mOffset += size;
+        return true;
+    }
+
+    void prefetch(const std::vector<m_off_t>& offsets, unsigned length) override
+    {
+        mPrefetched = offsets;
+        mPrefetchLength = length;
+    }
+
+    std::vector<m_off_t> mPrefetched;
+    unsigned mPrefetchLength = 0;
+
+private:
+    const std::string& mContent;
+    size_t mOffset = 0;
+};
+
+TEST(FileFingerprint, genfingerprint_InputStreamAccess_prefetchesSparseBlocks)
+{
+    std::string content(1000003, '\0');
+    for (size_t i = 0; i < content.size(); ++i)
+    {
+        content[i] = static_cast<char>(i * 7 + i / 251);
+    }
+
+    PrefetchingInputStreamAccess is{content};
+    mega::FileFingerprint ffp;
+    ASSERT_TRUE(ffp.genfingerprint(&is, 1));
+    ASSERT_TRUE(ffp.isvalid);
+
+    // all the sampled blocks are announced up front
+    ASSERT_EQ(is.mPrefetched.size(), 128u);
+    ASSERT_EQ(is.mPrefetchLength, 64u);
+    ASSERT_EQ(is.mPrefetched.front(), 0);
+    ASSERT_EQ(is.mPrefetched.back(), static_cast<m_off_t>(content.size() - 64));
+
+    // and the CRCs are those of the blocks at the historical offsets
+    for (unsigned i = 0; i < 4; ++i)
+    {
+        mega::HashCRC32 crc32;
+        for (unsigned j = 0; j < 32; ++j)
+        {
+            size_t offset = (content.size() - 64) * (i * 32 + j) / 127;
+            ASSERT_EQ(is.mPrefetched[i * 32 + j], static_cast<m_off_t>(offset));
+            crc32.add(reinterpret_cast<const mega::byte*>(content.data()) + offset, 64);
+        }
+
+        int32_t crcval;
+        crc32.get(reinterpret_cast<mega::byte*>(&crcval));
+        ASSERT_EQ(ffp.crc[i], static_cast<int32_t>(htonl(crcval)));
+    }
+}
+
 //TEST(FileFingerprint, genfingerprint_FileAccess_forTinyFile)
 //{
 //    mega::FileFingerprint ffp;
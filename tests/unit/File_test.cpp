@@ -91,3 +91,93 @@ TEST(File, serialize_unserialize)
 }
 
 
+
+TEST(File, putnodesOfUpload_coalescedPerTarget)
+{
+    mega::MegaApp app;
+    auto client = mt::makeClient(app);
+
+    mega::byte masterKey[mega::SymmCipher::KEYLENGTH];
+    std::fill(masterKey, masterKey + sizeof(masterKey), mega::byte('K'));
+    client->key.setkey(masterKey);
+
+    auto newUploadNode = [](const char* attrs)
+    {
+        mega::NewNode newnode;
+        newnode.source = mega::NEW_UPLOAD;
+        newnode.type = mega::FILENODE;
+        newnode.nodekey.assign(mega::FILENODEKEYLENGTH, 'X');
+        newnode.attrstring.reset(new std::string(attrs));
+        return newnode;
+    };
+
+    mega::NodeHandle folder1 = mega::NodeHandle().set6byte(42);
+    mega::NodeHandle folder2 = mega::NodeHandle().set6byte(43);
+
+    client->putnodesOfUpload(folder1, mega::NoVersioning, newUploadNode("a1"), 1, mega::PUTNODES_APP, false, nullptr);
+    client->putnodesOfUpload(folder1, mega::NoVersioning, newUploadNode("a2"), 2, mega::PUTNODES_APP, false, nullptr);
+    client->putnodesOfUpload(folder2, mega::NoVersioning, newUploadNode("a3"), 3, mega::PUTNODES_APP, false, nullptr);
+    client->putnodesOfUpload(folder1, mega::NoVersioning, newUploadNode("a4"), 4, mega::PUTNODES_APP, false, nullptr);
+
+    // nothing is sent until the coalescing window expires
+    ASSERT_FALSE(client->reqs.readyToSend());
+    ASSERT_EQ(client->mUploadPutnodesBatches.size(), 2u);
+
+    client->flushUploadPutnodes(true);
+    ASSERT_TRUE(client->mUploadPutnodesBatches.empty());
+    ASSERT_EQ(client->nextUploadPutnodesFlushDs, 0u);
+    ASSERT_TRUE(client->reqs.readyToSend());
+
+    bool includesFetchingNodes = false;
+    bool v3 = false;
+    std::string idempotenceId;
+    std::string request = client->reqs.serverrequest(includesFetchingNodes, v3, client.get(), idempotenceId);
+
+    // one putnodes per target folder (in handle order), with all the new nodes for that folder
+    auto countOccurrences = [](const std::string& s, const char* what)
+    {
+        size_t count = 0;
+        for (size_t pos = s.find(what); pos != std::string::npos; pos = s.find(what, pos + 1))
+        {
+            ++count;
+        }
+        return count;
+    };
+
+    ASSERT_EQ(countOccurrences(request, "\"a\":\"p\""), 2u);
+    size_t secondPutnodes = request.rfind("\"a\":\"p\"");
+    ASSERT_EQ(countOccurrences(request.substr(0, secondPutnodes), "\"k\":"), 3u);
+    ASSERT_EQ(countOccurrences(request.substr(secondPutnodes), "\"k\":"), 1u);
+}
+
+TEST(File, putnodesOfUpload_failedWhenDiscarded)
+{
+    mega::MegaApp app;
+    auto client = mt::makeClient(app);
+
+    std::vector<std::pair<int, mega::error>> results;
+    auto completion = [&results](const mega::Error& e, mega::targettype_t, std::vector<mega::NewNode>& nn, bool, int tag)
+    {
+        EXPECT_EQ(nn.size(), 1u);
+        results.emplace_back(tag, mega::error(e));
+    };
+
+    mega::NodeHandle folder = mega::NodeHandle().set6byte(42);
+    for (int tag = 1; tag <= 3; ++tag)
+    {
+        mega::NewNode newnode;
+        newnode.source = mega::NEW_UPLOAD;
+        newnode.type = mega::FILENODE;
+        client->putnodesOfUpload(folder, mega::NoVersioning, std::move(newnode), tag, mega::PUTNODES_APP, false, completion);
+    }
+
+    // e.g. on logout, every upload waiting for its putnodes still finishes
+    client->failUploadPutnodes(mega::API_EINCOMPLETE);
+    ASSERT_TRUE(client->mUploadPutnodesBatches.empty());
+    ASSERT_EQ(results.size(), 3u);
+    for (int i = 0; i < 3; ++i)
+    {
+        ASSERT_EQ(results[size_t(i)].first, i + 1);
+        ASSERT_EQ(results[size_t(i)].second, mega::API_EINCOMPLETE);
+    }
+}
@@ -0,0 +1,142 @@
+/**
+ * @file HttpReq_test.cpp
+ * @brief Unitary test for the handling of HTTP response headers
+ *
+ * (c) 2013-2024 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of the MEGA SDK - Client Access Engine.
+ *
+ * Applications using the MEGA API must present a valid application key
+ * and comply with the rules set forth in the Terms of Service.
+ *
+ * The MEGA SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#include <gtest/gtest.h>
+
+#include "mega.h"
+
+#if !defined(_WIN32) || defined(USE_CURL)
+
+namespace mega {
+
+class DebugTestHook
+{
+public:
+    // feeds one response header line to the request, as cURL does
+    static void header(HttpReq& req, std::string line)
+    {
+        line += "\r\n";
+        CurlHttpIO::check_header(&line[0], 1, line.size(), &req);
+    }
+};
+
+} // mega
+
+namespace {
+
+using mega::DebugTestHook;
+
+// a request that was just posted
+void posted(mega::HttpReq& req)
+{
+    req.contentlength = -1;
+}
+
+} // anonymous
+
+TEST(HttpReq, contentLengthOfPlainResponse)
+{
+    mega::HttpReq req;
+    posted(req);
+
+    DebugTestHook::header(req, "HTTP/1.1 200 OK");
+    DebugTestHook::header(req, "Content-Length: 1234");
+    DebugTestHook::header(req, "Content-Encoding: identity");
+
+    ASSERT_EQ(req.contentlength, 1234);
+    ASSERT_FALSE(req.mContentEncoded);
+}
+
+TEST(HttpReq, encodedSizeIgnoredWhenContentEncodingFollows)
+{
+    mega::HttpReq req;
+    posted(req);
+
+    DebugTestHook::header(req, "HTTP/1.1 200 OK");
+    DebugTestHook::header(req, "Content-Length: 100");
+    DebugTestHook::header(req, "Content-Encoding: gzip");
+
+    // the decoded size is unknown
+    ASSERT_EQ(req.contentlength, -1);
+    ASSERT_TRUE(req.mContentEncoded);
+}
+
+TEST(HttpReq, encodedSizeIgnoredWhenContentEncodingPrecedes)
+{
+    mega::HttpReq req;
+    posted(req);
+
+    DebugTestHook::header(req, "HTTP/1.1 200 OK");
+    DebugTestHook::header(req, "Content-Encoding: br");
+    DebugTestHook::header(req, "Content-Length: 100");
+
+    ASSERT_EQ(req.contentlength, -1);
+    ASSERT_TRUE(req.mContentEncoded);
+}
+
+TEST(HttpReq, originalContentLengthIsTheDecodedSize)
+{
+    for (bool originalFirst : {true, false})
+    {
+        mega::HttpReq req;
+        posted(req);
+
+        DebugTestHook::header(req, "HTTP/1.1 200 OK");
+        if (originalFirst)
+        {
+            DebugTestHook::header(req, "Original-Content-Length: 5000");
+        }
+        DebugTestHook::header(req, "Content-Length: 100");
+        DebugTestHook::header(req, "Content-Encoding: gzip");
+        if (!originalFirst)
+        {
+            DebugTestHook::header(req, "Original-Content-Length: 5000");
+        }
+
+        ASSERT_EQ(req.contentlength, 5000) << "Original-Content-Length first: " << originalFirst;
+        ASSERT_TRUE(req.mContentEncoded);
+    }
+}
+
+TEST(HttpReq, secondResponseThroughProxyResetsHeaders)
+{
+    mega::HttpReq req;
+    posted(req);
+
+    // the proxy's authentication challenge
+    DebugTestHook::header(req, "HTTP/1.1 407 Proxy Authentication Required");
+    DebugTestHook::header(req, "Content-Length: 20");
+    DebugTestHook::header(req, "Content-Encoding: gzip");
+    DebugTestHook::header(req, "Original-Content-Length: 300");
+    ASSERT_EQ(req.contentlength, 300);
+
+    // nothing of the first response applies to the second one
+    DebugTestHook::header(req, "HTTP/1.1 200 OK");
+    ASSERT_EQ(req.contentlength, -1);
+    ASSERT_FALSE(req.mContentEncoded);
+    ASSERT_FALSE(req.mOriginalContentLength);
+
+    DebugTestHook::header(req, "Content-Length: 42");
+    ASSERT_EQ(req.contentlength, 42);
+    ASSERT_FALSE(req.mContentEncoded);
+}
+
+#endif
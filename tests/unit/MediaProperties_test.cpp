@@ -17,11 +17,14 @@
  */
 
 #include <array>
+#include <thread>
 
 #include <gtest/gtest.h>
 
 #include <mega/mediafileattribute.h>
 
+#include "megafs.h"
+
 namespace
 {
 
@@ -87,3 +90,109 @@ TEST(MediaProperties, unserialize_32bit)
     const mega::MediaProperties newMp{d};
     checkMediaProperties(mp, newMp);
 }
+
+#ifdef USE_MEDIAINFO
+
+namespace
+{
+
+// a 2 second, 8 kHz, 8 bit mono PCM wave file
+std::string makeWave()
+{
+    const uint32_t sampleRate = 8000;
+    const uint32_t dataSize = 2 * sampleRate;
+
+    std::string d;
+    auto put32 = [&d](uint32_t v) { for (int i = 0; i < 4; ++i) d.push_back(char(v >> (8 * i))); };
+    auto put16 = [&d](uint16_t v) { d.push_back(char(v)); d.push_back(char(v >> 8)); };
+
+    d += "RIFF";
+    put32(36 + dataSize);
+    d += "WAVEfmt ";
+    put32(16);
+    put16(1);           // PCM
+    put16(1);           // mono
+    put32(sampleRate);
+    put32(sampleRate);  // byte rate
+    put16(1);           // block align
+    put16(8);           // bits per sample
+    d += "data";
+    put32(dataSize);
+    for (uint32_t i = 0; i < dataSize; ++i)
+    {
+        d.push_back(char(128 + ((i / 10) % 2 ? 40 : -40)));
+    }
+    return d;
+}
+
+}
+
+TEST(MediaProperties, extraction_workerAndClientThreadAgree)
+{
+    mega::FSACCESS_CLASS fsAccess;
+
+    mega::LocalPath path;
+    ASSERT_TRUE(fsAccess.cwd(path));
+    path.appendWithSeparator(mega::LocalPath::fromRelativePath("media_extraction.wav"), false);
+
+    const auto wave = makeWave();
+    {
+        auto fileAccess = fsAccess.newfileaccess(false);
+        ASSERT_TRUE(fileAccess->fopen(path, false, true, mega::FSLogging::logOnError));
+        ASSERT_TRUE(fileAccess->fwrite(reinterpret_cast<const mega::byte*>(wave.data()), static_cast<unsigned>(wave.size()), 0));
+    }
+
+    // extracted on a worker thread that finished before the result was needed
+    mega::MediaPropertiesExtraction onWorker(path);
+    std::thread worker([&onWorker]() { onWorker.run(); });
+    worker.join();
+    mega::MediaProperties fromWorker;
+    ASSERT_TRUE(onWorker.result(fromWorker));
+
+    // never picked up by a worker: no result, and the caller extracts on its own
+    mega::MediaPropertiesExtraction notStarted(path);
+    mega::MediaProperties fromClient;
+    EXPECT_FALSE(notStarted.result(fromClient));
+    notStarted.run();  // abandoned, does nothing
+    EXPECT_FALSE(notStarted.result(fromClient));
+    fromClient.extractMediaPropertyFileAttributes(path, &fsAccess);
+
+    fsAccess.unlinklocal(path);
+
+    EXPECT_EQ(fromWorker.playtime, 2u);
+    EXPECT_EQ(fromWorker.width, 0u);
+    EXPECT_EQ(fromWorker.audiocodecFormat, "PCM");
+    EXPECT_TRUE(fromWorker == fromClient);
+}
+
+TEST(MediaProperties, cacheByFingerprint)
+{
+    mega::MediaFileInfo info;
+
+    mega::FileFingerprint fp;
+    fp.size = 1000;
+    fp.mtime = 1;
+    fp.isvalid = true;
+
+    mega::MediaProperties vp;
+    vp.playtime = 7;
+
+    mega::MediaProperties cached;
+    EXPECT_FALSE(info.getCachedProperties(fp, cached));
+
+    info.cacheProperties(fp, vp);
+    ASSERT_TRUE(info.getCachedProperties(fp, cached));
+    EXPECT_EQ(cached.playtime, 7u);
+
+    // different contents
+    auto other = fp;
+    other.mtime = 2;
+    EXPECT_FALSE(info.getCachedProperties(other, cached));
+
+    // without a valid fingerprint nothing can be matched
+    other.isvalid = false;
+    info.cacheProperties(other, vp);
+    EXPECT_FALSE(info.getCachedProperties(other, cached));
+}
+
+#endif // USE_MEDIAINFO
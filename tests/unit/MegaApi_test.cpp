@@ -284,3 +284,207 @@ TEST(MegaApi, MegaApiImpl_calcRecommendedProLevel)
     ASSERT_EQ(test(MegaAccountDetails::ACCOUNT_TYPE_BUSINESS, 20000), MegaAccountDetails::ACCOUNT_TYPE_BUSINESS);
     ASSERT_EQ(test(MegaAccountDetails::ACCOUNT_TYPE_PRO_FLEXI, 20000), MegaAccountDetails::ACCOUNT_TYPE_PRO_FLEXI);
 }
+
+#ifdef HAVE_LIBUV
+TEST(MegaApi, StreamingBuffer_nextBuffers_wrapsAround)
+{
+    StreamingBuffer buffer;
+    buffer.init(100);
+    buffer.setMaxOutputSize(1000);
+
+    string data(130, 'x');
+    for (size_t i = 0; i < data.size(); ++i)
+    {
+        data[i] = static_cast<char>('a' + i % 26);
+    }
+
+    // consume 80 bytes so that the next append wraps around
+    ASSERT_EQ(buffer.append(data.data(), 80), 80u);
+    ASSERT_EQ(buffer.nextBuffer().len, 80u);
+    buffer.freeData(80);
+
+    ASSERT_EQ(buffer.append(data.data() + 80, 50), 50u);
+
+    uv_buf_t buffers[2];
+    ASSERT_EQ(buffer.nextBuffers(buffers), 2u);
+    ASSERT_EQ(buffers[0].len, 20u);
+    ASSERT_EQ(buffers[1].len, 30u);
+    ASSERT_EQ(string(buffers[0].base, buffers[0].len) + string(buffers[1].base, buffers[1].len),
+              data.substr(80));
+    ASSERT_EQ(buffer.availableData(), 0u);
+    buffer.freeData(50);
+
+    // the output size limit spans both pieces
+    ASSERT_EQ(buffer.append(data.data(), 60), 60u);
+    buffer.setMaxOutputSize(10);
+    ASSERT_EQ(buffer.nextBuffers(buffers), 1u);
+    ASSERT_EQ(buffers[0].len, 10u);
+    ASSERT_EQ(buffer.availableData(), 50u);
+
+    ASSERT_EQ(buffer.nextBuffers(buffers), 1u);
+    ASSERT_EQ(string(buffers[0].base, buffers[0].len), data.substr(10, 10));
+
+    // nothing left to send
+    StreamingBuffer empty;
+    empty.init(10);
+    ASSERT_EQ(empty.nextBuffers(buffers), 0u);
+}
+#endif
+
+#ifdef HAVE_LIBUV
+TEST(MegaListingCache, KeepsRecentListingsUntilInvalidated)
+{
+    MegaListingCache cache;
+    string listing;
+
+    ASSERT_FALSE(cache.get(1, "html", listing));
+    auto generation = cache.generation();
+    cache.put(1, "html", "one", generation);
+    cache.put(1, "LIST", "one as ftp", generation);
+    cache.put(2, "html", "two", generation);
+
+    ASSERT_TRUE(cache.get(1, "html", listing));
+    ASSERT_EQ(listing, "one");
+    ASSERT_TRUE(cache.get(1, "LIST", listing));
+    ASSERT_EQ(listing, "one as ftp");
+
+    // a change in a folder drops all its renderings
+    cache.invalidate(1);
+    ASSERT_FALSE(cache.get(1, "html", listing));
+    ASSERT_FALSE(cache.get(1, "LIST", listing));
+    ASSERT_TRUE(cache.get(2, "html", listing));
+
+    // least recently used folders go first
+    for (handle h = 3; h < 3 + MegaListingCache::MAX_ENTRIES; ++h)
+    {
+        ASSERT_TRUE(cache.get(2, "html", listing));
+        cache.put(h, "html", "more", cache.generation());
+    }
+    ASSERT_EQ(cache.size(), MegaListingCache::MAX_ENTRIES);
+    ASSERT_TRUE(cache.get(2, "html", listing));
+    ASSERT_FALSE(cache.get(3, "html", listing));
+
+    // huge listings aren't kept
+    cache.put(100, "html", string(MegaListingCache::MAX_BYTES / 2, 'x'), cache.generation());
+    ASSERT_FALSE(cache.get(100, "html", listing));
+
+    // a listing rendered before an invalidation is refused
+    generation = cache.generation();
+    cache.invalidate(200);
+    cache.put(1, "html", "stale", generation);
+    ASSERT_FALSE(cache.get(1, "html", listing));
+
+    generation = cache.generation();
+    cache.invalidate(nullptr);
+    ASSERT_EQ(cache.size(), 0u);
+    cache.put(1, "html", "stale", generation);
+    ASSERT_EQ(cache.size(), 0u);
+}
+#endif
+
+#if defined(HAVE_LIBUV) && defined(__linux__)
+TEST(MegaTCPSpillStore, ServesOnlyRangesAlreadyStreamed)
+{
+    MegaTCPSpillStore store("./");
+    string data(300, 0);
+    for (size_t i = 0; i < data.size(); ++i) data[i] = char(i);
+    std::shared_ptr<void> pin;
+
+    // nodes requested once aren't kept
+    ASSERT_EQ(store.open(1, 0, 1, pin), -1);
+    store.write(1, 0, data.data(), 100);
+    store.sync();
+    ASSERT_EQ(store.bytes(), 0);
+
+    // from their second request on, they are
+    ASSERT_EQ(store.open(1, 0, 1, pin), -1);
+    store.write(1, 0, data.data(), 100);
+    store.write(1, 200, data.data() + 200, 100);
+    store.sync();
+    ASSERT_EQ(store.bytes(), 200);
+
+    // a gap in the middle
+    ASSERT_EQ(store.open(1, 50, 200, pin), -1);
+
+    int fd = store.open(1, 10, 90, pin);
+    ASSERT_GE(fd, 0);
+    ASSERT_TRUE(pin);
+    char c = 0;
+    ASSERT_EQ(pread(fd, &c, 1, 42), 1);
+    ASSERT_EQ(c, char(42));
+    close(fd);
+    pin.reset();
+
+    // overlapping data is only counted once
+    store.write(1, 50, data.data() + 50, 200);
+    store.sync();
+    ASSERT_EQ(store.bytes(), 300);
+    fd = store.open(1, 0, 300, pin);
+    ASSERT_GE(fd, 0);
+    ASSERT_EQ(pread(fd, &c, 1, 150), 1);
+    ASSERT_EQ(c, char(150));
+
+    // the least recently used nodes are dropped first, unless they are being read
+    for (handle h = 2; h < 2 + MegaTCPSpillStore::MAX_NODES; ++h)
+    {
+        std::shared_ptr<void> none;
+        store.open(h, 0, 1, none);
+        store.open(h, 0, 1, none);
+        store.write(h, 0, data.data(), 10);
+    }
+    store.sync();
+    ASSERT_EQ(store.bytes(), m_off_t(300 + 10 * (MegaTCPSpillStore::MAX_NODES - 1)));
+
+    std::shared_ptr<void> other;
+    ASSERT_EQ(store.open(2, 0, 1, other), -1);
+    int fd2 = store.open(1, 0, 300, other);
+    ASSERT_GE(fd2, 0);
+    ASSERT_EQ(pread(fd2, &c, 1, 250), 1);
+    ASSERT_EQ(c, char(250));
+    close(fd2);
+    close(fd);
+}
+
+TEST(MegaTCPSpillStore, WaitsForRangesBeingFetched)
+{
+    MegaTCPSpillStore store("./");
+    string data(300, 0);
+    for (size_t i = 0; i < data.size(); ++i) data[i] = char(i);
+    std::shared_ptr<void> pin;
+    int first = 0, second = 0;
+
+    // a request streaming [0, 300)
+    ASSERT_EQ(store.open(1, 0, 300, pin), -1);
+    store.write(1, 0, data.data(), 100);
+    store.fetching(&first, 1, 100, 300);
+
+    // another one for data it hasn't got to yet follows it
+    int fd = store.open(1, 150, 150, pin);
+    ASSERT_GE(fd, 0);
+    ASSERT_EQ(store.readable(1, 150, 300), 0);
+
+    // but not for data it already passed, or won't get to
+    std::shared_ptr<void> other;
+    ASSERT_EQ(store.open(1, 50, 10, other), -1);
+    ASSERT_EQ(store.open(1, 150, 200, other), -1);
+
+    store.write(1, 100, data.data() + 100, 100);
+    store.fetching(&first, 1, 200, 300);
+    store.sync();
+    ASSERT_EQ(store.readable(1, 150, 300), 50);
+    ASSERT_EQ(store.readable(1, 200, 300), 0);
+    char c = 0;
+    ASSERT_EQ(pread(fd, &c, 1, 170), 1);
+    ASSERT_EQ(c, char(170));
+
+    // the rest won't come once that request is gone, unless another one is fetching it
+    store.fetchEnded(&first);
+    ASSERT_EQ(store.readable(1, 200, 300), -1);
+    store.fetching(&second, 1, 180, 400);
+    ASSERT_EQ(store.readable(1, 200, 300), 0);
+    store.write(1, 200, data.data() + 200, 100);
+    store.sync();
+    ASSERT_EQ(store.readable(1, 200, 300), 100);
+    close(fd);
+}
+#endif
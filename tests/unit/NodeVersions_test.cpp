@@ -0,0 +1,211 @@
+/**
+ * @file NodeVersions_test.cpp
+ * @brief Unitary test for the versioned views of the node tree
+ *
+ * (c) 2013-2024 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of the MEGA SDK - Client Access Engine.
+ *
+ * Applications using the MEGA API must present a valid application key
+ * and comply with the rules set forth in the Terms of Service.
+ *
+ * The MEGA SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#include <atomic>
+#include <thread>
+
+#include <gtest/gtest.h>
+
+#include <mega/megaclient.h>
+#include <mega/megaapp.h>
+#include <mega/nodemanager.h>
+
+#include "utils.h"
+
+namespace
+{
+
+struct NodeChain
+{
+    std::shared_ptr<mega::Node> root;
+    std::shared_ptr<mega::Node> folder;
+    std::shared_ptr<mega::Node> subfolder;
+
+    explicit NodeChain(mega::MegaClient& client)
+    {
+        root.reset(&mt::makeNode(client, mega::ROOTNODE, mega::NodeHandle().set6byte(1)));
+        folder.reset(&mt::makeNode(client, mega::FOLDERNODE, mega::NodeHandle().set6byte(2), root.get()));
+        subfolder.reset(&mt::makeNode(client, mega::FOLDERNODE, mega::NodeHandle().set6byte(3), folder.get()));
+
+        folder->parent = root;
+        subfolder->parent = folder;
+        folder->attrs.map['n'] = "folder";
+        subfolder->attrs.map['n'] = "subfolder";
+    }
+
+    std::vector<mega::NodeVersions::Version> versions() const
+    {
+        return {mega::NodeVersions::Version(*subfolder),
+                mega::NodeVersions::Version(*folder),
+                mega::NodeVersions::Version(*root)};
+    }
+};
+
+}
+
+TEST(NodeVersions, snapshotsAreImmutable)
+{
+    mega::MegaApp app;
+    auto client = mt::makeClient(app);
+    NodeChain chain(*client);
+
+    mega::NodeVersions versions;
+    ASSERT_TRUE(versions.seed(chain.versions(), versions.writeEpoch()));
+    ASSERT_EQ(versions.size(), 3u);
+
+    auto before = versions.pin();
+    std::string path;
+    unsigned depth = 0;
+    mega::nodetype_t firstAncestorType = mega::TYPE_UNKNOWN;
+    ASSERT_TRUE(before->displayPath(chain.subfolder->nodeHandle(), path, &depth, &firstAncestorType));
+    ASSERT_EQ(path, "/folder/subfolder");
+    ASSERT_EQ(depth, 2u);
+    ASSERT_EQ(firstAncestorType, mega::ROOTNODE);
+
+    // a change is not visible until the batch is published
+    versions.invalidate();
+    uint64_t batchEpoch = versions.writeEpoch();
+    chain.folder->attrs.map['n'] = "renamed";
+    versions.stage(*chain.folder);
+    ASSERT_EQ(versions.pin(), before);
+
+    versions.publish(batchEpoch);
+    auto after = versions.pin();
+    ASSERT_GT(after->epoch(), before->epoch());
+    ASSERT_TRUE(after->displayPath(chain.subfolder->nodeHandle(), path));
+    ASSERT_EQ(path, "/renamed/subfolder");
+
+    // pinned snapshots keep their version
+    ASSERT_TRUE(before->displayPath(chain.subfolder->nodeHandle(), path));
+    ASSERT_EQ(path, "/folder/subfolder");
+
+    // removals
+    versions.invalidate();
+    batchEpoch = versions.writeEpoch();
+    versions.stageRemoval(chain.folder->nodeHandle());
+    versions.publish(batchEpoch);
+    ASSERT_EQ(versions.pin()->lookup(chain.folder->nodeHandle()), nullptr);
+    ASSERT_FALSE(versions.pin()->displayPath(chain.subfolder->nodeHandle(), path));
+    ASSERT_NE(before->lookup(chain.folder->nodeHandle()), nullptr);
+}
+
+TEST(NodeVersions, staleSeedsAreDiscarded)
+{
+    mega::MegaApp app;
+    auto client = mt::makeClient(app);
+    NodeChain chain(*client);
+
+    mega::NodeVersions versions;
+
+    // the reader started before a change
+    uint64_t readEpoch = versions.writeEpoch();
+    versions.invalidate();
+    ASSERT_FALSE(versions.seed(chain.versions(), readEpoch));
+
+    // the change was not published yet
+    ASSERT_FALSE(versions.seed(chain.versions(), versions.writeEpoch()));
+
+    versions.publish(versions.writeEpoch());
+    ASSERT_TRUE(versions.seed(chain.versions(), versions.writeEpoch()));
+
+    // untracked nodes are not staged by writers
+    std::shared_ptr<mega::Node> other(&mt::makeNode(*client, mega::FOLDERNODE, mega::NodeHandle().set6byte(4), chain.root.get()));
+    other->parent = chain.root;
+    versions.invalidate();
+    versions.stage(*other);
+    versions.publish(versions.writeEpoch());
+    ASSERT_EQ(versions.pin()->lookup(other->nodeHandle()), nullptr);
+
+    versions.clear();
+    ASSERT_EQ(versions.size(), 0u);
+}
+
+TEST(NodeVersions, concurrentReadersSeeWholeBatches)
+{
+    mega::MegaApp app;
+    auto client = mt::makeClient(app);
+    NodeChain chain(*client);
+
+    mega::NodeVersions versions;
+    chain.folder->attrs.map['n'] = "0";
+    chain.subfolder->attrs.map['n'] = "0";
+    ASSERT_TRUE(versions.seed(chain.versions(), versions.writeEpoch()));
+
+    std::atomic<bool> done{false};
+    std::atomic<unsigned> inconsistent{0};
+    std::atomic<uint64_t> reads{0};
+
+    auto reader = [&]()
+    {
+        uint64_t lastEpoch = 0;
+        std::string path;
+        do
+        {
+            auto snapshot = versions.pin();
+            if (snapshot->epoch() < lastEpoch
+                || !snapshot->displayPath(chain.subfolder->nodeHandle(), path))
+            {
+                ++inconsistent;
+                continue;
+            }
+            lastEpoch = snapshot->epoch();
+
+            // both nodes are renamed in the same batch: "/<n>/<n>"
+            auto separator = path.find('/', 1);
+            if (separator == std::string::npos || path.substr(1, separator - 1) != path.substr(separator + 1))
+            {
+                ++inconsistent;
+            }
+            ++reads;
+        } while (!done);
+    };
+
+    std::vector<std::thread> readers;
+    for (int i = 0; i < 4; ++i)
+    {
+        readers.emplace_back(reader);
+    }
+
+    const int batches = 10000;
+    for (int i = 1; i <= batches; ++i)
+    {
+        versions.invalidate();
+        uint64_t batchEpoch = versions.writeEpoch();
+        chain.folder->attrs.map['n'] = std::to_string(i);
+        chain.subfolder->attrs.map['n'] = std::to_string(i);
+        versions.stage(*chain.folder);
+        versions.stage(*chain.subfolder);
+        versions.publish(batchEpoch);
+    }
+
+    done = true;
+    for (auto& t : readers)
+    {
+        t.join();
+    }
+
+    ASSERT_EQ(inconsistent.load(), 0u);
+    ASSERT_GT(reads.load(), 0u);
+
+    std::string path;
+    ASSERT_TRUE(versions.pin()->displayPath(chain.subfolder->nodeHandle(), path));
+    ASSERT_EQ(path, "/" + std::to_string(batches) + "/" + std::to_string(batches));
+}
@@ -1139,5 +1139,227 @@ TEST_F(SyncConfigStoreTest, Write)
 
 } // SyncConfigTests
 
+namespace
+{
+
+mega::SyncStallEntry stallEntry(mega::SyncWaitReason reason, const std::string& cloudPath)
+{
+    return mega::SyncStallEntry(reason, true, true, {mega::NodeHandle(), cloudPath}, {}, {}, {});
+}
+
+// some cloud and local stalls, n of each
+mega::SyncStallInfo syntheticStalls(size_t n, mega::SyncWaitReason reason = mega::SyncWaitReason::FileIssue)
+{
+    mega::SyncStallInfo stalls;
+    for (size_t i = 0; i < n; ++i)
+    {
+        auto name = "stalled" + std::to_string(i);
+        stalls.cloud.emplace("/cloud/" + name, stallEntry(reason, "/cloud/" + name));
+        stalls.local.emplace(mega::LocalPath::fromRelativePath(name), stallEntry(reason, "/cloud/" + name));
+    }
+    return stalls;
+}
+
+} // anonymous
+
+TEST(SyncStallLog, ReportsOnlyChangesSinceVersion)
+{
+    using namespace mega;
+
+    SyncStallLog log;
+    SyncStallChanges changes;
+
+    log.update(syntheticStalls(1000));
+    ASSERT_EQ(log.size(), 2000u);
+
+    // everything, a page at a time
+    size_t total = 0;
+    uint64_t version = 0;
+    do
+    {
+        log.changesSince(version, 300, changes);
+        ASSERT_FALSE(changes.mReset);
+        ASSERT_LE(changes.mChanges.size(), 300u);
+        total += changes.mChanges.size();
+        version = changes.mVersion;
+    } while (changes.mMore);
+    ASSERT_EQ(total, 2000u);
+    ASSERT_EQ(version, log.version());
+
+    // the same stalls again change nothing
+    log.update(syntheticStalls(1000));
+    log.changesSince(version, 300, changes);
+    ASSERT_TRUE(changes.mChanges.empty());
+    ASSERT_EQ(changes.mVersion, version);
+
+    // one stall changes its reason, and the last ones come right
+    auto stalls = syntheticStalls(990);
+    stalls.cloud.at("/cloud/stalled5").reason = SyncWaitReason::MoveOrRenameCannotOccur;
+    log.update(stalls);
+    ASSERT_EQ(log.size(), 1980u);
+
+    log.changesSince(version, 300, changes);
+    ASSERT_FALSE(changes.mMore);
+    ASSERT_EQ(changes.mChanges.size(), 21u);
+
+    size_t removed = 0;
+    for (auto& c : changes.mChanges)
+    {
+        if (c.removed)
+        {
+            ++removed;
+        }
+        else
+        {
+            ASSERT_TRUE(c.cloud);
+            ASSERT_EQ(c.cloudKey, "/cloud/stalled5");
+            ASSERT_EQ(c.entry.reason, SyncWaitReason::MoveOrRenameCannotOccur);
+        }
+    }
+    ASSERT_EQ(removed, 20u);
+
+    // starting from scratch, removed stalls are not reported
+    log.changesSince(0, 10000, changes);
+    ASSERT_EQ(changes.mChanges.size(), 1980u);
+}
+
+TEST(SyncStallLog, ResetsCallersTooFarBehind)
+{
+    using namespace mega;
+
+    SyncStallLog log;
+    SyncStallChanges changes;
+
+    log.update(syntheticStalls(1));
+    uint64_t version = log.version();
+
+    // more removals than are remembered
+    log.update(syntheticStalls(SyncStallLog::MAX_REMOVED));
+    log.update(syntheticStalls(0));
+    log.update(syntheticStalls(2));
+
+    log.changesSince(version, 100, changes);
+    ASSERT_TRUE(changes.mReset);
+    ASSERT_EQ(changes.mChanges.size(), 4u);
+    ASSERT_EQ(changes.mVersion, log.version());
+
+    // a recent caller is fine
+    log.changesSince(changes.mVersion, 100, changes);
+    ASSERT_FALSE(changes.mReset);
+    ASSERT_TRUE(changes.mChanges.empty());
+
+    // as is one asking about a version it was never given
+    log.changesSince(log.version() + 1, 100, changes);
+    ASSERT_TRUE(changes.mReset);
+}
+
+TEST(SyncStallLog, ComparesStallReports)
+{
+    using namespace mega;
+
+    ASSERT_TRUE(SyncStallLog::sameStalls(syntheticStalls(0), syntheticStalls(0)));
+    ASSERT_TRUE(SyncStallLog::sameStalls(syntheticStalls(100), syntheticStalls(100)));
+    ASSERT_FALSE(SyncStallLog::sameStalls(syntheticStalls(100), syntheticStalls(99)));
+
+    auto stalls = syntheticStalls(100);
+    stalls.local.at(LocalPath::fromRelativePath("stalled5")).reason = SyncWaitReason::MoveOrRenameCannotOccur;
+    ASSERT_FALSE(SyncStallLog::sameStalls(stalls, syntheticStalls(100)));
+}
+
+TEST(HeartBeatSyncInfo, ReportsOnlyChangedStateBetweenMaxDelays)
+{
+    using namespace mega;
+
+    HeartBeatSyncInfo hbs;
+    HeartBeatSyncInfo::Report report;
+    report.backupId = 1;
+    report.status = CommandBackupPutHeartBeat::SYNCING;
+
+    m_time_t now = 1000000;
+
+    // never sent
+    ASSERT_TRUE(hbs.reportDue(report, now));
+    hbs.reported(report, now);
+
+    // unchanged backups wait for the maximum delay
+    now += HeartBeatSyncInfo::MIN_HEARTBEAT_SECS_DELAY;
+    ASSERT_FALSE(hbs.reportDue(report, now));
+    now += HeartBeatSyncInfo::MAX_HEARBEAT_SECS_DELAY;
+    ASSERT_TRUE(hbs.reportDue(report, now));
+    hbs.reported(report, now);
+
+    // changed ones only for the minimum
+    report.progress = 50;
+    ASSERT_FALSE(hbs.reportDue(report, now + 1));
+    ASSERT_TRUE(hbs.reportDue(report, now + HeartBeatSyncInfo::MIN_HEARTBEAT_SECS_DELAY));
+
+    // and never while a beat is in flight
+    hbs.mSending = true;
+    ASSERT_FALSE(hbs.reportDue(report, now + HeartBeatSyncInfo::MAX_HEARBEAT_SECS_DELAY));
+}
+
+TEST(HeartBeatSyncInfo, ChangesAfterQuietSpellsNeedNotWaitForAPass)
+{
+    using namespace mega;
+
+    HeartBeatSyncInfo hbs;
+    HeartBeatSyncInfo::Report report;
+    m_time_t now = 1000000;
+
+    ASSERT_TRUE(hbs.mayBeatEarly(now));
+    hbs.reported(report, now);
+    ASSERT_FALSE(hbs.mModified);
+
+    // a backup that just beat waits for the minimum delay
+    ASSERT_FALSE(hbs.mayBeatEarly(now + 1));
+    ASSERT_TRUE(hbs.mayBeatEarly(now + HeartBeatSyncInfo::MIN_HEARTBEAT_SECS_DELAY));
+
+    // one in flight for its response
+    hbs.mSending = true;
+    ASSERT_FALSE(hbs.mayBeatEarly(now + HeartBeatSyncInfo::MAX_HEARBEAT_SECS_DELAY));
+}
+
+TEST(HeartBeatBatch, KeepsLatestEntryPerBackup)
+{
+    using namespace mega;
+
+    HeartBeatBatch batch;
+    ASSERT_TRUE(batch.empty());
+
+    const size_t numBackups = 300;
+    for (size_t i = 0; i < numBackups; ++i)
+    {
+        SyncConfig config;
+        config.mBackupId = i;
+        config.mName = "backup";
+        batch.put(BackupInfoSync(config, "device", UNDEF, CommandBackupPut::ACTIVE));
+
+        HeartBeatSyncInfo::Report report;
+        report.backupId = i;
+        batch.beat(report, nullptr);
+    }
+    ASSERT_EQ(batch.size(), 2 * numBackups);
+
+    // a later update replaces the queued one
+    SyncConfig config;
+    config.mBackupId = 7;
+    config.mName = "renamed";
+    batch.put(BackupInfoSync(config, "device", UNDEF, CommandBackupPut::PAUSE_UP));
+
+    // as does a later beat, releasing the earlier one
+    bool released = false;
+    HeartBeatSyncInfo::Report report;
+    report.backupId = 9;
+    batch.beat(report, [&released](Error) { released = true; });
+    report.progress = 100;
+    batch.beat(report, nullptr);
+    ASSERT_TRUE(released);
+
+    ASSERT_EQ(batch.size(), 2 * numBackups);
+    ASSERT_EQ(batch.mPuts[7].backupName, "renamed");
+    ASSERT_EQ(batch.mPuts[7].state, CommandBackupPut::PAUSE_UP);
+    ASSERT_EQ(batch.mBeats[9].first.progress, 100);
+}
+
 #endif
 
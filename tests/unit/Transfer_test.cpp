@@ -22,6 +22,7 @@
 #include <mega/megaapp.h>
 #include <mega/transfer.h>
 
+#include "DefaultedDbTable.h"
 #include "DefaultedFileSystemAccess.h"
 #include "utils.h"
 #include "mega.h"
@@ -87,3 +88,258 @@ TEST(Transfer, serialize_unserialize)
 }
 
 
+
+namespace
+{
+
+// transfer cache table kept in memory
+class MemoryDbTable : public mt::DefaultedDbTable
+{
+public:
+    using mt::DefaultedDbTable::DefaultedDbTable;
+
+    std::map<uint32_t, std::string> mRecords;
+
+    bool get(uint32_t id, std::string* data) override
+    {
+        auto it = mRecords.find(id);
+        if (it == mRecords.end())
+        {
+            return false;
+        }
+        *data = it->second;
+        return true;
+    }
+
+    bool put(uint32_t id, char* data, unsigned len) override
+    {
+        mRecords[id].assign(data, len);
+        return true;
+    }
+
+    bool del(uint32_t id) override
+    {
+        return mRecords.erase(id) > 0;
+    }
+};
+
+} // anonymous
+
+TEST(Transfer, CachedTransfer_indexAndMaterialize)
+{
+    mega::MegaApp app;
+    auto client = mt::makeClient(app);
+    auto table = new MemoryDbTable(client->rng);
+    client->tctable.reset(table);
+
+    mega::Transfer tf{client.get(), mega::GET};
+    std::string lfn = "foo";
+    tf.localfilename = ::mega::LocalPath::fromAbsolutePath(lfn);
+    tf.size = 3 * 1024 * 1024;
+    tf.mtime = 12345;
+    tf.isvalid = true;
+
+    // the chunk MACs are not in the index, but must survive materialization
+    mega::SymmCipher cipher;
+    std::fill(tf.transferkey.data(),
+              tf.transferkey.data() + mega::SymmCipher::KEYLENGTH,
+              'Y');
+    cipher.setkey(tf.transferkey.data());
+    std::vector<mega::byte> chunk(1024, 'x');
+    tf.chunkmacs.ctr_encrypt(0, &cipher, chunk.data(), unsigned(chunk.size()), 0, tf.ctriv, false);
+    tf.chunkmacs.ctr_encrypt(131072, &cipher, chunk.data(), unsigned(chunk.size()), 131072, tf.ctriv, false);
+    ASSERT_EQ(tf.chunkmacs.size(), 2u);
+    tf.lastaccesstime = 3;
+    tf.ultoken.reset(new mega::UploadToken());
+    tf.tempurls = {"http://bar.com"};
+    tf.priority = 4;
+    tf.downloadFileHandle = mega::NodeHandle().set6byte(0x123456);
+
+    {
+        mega::TransferDbCommitter committer(client->tctable);
+        client->transfercacheadd(&tf, &committer);
+    }
+    ASSERT_TRUE(tf.dbid);
+    ASSERT_EQ(table->mRecords.size(), 2u);
+
+    // the index is a record of its own, next to the transfer's
+    const auto indexId = mega::CachedTransfer::indexId(tf.dbid);
+    ASSERT_EQ(mega::CachedTransfer::transferId(indexId), tf.dbid);
+    std::string d;
+    ASSERT_TRUE(table->get(indexId, &d));
+    ASSERT_TRUE(mega::PaddedCBC::decrypt(&d, &client->tckey));
+
+    std::unique_ptr<mega::CachedTransfer> ct{mega::CachedTransfer::unserialize(d)};
+    ASSERT_TRUE(ct);
+    ASSERT_EQ(ct->type, tf.type);
+    ASSERT_EQ(ct->localfilename, tf.localfilename);
+    ASSERT_EQ(ct->fingerprint(), tf.fingerprint());
+    ASSERT_EQ(ct->downloadFileHandle, tf.downloadFileHandle);
+    ASSERT_EQ(ct->lastaccesstime, tf.lastaccesstime);
+    ASSERT_EQ(ct->priority, tf.priority);
+
+    // only now is the transfer record read
+    ct->dbid = mega::CachedTransfer::transferId(indexId);
+    auto newTf = std::unique_ptr<mega::Transfer>{ct->materialize(client.get())};
+    ASSERT_TRUE(newTf);
+    checkTransfers(tf, *newTf);
+    ASSERT_EQ(newTf->dbid, tf.dbid);
+    ASSERT_EQ(newTf->chunkmacs.size(), tf.chunkmacs.size());
+
+    // a truncated index is rejected
+    ASSERT_FALSE(mega::CachedTransfer::unserialize(d.substr(0, d.size() / 2)));
+
+    // both records go together
+    {
+        mega::TransferDbCommitter committer(client->tctable);
+        client->transfercachedel(&tf, &committer);
+    }
+    ASSERT_TRUE(table->mRecords.empty());
+    ASSERT_FALSE(ct->materialize(client.get()));
+
+    newTf.reset();
+    tf.dbid = 0;
+    client->tctable.reset();
+}
+
+TEST(Transfer, TransferMemoryBudget_sharesBudgetBetweenSlots)
+{
+    const m_off_t MB = 1024 * 1024;
+    mega::TransferMemoryBudget budget(64 * MB);
+
+    // a lone slot gets full sized requests
+    budget.addSlot();
+    ASSERT_EQ(budget.requestSize(16 * MB, 2), 16 * MB);
+
+    // as more slots come in, every slot's requests shrink, in whole MBs but never below one
+    budget.addSlot();
+    budget.addSlot();
+    ASSERT_EQ(budget.requestSize(16 * MB, 2), 10 * MB);
+    for (int i = 0; i < 61; ++i)
+    {
+        budget.addSlot();
+    }
+    ASSERT_EQ(budget.requestSize(16 * MB, 2), MB);
+    ASSERT_EQ(budget.requestSize(MB / 2, 2), MB / 2);
+
+    // buffers in use are taken out of what's left to share
+    for (int i = 0; i < 63; ++i)
+    {
+        budget.removeSlot();
+    }
+    mega::byte* b = budget.acquireBuffer(static_cast<size_t>(40 * MB));
+    ASSERT_EQ(budget.buffersInUse(), 40 * MB);
+    ASSERT_EQ(budget.requestSize(16 * MB, 2), 12 * MB);
+
+    // and the slots grow back once they are released
+    budget.releaseBuffer(b, static_cast<size_t>(40 * MB));
+    ASSERT_EQ(budget.buffersInUse(), 0);
+    ASSERT_EQ(budget.requestSize(16 * MB, 2), 16 * MB);
+    budget.removeSlot();
+}
+
+TEST(Transfer, TransferMemoryBudget_poolsBuffers)
+{
+    const m_off_t MB = 1024 * 1024;
+    mega::TransferMemoryBudget budget(16 * MB);
+
+    ASSERT_EQ(mega::TransferMemoryBudget::bufferCapacity(1), 4096u);
+    ASSERT_EQ(mega::TransferMemoryBudget::bufferCapacity(5000), 8192u);
+    ASSERT_EQ(mega::TransferMemoryBudget::bufferCapacity(static_cast<size_t>(MB)), static_cast<size_t>(MB));
+
+    // released buffers are handed out again for requests of the same size class
+    mega::byte* b1 = budget.acquireBuffer(100000);
+    ASSERT_EQ(budget.buffersInUse(), 131072);
+    budget.releaseBuffer(b1, 100000);
+    ASSERT_EQ(budget.buffersPooled(), 131072);
+    mega::byte* b2 = budget.acquireBuffer(120000);
+    ASSERT_EQ(b1, b2);
+    ASSERT_EQ(budget.buffersPooled(), 0);
+    budget.releaseBuffer(b2, 120000);
+
+    // the pool holds at most a quarter of the budget
+    std::vector<mega::byte*> buffers;
+    for (int i = 0; i < 8; ++i)
+    {
+        buffers.push_back(budget.acquireBuffer(static_cast<size_t>(MB)));
+    }
+    for (auto b : buffers)
+    {
+        budget.releaseBuffer(b, static_cast<size_t>(MB));
+    }
+    ASSERT_EQ(budget.buffersInUse(), 0);
+    ASSERT_EQ(budget.buffersPooled(), 131072 + 3 * MB);
+}
+
+TEST(Transfer, TransferMemoryBudget_trimsPool)
+{
+    const m_off_t MB = 1024 * 1024;
+    mega::TransferMemoryBudget budget(1024 * MB);
+    budget.addSlot();
+
+    // however big the budget, only a few MB are pooled
+    std::vector<mega::byte*> buffers;
+    for (int i = 0; i < 8; ++i)
+    {
+        buffers.push_back(budget.acquireBuffer(static_cast<size_t>(16 * MB)));
+    }
+    for (auto b : buffers)
+    {
+        budget.releaseBuffer(b, static_cast<size_t>(16 * MB));
+    }
+    ASSERT_EQ(budget.buffersInUse(), 0);
+    ASSERT_EQ(budget.buffersPooled(), 32 * MB);
+
+    // pooled buffers count against the budget
+    ASSERT_EQ(budget.requestSize(1024 * MB, 1), 992 * MB);
+
+    // and are freed when the last slot goes
+    budget.removeSlot();
+    ASSERT_EQ(budget.buffersPooled(), 0);
+    budget.addSlot();
+    ASSERT_EQ(budget.requestSize(1024 * MB, 1), 1024 * MB);
+    budget.removeSlot();
+}
+
+TEST(Transfer, ConnectionRequestSizer_followsBandwidthDelayProduct)
+{
+    const m_off_t MB = 1024 * 1024;
+    const m_off_t maxSize = 16 * MB;
+
+    // nothing measured yet
+    mega::ConnectionRequestSizer sizer;
+    ASSERT_EQ(sizer.requestSize(maxSize), maxSize);
+
+    // slow link: 4 MB in 40 s with 50 ms round trips, requests of about a second
+    sizer.requestStarted();
+    sizer.requestFinished(4 * MB, 400, 50);
+    ASSERT_EQ(sizer.roundtripMs(), 50);
+    ASSERT_EQ(sizer.bandwidth(), 4 * MB * 1000 / 39950);
+    ASSERT_EQ(sizer.requestSize(maxSize), mega::ConnectionRequestSizer::MIN_REQUEST_SIZE);
+
+    // a request is only measured once
+    sizer.requestFinished(4 * MB, 10, 50);
+    ASSERT_EQ(sizer.bandwidth(), 4 * MB * 1000 / 39950);
+
+    // long fat link: 8 MB in 0.5 s with 400 ms round trips, several round trips worth of data
+    mega::ConnectionRequestSizer fast;
+    fast.requestStarted();
+    fast.requestFinished(8 * MB, 5, 400);
+    ASSERT_EQ(fast.bandwidth(), 80 * MB);
+    ASSERT_EQ(fast.requestSize(1024 * MB), 80 * MB * 400 / 1000 * mega::ConnectionRequestSizer::ROUNDTRIPS_PER_REQUEST);
+    ASSERT_EQ(fast.requestSize(maxSize), maxSize);
+
+    // the round trip time is smoothed, and kept when a request couldn't measure it
+    fast.requestStarted();
+    fast.requestFinished(8 * MB, 5, -1);
+    ASSERT_EQ(fast.roundtripMs(), 400);
+    fast.requestStarted();
+    fast.requestFinished(8 * MB, 5, 0);
+    ASSERT_EQ(fast.roundtripMs(), 350);
+
+    // the round trip may be longer than the coarse elapsed time
+    mega::ConnectionRequestSizer coarse;
+    coarse.requestStarted();
+    coarse.requestFinished(MB, 1, 500);
+    ASSERT_EQ(coarse.bandwidth(), 10 * MB);
+}
@@ -0,0 +1,112 @@
+/**
+ * @file TreeProc_test.cpp
+ * @brief Unitary test for the node tree processors
+ *
+ * (c) 2013-2024 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of the MEGA SDK - Client Access Engine.
+ *
+ * Applications using the MEGA API must present a valid application key
+ * and comply with the rules set forth in the Terms of Service.
+ *
+ * The MEGA SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#include <gtest/gtest.h>
+
+#include <mega/megaclient.h>
+#include <mega/megaapp.h>
+#include <mega/treeproc.h>
+
+#include "utils.h"
+
+namespace
+{
+
+// a folder with that many files, fed to the processor child first like proctree() does
+void copyTree(mega::MegaClient& client, mega::TreeProcCopy& tc, size_t files,
+              std::vector<std::shared_ptr<mega::Node>>& nodes)
+{
+    std::shared_ptr<mega::Node> folder(&mt::makeNode(client, mega::FOLDERNODE, mega::NodeHandle().set6byte(1)));
+    folder->attrs.map['n'] = "folder";
+    folder->attrs.map[mega::AttrMap::string2nameid("rr")] = "restore";
+
+    for (size_t i = 0; i < files; ++i)
+    {
+        std::shared_ptr<mega::Node> file(&mt::makeNode(client, mega::FILENODE, mega::NodeHandle().set6byte(2 + i), folder.get()));
+        file->parent = folder;
+        file->attrs.map['n'] = "file" + std::to_string(i);
+        tc.proc(&client, file);
+        nodes.push_back(file);
+    }
+
+    tc.proc(&client, folder);
+    nodes.push_back(folder);
+}
+
+void checkCopy(const mega::TreeProcCopy& tc, const std::vector<std::shared_ptr<mega::Node>>& nodes)
+{
+    ASSERT_EQ(tc.nn.size(), nodes.size());
+
+    for (size_t i = 0; i < tc.nn.size(); ++i)
+    {
+        // parent first, so in the reverse of the order visited
+        auto& n = nodes[nodes.size() - 1 - i];
+        auto& t = tc.nn[i];
+        ASSERT_EQ(t.nodehandle, n->nodehandle);
+        ASSERT_EQ(t.type, n->type);
+        ASSERT_EQ(t.parenthandle, n->parent ? n->parent->nodehandle : mega::UNDEF);
+
+        // attributes are encrypted with the new key, without the restore location
+        mega::AttrMap attrs;
+        attrs.map['n'] = n->attrs.map['n'];
+        std::string json;
+        attrs.getjson(&json);
+
+        mega::SymmCipher key;
+        key.setkey(reinterpret_cast<const mega::byte*>(t.nodekey.data()), t.type);
+        std::string expected;
+        mega::MegaClient::makeattr(&key, &expected, json.c_str());
+        ASSERT_TRUE(t.attrstring);
+        ASSERT_EQ(*t.attrstring, expected);
+    }
+
+    // files keep their key, folders get a new one
+    ASSERT_EQ(tc.nn.back().nodekey, nodes.front()->nodekey());
+    ASSERT_NE(tc.nn.front().nodekey, nodes.back()->nodekey());
+}
+
+} // anonymous
+
+TEST(TreeProc, TreeProcCopy_smallTree)
+{
+    mega::MegaApp app;
+    auto client = mt::makeClient(app);
+
+    mega::TreeProcCopy tc;
+    std::vector<std::shared_ptr<mega::Node>> nodes;
+    copyTree(*client, tc, 3, nodes);
+    tc.finish(client.get());
+
+    checkCopy(tc, nodes);
+}
+
+TEST(TreeProc, TreeProcCopy_largeTree)
+{
+    mega::MegaApp app;
+    auto client = mt::makeClient(app);
+
+    mega::TreeProcCopy tc;
+    std::vector<std::shared_ptr<mega::Node>> nodes;
+    copyTree(*client, tc, 1000, nodes);
+    tc.finish(client.get());
+
+    checkCopy(tc, nodes);
+}
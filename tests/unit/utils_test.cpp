@@ -17,6 +17,7 @@
  */
 
 #include <array>
+#include <random>
 #include <tuple>
 
 #include <gtest/gtest.h>
@@ -467,6 +468,37 @@ TEST(Conversion, HexVal)
     }
 }
 
+TEST(Conversion, Base64)
+{
+    // all the lengths of the last, incomplete group
+    EXPECT_EQ(Base64::btoa(std::string()), "");
+    EXPECT_EQ(Base64::btoa(std::string("f")), "Zg");
+    EXPECT_EQ(Base64::btoa(std::string("fo")), "Zm8");
+    EXPECT_EQ(Base64::btoa(std::string("foo")), "Zm9v");
+    EXPECT_EQ(Base64::btoa(std::string("foob")), "Zm9vYg");
+    EXPECT_EQ(Base64::btoa(std::string("\xfb\xff\xbf", 3)), "-_-_");
+
+    EXPECT_EQ(Base64::atob(std::string("Zm9vYg")), "foob");
+    EXPECT_EQ(Base64::atob(std::string("Zm9vYmFy")), "foobar");
+
+    // both alphabets are accepted and decoding stops at the first invalid character
+    EXPECT_EQ(Base64::atob(std::string("-_-_")), std::string("\xfb\xff\xbf", 3));
+    EXPECT_EQ(Base64::atob(std::string("+/+/")), std::string("\xfb\xff\xbf", 3));
+    EXPECT_EQ(Base64::atob(std::string("Zm9v=Zm9v")), "foo");
+
+    // the output buffer limits the decoded size
+    ::mega::byte buffer[4] = {};
+    EXPECT_EQ(Base64::atob("Zm9vYmFy", buffer, 4), 4);
+    EXPECT_EQ(std::string(reinterpret_cast<char*>(buffer), 4), "foob");
+
+    std::string binary;
+    for (int i = 0; i < 1000; ++i)
+    {
+        binary.push_back(static_cast<char>(i * 37));
+        EXPECT_EQ(Base64::atob(Base64::btoa(binary)), binary);
+    }
+}
+
 TEST(URLCodec, Escape)
 {
     string input = "abc123!@#$%^&*()";
@@ -799,6 +831,68 @@ TEST(LocalPath, PrependWithSeparator)
 
 #undef SEP
 
+TEST(LocalPath, utf8_normalize_matchesUtf8proc)
+{
+    // straightforward normalization of each NUL separated piece, as utf8_normalize() used to do
+    auto reference = [](const string& s)
+    {
+        string result;
+        for (size_t i = 0; i < s.size(); )
+        {
+            if (!s[i])
+            {
+                result.append("", 1);
+                ++i;
+                continue;
+            }
+
+            auto normalized = (char*)utf8proc_NFC((const utf8proc_uint8_t*)s.c_str() + i);
+            if (!normalized) return string();
+            result.append(normalized);
+            free(normalized);
+            i += strlen(s.c_str() + i);
+        }
+        return result;
+    };
+
+    // ASCII, Latin-1, combining marks, precomposed and decomposed Hangul, CJK, stray bytes
+    const vector<string> pieces = {
+        "a", "Z", "0", ".", " ", string("", 1), "\xc3\xa9", "\xc3\x9f", "\xca\xbc",
+        "\xcc\x81", "\xcc\x88", "\xe1\x84\x80", "\xe1\x85\xa1", "\xea\xb0\x80",
+        "\xe6\x97\xa5", "\xef\xac\x81", "\xf0\x9f\x98\x80", "\x80", "\xc3", "\xff"
+    };
+
+    std::mt19937 rng(42);
+    for (int i = 0; i < 5000; ++i)
+    {
+        string s;
+        auto length = rng() % 24;
+        for (unsigned j = 0; j < length; ++j)
+        {
+            s += pieces[rng() % pieces.size()];
+        }
+
+        string expected = reference(s);
+
+        // twice, so the second one may come from the memo
+        for (int k = 0; k < 2; ++k)
+        {
+            string actual = s;
+            LocalPath::utf8_normalize(&actual);
+            ASSERT_EQ(actual, expected) << "input: " << Utils::stringToHex(s);
+        }
+    }
+}
+
+TEST(Utils, toUpper_toLower_matchUtf8proc)
+{
+    for (int32_t c = 0; c < 0x800; ++c)
+    {
+        ASSERT_EQ(Utils::toUpper(c), utf8proc_toupper(c)) << c;
+        ASSERT_EQ(Utils::toLower(c), utf8proc_tolower(c)) << c;
+    }
+}
+
 TEST(JSONWriter, arg_stringWithEscapes)
 {
     JSONWriter writer;
@@ -863,6 +957,169 @@ TEST(Utils, replace_string)
     ASSERT_EQ(Utils::replace(string("abc"), "", "@"), "abc");
 }
 
+namespace
+{
+
+struct NullWaiter : public Waiter
+{
+    int wait() override { return 0; }
+    void notify() override {}
+};
+
+}
+
+TEST(MegaClientAsyncQueue, runsSingleAndBatchedJobs)
+{
+    for (unsigned threads : {0u, 1u, 4u})
+    {
+        NullWaiter waiter;
+        std::atomic<int> count{0};
+        {
+            MegaClientAsyncQueue queue(waiter, threads);
+
+            for (int i = 0; i < 100; ++i)
+            {
+                queue.push([&count](SymmCipher&) { ++count; }, false);
+            }
+
+            for (int i = 0; i < 10; ++i)
+            {
+                MegaClientAsyncQueue::Batch batch(queue);
+                for (int j = 0; j < 7; ++j)
+                {
+                    batch.push([&count](SymmCipher&) { ++count; }, false);
+                }
+            }
+        }   // destruction waits for the queued jobs
+
+        EXPECT_EQ(count.load(), 170) << threads << " threads";
+    }
+}
+
+TEST(MegaClientAsyncQueue, batchedJobsRunOnceFlushed)
+{
+    // as TransferSlot::doio() does when it waits for another connection's encryption
+    NullWaiter waiter;
+    MegaClientAsyncQueue queue(waiter, 2);
+    MegaClientAsyncQueue::Batch batch(queue);
+
+    std::atomic<bool> encrypted{false};
+    batch.push([&encrypted](SymmCipher&) { encrypted = true; }, true);
+
+    // held by the batch until it's flushed
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    ASSERT_FALSE(encrypted);
+
+    batch.flush();
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (!encrypted && std::chrono::steady_clock::now() < deadline)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    ASSERT_TRUE(encrypted);
+}
+
+TEST(MegaClientAsyncQueue, clearDiscardableSkipsQueuedJobs)
+{
+    NullWaiter waiter;
+    std::atomic<int> started{0};
+    std::atomic<bool> release{false};
+    std::atomic<int> discardable{0};
+    std::atomic<int> kept{0};
+    {
+        MegaClientAsyncQueue queue(waiter, 2);
+
+        // keep both workers busy so the next jobs stay queued
+        for (int i = 0; i < 2; ++i)
+        {
+            queue.push([&](SymmCipher&)
+            {
+                ++started;
+                while (!release) std::this_thread::yield();
+            }, false);
+        }
+        while (started < 2) std::this_thread::yield();
+
+        for (int i = 0; i < 10; ++i)
+        {
+            queue.push([&discardable](SymmCipher&) { ++discardable; }, true);
+            queue.push([&kept](SymmCipher&) { ++kept; }, false);
+        }
+        queue.clearDiscardable();
+
+        // discardable jobs queued after the clear still run
+        queue.push([&discardable](SymmCipher&) { ++discardable; }, true);
+
+        release = true;
+
+        // before the destructor discards it too
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+        while (discardable < 1 && std::chrono::steady_clock::now() < deadline)
+        {
+            std::this_thread::yield();
+        }
+    }
+
+    EXPECT_EQ(discardable.load(), 1);
+    EXPECT_EQ(kept.load(), 10);
+}
+
+TEST(ThreadSafeDeque, popFrontBatches)
+{
+    ThreadSafeDeque<int> queue;
+    for (int i = 0; i < 10; ++i) queue.pushBack(int(i));
+
+    std::deque<int> batch;
+    ASSERT_EQ(queue.popFrontBatch(batch, 4), 4u);
+    ASSERT_EQ(batch, std::deque<int>({0, 1, 2, 3}));
+    ASSERT_EQ(queue.size(), 6u);
+
+    // the rest, after what the batch holds already
+    queue.pushBack(10);
+    batch.pop_front();
+    ASSERT_EQ(queue.popFrontBatch(batch), 7u);
+    ASSERT_EQ(batch, std::deque<int>({1, 2, 3, 4, 5, 6, 7, 8, 9, 10}));
+    ASSERT_EQ(queue.popFrontBatch(batch), 0u);
+    ASSERT_TRUE(queue.empty());
+}
+
+TEST(ThreadSafeDeque, drainsBurstInBatches)
+{
+    using Action = std::function<void(size_t&)>;
+    const size_t burst = 1000000;
+
+    ThreadSafeDeque<Action> queue;
+    std::atomic<bool> produced{false};
+
+    std::thread producer([&]()
+    {
+        for (size_t i = 0; i < burst; ++i)
+        {
+            queue.pushBack([i](size_t& next) { if (next == i) ++next; });
+        }
+        produced = true;
+    });
+
+    // consumer takes the lock once per batch, as the client thread does
+    size_t next = 0;
+    std::deque<Action> batch;
+    while (next < burst)
+    {
+        if (!queue.popFrontBatch(batch))
+        {
+            if (produced && queue.empty()) break;
+            std::this_thread::yield();
+            continue;
+        }
+        for (; !batch.empty(); batch.pop_front()) batch.front()(next);
+    }
+    producer.join();
+
+    // every action ran, in order
+    ASSERT_EQ(next, burst);
+    ASSERT_TRUE(queue.empty());
+}
+
 TEST(RemotePath, nextPathComponent)
 {
     // Absolute path.
@@ -916,6 +1173,328 @@ TEST(RemotePath, nextPathComponent)
     }
 }
 
+TEST(Filesystem, CopyReportsMethod)
+{
+    FSACCESS_CLASS fsAccess;
+
+    LocalPath root;
+    ASSERT_TRUE(fsAccess.cwd(root));
+    root.appendWithSeparator(LocalPath::fromRelativePath("copy_method"), false);
+
+    fsAccess.emptydirlocal(root);
+    fsAccess.rmdirlocal(root);
+    ASSERT_TRUE(fsAccess.mkdirlocal(root, false, true));
+
+    auto source = root;
+    source.appendWithSeparator(LocalPath::fromRelativePath("s"), false);
+    auto target = root;
+    target.appendWithSeparator(LocalPath::fromRelativePath("t"), false);
+
+    // larger than the read/write buffer
+    string content(100000, '\0');
+    for (size_t i = 0; i < content.size(); ++i)
+    {
+        content[i] = static_cast<char>(i * 31);
+    }
+
+    {
+        auto fileAccess = fsAccess.newfileaccess(false);
+        ASSERT_TRUE(fileAccess->fopen(source, false, true, FSLogging::logOnError));
+        ASSERT_TRUE(fileAccess->fwrite(reinterpret_cast<const ::mega::byte*>(content.data()), static_cast<unsigned>(content.size()), 0));
+    }
+
+    ASSERT_TRUE(fsAccess.copylocal(source, target, 0));
+    ASSERT_NE(fsAccess.last_copy_method, FileSystemAccess::COPY_METHOD_NONE);
+
+    string copied;
+    auto fileAccess = fsAccess.newfileaccess(false);
+    ASSERT_TRUE(fileAccess->fopen(target, true, false, FSLogging::logOnError));
+    ASSERT_TRUE(fileAccess->fread(&copied, static_cast<unsigned>(content.size()), 0, 0, FSLogging::logOnError));
+    fileAccess.reset();
+    ASSERT_EQ(copied, content);
+
+    // a failed copy doesn't report a method
+    auto missing = root;
+    missing.appendWithSeparator(LocalPath::fromRelativePath("missing"), false);
+    ASSERT_FALSE(fsAccess.copylocal(missing, target, 0));
+    ASSERT_EQ(fsAccess.last_copy_method, FileSystemAccess::COPY_METHOD_NONE);
+
+    fsAccess.emptydirlocal(root);
+    fsAccess.rmdirlocal(root);
+}
+
+TEST(Filesystem, LocalFileIndex)
+{
+    FileFingerprint a;
+    a.size = 10;
+    a.mtime = 100;
+    a.isvalid = true;
+
+    FileFingerprint b = a;
+    b.size = 11;
+
+    auto path = [](const char* name)
+    {
+        return LocalPath::fromRelativePath(name);
+    };
+
+    LocalFileIndex index;
+    index.add(a, 1, path("x"));
+    index.add(a, 1, path("y"));
+    index.add(a, 2, path("z"));
+    index.add(b, 1, path("w"));
+    ASSERT_EQ(index.size(), 4u);
+
+    // most recent first, same MetaMAC only
+    auto candidates = index.candidates(a, 1);
+    ASSERT_EQ(candidates.size(), 2u);
+    ASSERT_EQ(candidates[0], path("y"));
+    ASSERT_EQ(candidates[1], path("x"));
+
+    // a path holds one content only
+    index.add(b, 1, path("y"));
+    ASSERT_EQ(index.candidates(a, 1).size(), 1u);
+    ASSERT_EQ(index.candidates(b, 1).size(), 2u);
+
+    index.remove(path("x"));
+    ASSERT_TRUE(index.candidates(a, 1).empty());
+    ASSERT_EQ(index.size(), 3u);
+
+    // invalid fingerprints are not indexed
+    FileFingerprint invalid;
+    index.add(invalid, 1, path("v"));
+    ASSERT_EQ(index.size(), 3u);
+
+    // the oldest entries are forgotten
+    for (size_t i = 0; i < LocalFileIndex::MAX_ENTRIES; ++i)
+    {
+        index.add(b, 3, path(std::to_string(i).c_str()));
+    }
+    ASSERT_EQ(index.size(), LocalFileIndex::MAX_ENTRIES);
+    ASSERT_TRUE(index.candidates(a, 2).empty());
+}
+
+#ifdef ENABLE_SYNC
+TEST(Filesystem, DirNotifyFileSettled)
+{
+    DirNotify notifier(LocalPath::fromRelativePath("root"));
+    auto path = LocalPath::fromRelativePath("file");
+
+    // nothing known about closes
+    ASSERT_FALSE(notifier.fileSettled(path, 10, 100));
+
+    // settled while size and mtime are those it had when closed
+    notifier.notifyClosedAfterWrite(path, 100, 10, 100);
+    ASSERT_TRUE(notifier.fileSettled(path, 10, 100));
+    ASSERT_FALSE(notifier.fileSettled(path, 10, 101));
+    ASSERT_FALSE(notifier.fileSettled(path, 11, 100));
+    ASSERT_FALSE(notifier.fileSettled(LocalPath::fromRelativePath("other"), 10, 100));
+
+    // written and closed again
+    notifier.notifyClosedAfterWrite(path, 101, 11, 101);
+    ASSERT_TRUE(notifier.fileSettled(path, 11, 101));
+    ASSERT_FALSE(notifier.fileSettled(path, 10, 100));
+}
+#endif
+
+TEST(Filesystem, LocalFileCopy)
+{
+    FSACCESS_CLASS fsAccess;
+
+    LocalPath root;
+    ASSERT_TRUE(fsAccess.cwd(root));
+    root.appendWithSeparator(LocalPath::fromRelativePath("local_file_copy"), false);
+
+    fsAccess.emptydirlocal(root);
+    fsAccess.rmdirlocal(root);
+    ASSERT_TRUE(fsAccess.mkdirlocal(root, false, true));
+
+    auto pathOf = [&root](const char* name)
+    {
+        auto path = root;
+        path.appendWithSeparator(LocalPath::fromRelativePath(name), false);
+        return path;
+    };
+
+    auto write = [&fsAccess](const LocalPath& path, const string& content)
+    {
+        auto fileAccess = fsAccess.newfileaccess(false);
+        return fileAccess->fopen(path, false, true, FSLogging::logOnError)
+               && fileAccess->fwrite(reinterpret_cast<const ::mega::byte*>(content.data()), static_cast<unsigned>(content.size()), 0);
+    };
+
+    string content(300000, '\0');
+    for (size_t i = 0; i < content.size(); ++i)
+    {
+        content[i] = static_cast<char>(i * 13);
+    }
+
+    // same size and mtime, different contents
+    string impostor = content;
+    impostor[1000] = static_cast<char>(impostor[1000] + 1);
+
+    auto original = pathOf("original");
+    auto changed = pathOf("changed");
+    auto target = pathOf("target");
+    ASSERT_TRUE(write(original, content));
+    ASSERT_TRUE(write(changed, impostor));
+    ASSERT_TRUE(fsAccess.setmtimelocal(original, 1000000));
+    ASSERT_TRUE(fsAccess.setmtimelocal(changed, 1000000));
+
+    FileFingerprint fingerprint;
+    {
+        auto fileAccess = fsAccess.newfileaccess(false);
+        ASSERT_TRUE(fileAccess->fopen(original, true, false, FSLogging::logOnError));
+        fingerprint.genfingerprint(fileAccess.get());
+        ASSERT_TRUE(fingerprint.isvalid);
+    }
+
+    // node key: the transfer key xored with the CTR IV and the MetaMAC of the contents
+    ::mega::byte transferKey[SymmCipher::KEYLENGTH];
+    std::memset(transferKey, 0x42, sizeof transferKey);
+    int64_t ctriv = 0x0102030405060708;
+
+    SymmCipher cipher(transferKey);
+    int64_t metaMac;
+    {
+        auto fileAccess = fsAccess.newfileaccess(false);
+        ASSERT_TRUE(fileAccess->fopen(original, true, false, FSLogging::logOnError));
+        auto result = generateMetaMac(cipher, *fileAccess, ctriv);
+        ASSERT_TRUE(result.first);
+        metaMac = result.second;
+    }
+
+    ::mega::byte nodeKey[FILENODEKEYLENGTH];
+    std::memcpy(nodeKey, transferKey, sizeof transferKey);
+    MemAccess::set<int64_t>(nodeKey + SymmCipher::KEYLENGTH, ctriv);
+    MemAccess::set<int64_t>(nodeKey + SymmCipher::KEYLENGTH + sizeof(int64_t), metaMac);
+    SymmCipher::xorblock(nodeKey + SymmCipher::KEYLENGTH, nodeKey);
+    string key(reinterpret_cast<const char*>(nodeKey), sizeof nodeKey);
+
+    // the impostor and the missing file are rejected, the original is copied
+    {
+        LocalFileCopy copy({changed, pathOf("missing"), original}, target, fingerprint, key);
+        copy.run();
+        ASSERT_EQ(copy.status(), LocalFileCopy::SUCCEEDED);
+        ASSERT_EQ(copy.staleCandidates().size(), 2u);
+
+        string copied;
+        auto fileAccess = fsAccess.newfileaccess(false);
+        ASSERT_TRUE(fileAccess->fopen(target, true, false, FSLogging::logOnError));
+        ASSERT_TRUE(fileAccess->fread(&copied, static_cast<unsigned>(content.size()), 0, 0, FSLogging::logOnError));
+        ASSERT_EQ(copied, content);
+
+        // the caller owns the copy once produced
+        ASSERT_TRUE(copy.cancel());
+    }
+
+    // no good candidates: nothing is left behind
+    ASSERT_TRUE(fsAccess.unlinklocal(target));
+    {
+        LocalFileCopy copy({changed}, target, fingerprint, key);
+        copy.run();
+        ASSERT_EQ(copy.status(), LocalFileCopy::FAILED);
+        ASSERT_FALSE(fsAccess.fileExistsAt(target));
+    }
+
+    // cancelled before running
+    {
+        LocalFileCopy copy({original}, target, fingerprint, key);
+        ASSERT_FALSE(copy.cancel());
+        copy.run();
+        ASSERT_EQ(copy.status(), LocalFileCopy::FAILED);
+        ASSERT_FALSE(fsAccess.fileExistsAt(target));
+    }
+
+    fsAccess.emptydirlocal(root);
+    fsAccess.rmdirlocal(root);
+}
+
+#ifndef _WIN32
+
+TEST(Filesystem, DirectoryScan)
+{
+    FSACCESS_CLASS fsAccess;
+
+    LocalPath root;
+    ASSERT_TRUE(fsAccess.cwd(root));
+    root.appendWithSeparator(LocalPath::fromRelativePath("directory_scan"), false);
+
+    fsAccess.emptydirlocal(root);
+    fsAccess.rmdirlocal(root);
+    ASSERT_TRUE(fsAccess.mkdirlocal(root, false, true));
+
+    auto pathOf = [&root](const char* name)
+    {
+        auto path = root;
+        path.appendWithSeparator(LocalPath::fromRelativePath(name), false);
+        return path;
+    };
+
+    {
+        auto fileAccess = fsAccess.newfileaccess(false);
+        ASSERT_TRUE(fileAccess->fopen(pathOf("f"), false, true, FSLogging::logOnError));
+        ASSERT_TRUE(fileAccess->fwrite(reinterpret_cast<const ::mega::byte*>("abc"), 3, 0));
+    }
+
+    ASSERT_TRUE(fsAccess.mkdirlocal(pathOf("d"), false, true));
+    ASSERT_EQ(symlink("f", pathOf("l").platformEncoded().c_str()), 0);
+
+    auto fsid = fsAccess.fsidOf(root, false, false, FSLogging::logOnError);
+
+    auto scan = [&](bool followSymLinks, map<LocalPath, FSNode>& known, unsigned& nFingerprinted)
+    {
+        vector<FSNode> results;
+        nFingerprinted = 0;
+
+        EXPECT_EQ(fsAccess.directoryScan(root, fsid, known, results, followSymLinks, nFingerprinted),
+                  SCAN_SUCCESS);
+
+        map<LocalPath, FSNode> byName;
+        for (auto& result : results)
+        {
+            byName.emplace(result.localname, std::move(result));
+        }
+        return byName;
+    };
+
+    map<LocalPath, FSNode> known;
+    unsigned nFingerprinted;
+
+    auto results = scan(false, known, nFingerprinted);
+    ASSERT_EQ(results.size(), 3u);
+    ASSERT_EQ(nFingerprinted, 1u);
+
+    auto& file = results[LocalPath::fromRelativePath("f")];
+    ASSERT_EQ(file.type, FILENODE);
+    ASSERT_EQ(file.fingerprint.size, 3);
+    ASSERT_TRUE(file.fingerprint.isvalid);
+    ASSERT_EQ(file.fsid, fsAccess.fsidOf(pathOf("f"), false, false, FSLogging::logOnError));
+
+    ASSERT_EQ(results[LocalPath::fromRelativePath("d")].type, FOLDERNODE);
+    ASSERT_EQ(results[LocalPath::fromRelativePath("l")].type, TYPE_SYMLINK);
+
+    // links are resolved relative to the scanned directory
+    results = scan(true, known, nFingerprinted);
+    ASSERT_EQ(results[LocalPath::fromRelativePath("l")].type, FILENODE);
+    ASSERT_EQ(results[LocalPath::fromRelativePath("l")].fingerprint.size, 3);
+
+    // known fingerprints are reused
+    known = scan(false, known, nFingerprinted);
+    scan(false, known, nFingerprinted);
+    ASSERT_EQ(nFingerprinted, 0u);
+
+    // the scan target must be the directory we expect
+    vector<FSNode> mismatched;
+    ASSERT_EQ(fsAccess.directoryScan(root, fsid + 1, known, mismatched, false, nFingerprinted),
+              SCAN_FSID_MISMATCH);
+
+    fsAccess.emptydirlocal(root);
+    fsAccess.rmdirlocal(root);
+}
+
+#endif // ! _WIN32
+
 class TooLongNameTest
     : public ::testing::Test
 {